@@ -3,6 +3,21 @@
          Ted Hale
 	2014-11-29   initial edits
 	2014-12-05   add rolling avg and gust processing
+	2026-10-17   ISR queues pulse times, speed and 3 second gust are
+	             worked out from them in wind.c
+	2026-10-17   speed from the latest pulses goes into the snapshot
+	             every second, the reports as they are made
+	2026-10-17   the report interval is checkpointed and carried over
+	             a restart
+	2026-10-17   pulses are written to the pulselog files if set
+	2026-10-17   the loop body is WindPoll(), eventloop=1 runs it from
+	             a reactor.c timer instead of this thread
+	2026-10-17   rtprio= and rtsample= from rt.c, edge to ISR latency
+	             in histEdge when the backend times the edge
+	2026-10-17   reports missed in a stall are skipped
+	2026-10-17   reports fall on whole multiples of windreport from
+	             WindNext(), as replay makes them, and are stamped
+	             with that time
 
 ---------------------------------------------------------------------------*/
 
@@ -14,120 +29,196 @@
 #include <signal.h>
 #include <sys/timeb.h>
 #include <pthread.h>
+#include <stddef.h>
 
-#include <wiringPi.h>
 #include "weatherstation.h"
 
-#define AVGSIZE 5
-#define BUFSIZE 24
-
-int windCounter;	// counter for wind guage clicks
+PULSERING windPulses;	// pulse times from windInterrupt
+static PULSELOG windLog = {"wind",'W'};
+static WINDCALC w;
+static unsigned long long next, lastSave;	// next report, last checkpoint
+static double due;		// next report, unix seconds
+static unsigned long overruns;
+static int idSpeed, idGust;
+static TIMER windTimer;		// eventloop=1 only
 
 //************************************************************************
-// windInterrupt:  called for anemometer counter
-void windInterrupt(void) {
-   windCounter++;
+// windInterrupt:  called for anemometer counter, edge is the time of
+// the edge if the backend knows it, else 0
+void windInterrupt(unsigned long long edge) {
+   static int rt;
+   unsigned long long now = MonoNs();
+
+   if (!rt)
+      rt = RtThread("wind edge",rtPrio);
+   if (edge)
+      HistAdd(&histEdge, (now>edge) ? now-edge : 0);
+   else
+      edge = now;
+   PulsePut(&windPulses, edge);
 }
 
 //**************************************************************************
-void getAvg(int *dat, int sz, double *result)
+// save the wind state
+static void SaveWind(void)
 {
-	int i, tot=0;
-	for (i=0; i<sz; i++)
-		tot+=dat[i];
-	*result = 1.0*tot/sz;
+	WINDCKPT *ck;
+
+	ck = CkptBegin(CKPTWIND);
+	if (ck!=NULL)
+		CkptEnd(CKPTWIND,WindSave(&w,MonoNs(),ck));
 }
 
 //**************************************************************************
-void getAvgDouble(double *dat, int sz, double *result)
+// set up the pulse ring, the ISR and the wind state
+//  RETURNS: 0 for success, 1 on error
+static int WindSetup(void)
 {
-	int i;
-	double tot=0;
-	for (i=0; i<sz; i++)
-		tot+=1.0*dat[i];
-	*result = tot/sz;
+	unsigned long long t, now;
+	int len;
+	double saved, wall;
+	WINDCKPT *ck;
+	
+	idSpeed = MetricId("wind_speed");
+	idGust = MetricId("wind_gust");
+
+	// the ring is never freed, the ISR can feed it until the process exits
+	if ((windPulses.buf==NULL) && PulseInit(&windPulses,4096))
+	{
+		Log("anemometerthread> no memory for pulse ring");
+		return 1;
+	}
+	
+	// set up anemometer interrupt
+	if ( hal->gpioEdge (WIND_PIN, &windInterrupt) < 0 ) {
+		Log("Unable to setup ISR: %s\n", strerror (errno));
+	}	
+		
+	now = MonoNs();
+	// skip anything left over from before a restart
+	while (PulseGet(&windPulses,&t)==0)
+		;
+	WindInit(&w,now);
+	wall = TimeNow();
+	due = WindNext(wall,0,windReport);
+	next = now + (due-wall)*1e9;
+
+	// carry on with the pulses of this report from the last checkpoint
+	ck = CkptLoad(CKPTWIND,&len,&saved);
+	if ((ck!=NULL) && (len>=offsetof(WINDCKPT,win)))
+	{
+		WindRestore(&w,now,ck,(TimeNow()>saved) ? (TimeNow()-saved)*1e9 : 0);
+		Log("anemometerthread> checkpoint from %.0f seconds ago, %lu pulses so far",
+					TimeNow()-saved,w.pulses);
+	}
+	lastSave = now;
+	return 0;
 }
 
 //**************************************************************************
-void getMax(double *dat, int sz, double *result)
+// take the pulses in, update the snapshot and report when it is due
+static void WindPoll(void)
 {
-	int i;
-	double high = dat[0];
-	for (i=1; i<sz; i++)
-		if (dat[i]>high)
-			high = dat[i];
-	*result = high;
+	char tmp[80];
+	unsigned long long t, now;
+	double off, wall;
+	SNAPSHOT *snap;
+
+	now = MonoNs();
+	off = TimeNow()-now/1e9;
+	while (PulseGet(&windPulses,&t)==0)
+	{
+		HistAdd(&histPulse,(now>t)?now-t:0);
+		WindPulse(&w,t);
+		PulseLogPut(&windLog,pulseLog,off+t/1e9);
+	}
+	PulseLogFlush(&windLog);
+	if (windPulses.overruns!=overruns)
+	{
+		overruns = windPulses.overruns;
+		Log("anemometerthread> pulse ring overrun, %lu lost",overruns);
+	}
+	snap = SnapBegin();
+	snap->windNow = WindNow(&w,now);
+	SnapEnd();
+
+	if (now>=next)
+	{
+		WindReport(&w,now,&windSpeed,&windGust);
+		sprintf(tmp,"anemometerthread> wind speed = %4.1f   wind gust = %4.1f",windSpeed,windGust);
+		Log(tmp);
+		// save to DB
+		StoreSample(idSpeed,windSpeed,due);
+		StoreSample(idGust,windGust,due);
+		snap = SnapBegin();
+		snap->windSpeed = windSpeed;
+		snap->windGust = windGust;
+		snap->windTime = TimeNow();
+		SnapEnd();
+		// after a stall the reports it made us miss are skipped
+		// rather than made back to back
+		wall = TimeNow();
+		now = MonoNs();
+		due = WindNext(wall,due,windReport);
+		next = now + (due-wall)*1e9;
+	}
+	if (CkptDue(&lastSave))
+		SaveWind();
 }
-	
+
 //**************************************************************************
 // Thread entry point, param is not used
 void *anemometerthread(void *param)
 {
-	char tmp[80];
-	time_t now, lastCount = 0;
-	int avgbuf[AVGSIZE];
-	int avgptr = 0;
-	double bvgbuf[BUFSIZE];		// last 2 minutes of values
-	int bvgptr = 0;
-	double x,y;
-	
-	memset(avgbuf,0,sizeof(avgbuf));
-	memset(bvgbuf,0,sizeof(bvgbuf));;
-	
-	// set up anemometer interrupt
-	windCounter = 0;
-	if ( wiringPiISR (WIND_PIN, INT_EDGE_FALLING, &windInterrupt) < 0 ) {
-		Log("Unable to setup ISR: %s\n", strerror (errno));
-	}	
-		
+	RtThread("anemometerthread",rtSample);
+	if (WindSetup())
+		return 0;
+
 	// start polling loop
 	Log("anemometerthread> start polling loop.");
-	time(&lastCount);	
     do
     {
-		time(&now);
-		// process every second
-		if ((now-lastCount)>=1)
-		{
-			//Log("anemometerthread> a=%d   b=%d",avgptr,bvgptr);
-			avgbuf[avgptr] = windCounter;
-			avgptr++;
-			windCounter = 0;
-			lastCount = now;
-		}			
-		if (avgptr>AVGSIZE)
-		{
-			// instantaneous from 5 second avg
-			getAvg(avgbuf,AVGSIZE,&x);
-			y = 3.6528*x;
-			bvgbuf[bvgptr] = y;
-			bvgptr++;
-			// gust
-			getMax(bvgbuf,BUFSIZE,&y);
-			if (y>x)
-				windGust=y;
-			avgptr=0;
-		}
-		if (bvgptr>BUFSIZE)
-		{
-			// averaged windspeed
-			getAvgDouble(bvgbuf, BUFSIZE, &x);
-			windSpeed = x;
-			sprintf(tmp,"anemometerthread> wind speed = %4.1f   wind gust = %4.1f",windSpeed,windGust);
-			Log(tmp);
-			// save to DB
-			sprintf(tmp,"%5.1f",windSpeed);
-			StoreToDB("wind_speed",tmp);
-			sprintf(tmp,"%5.1f",windGust);
-			StoreToDB("wind_gust",tmp);
-			windGust = 0;
-			bvgptr=0;
-		}
-
-		// let other threads run
-		Sleep(5);	
+		// pulses carry their own times, so draining once a second
+		// loses nothing
+		Sleep(1000);
+		WindPoll();
 	} while (kicked==0);  // exit loop if flag set
+	SaveWind();
 	
 	Log("anemometerthread> thread exiting");
 	return 0;
 }
+
+//**************************************************************************
+// eventloop=1: a poll every second for the snapshot, and one right
+// when the report is due rather than up to a second after
+static void WindEvent(TIMER *t)
+{
+	unsigned long long at;
+
+	WindPoll();
+	at = MonoNs() + 1000000000ULL;
+	TimerAt(t,(next<at) ? next : at);
+}
+
+//**************************************************************************
+// start the wind code on the reactor.c thread
+//  RETURNS: 0 for success, 1 on error
+int AnemometerStart(void)
+{
+	if (WindSetup())
+		return 1;
+	TimerInit(&windTimer,WindEvent,NULL);
+	TimerAt(&windTimer,MonoNs() + 1000000000ULL);
+	Log("anemometerthread> started on the event loop.");
+	return 0;
+}
+
+//**************************************************************************
+// the event loop has stopped, save the state
+void AnemometerStop(void)
+{
+	TimerCancel(&windTimer);
+	SaveWind();
+	Log("anemometerthread> stopped");
+}
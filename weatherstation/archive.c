@@ -0,0 +1,328 @@
+/*---------------------------------------------------------------------------
+   archive.c   local column archive of every sample
+	2026-10-17   initial edits
+
+	Each metric has its own <name>.col file in archivedir.  After a
+	one page header the file is a run of fixed size blocks, each
+	holding ARCHBLOCK times (ms since 1970) followed by ARCHBLOCK
+	values, so a scan over a time range reads only the two arrays it
+	needs.  The block being filled is mapped and samples are stored
+	straight into it; the count in the header is bumped after the data
+	so a reader never sees a half written sample.
+
+	<name>.idx holds one ARCHIDX per block with its time range and
+	min, max and sum.  It is small enough to read in one go, finds the
+	block for a time with a binary search, and lets whole blocks be
+	added up without touching them (see archread.c).
+
+	Samples must arrive in time order for each metric, any older than
+	the last one stored are counted and skipped.  Minute means made by
+	the rollups are not kept, the raw readings they came from are.
+	Only dbthread calls these functions so there is no locking.
+
+	2026-10-17   full blocks are compressed (gorilla.c), a few bytes a
+	             sample instead of 16.  Only the block being filled is
+	             kept raw, in one slot after the header, and when it is
+	             full it is compressed onto the end of the file, its
+	             length goes in the index and then the sealed count in
+	             the header is bumped.  A crash before that just
+	             compresses it again on the next start.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "weatherstation.h"
+
+// writer state for one column
+typedef struct {
+	int			fd;				// column file, -1 when not open
+	int			ifd;			// index file, -1 when not open
+	ARCHHDR		*hdr;			// mapped header page
+	char		*blk;			// mapped block being filled
+	long long	end;			// where the next compressed block goes
+	ARCHIDX		ix;				// summary of that block
+	int			dirty;			// ix not yet written
+	int			bad;			// could not be opened, don't retry
+} ARCHW;
+
+static char			archDir[100];
+static ARCHW		cols[MAXMETRICS];	// by metric id
+static ARCHSTATS	archstats;
+static BYTE			zbuf[ARCHZMAX];		// block being compressed
+
+#define BLKTIMES(p)		((long long *)(p))
+#define BLKVALUES(p)	((double *)((p)+ARCHBLOCK*sizeof(long long)))
+
+static int Append(ARCHW *c, long long t, double v);
+
+//**************************************************************************
+// set up the archive directory
+//  dir empty disables the archive
+//  RETURNS: 0 for success, 1 on error
+int ArchiveInit(char *dir)
+{
+	int i;
+
+	for (i=0; i<MAXMETRICS; i++)
+		cols[i].fd = cols[i].ifd = -1;
+	if ((dir==NULL)||(dir[0]==0))
+	{
+		Log("archive> disabled");
+		return 1;
+	}
+	strncpy(archDir,dir,sizeof(archDir)-1);
+	mkdir(archDir,0755);
+	if (access(archDir,W_OK))
+	{
+		Log("archive> error %d using %s",errno,archDir);
+		archDir[0] = 0;
+		return 1;
+	}
+	Log("archive> %s",archDir);
+	return 0;
+}
+
+//**************************************************************************
+// write out the summary of the block being filled
+static void SaveIndex(ARCHW *c)
+{
+	if (!c->dirty)
+		return;
+	pwrite(c->ifd,&c->ix,sizeof(ARCHIDX),c->hdr->sealed*sizeof(ARCHIDX));
+	c->dirty = 0;
+}
+
+//**************************************************************************
+// add one sample to a block summary
+static void IndexAdd(ARCHIDX *ix, long long t, double v)
+{
+	if (ix->n==0)
+	{
+		ix->t0 = t;
+		ix->min = ix->max = v;
+	}
+	if (v<ix->min) ix->min = v;
+	if (v>ix->max) ix->max = v;
+	ix->t1 = t;
+	ix->sum += v;
+	ix->n++;
+}
+
+//**************************************************************************
+// compress the full block onto the end of the file and start the
+// slot over.  The sealed count is the commit, it only goes up once
+// the block and its index entry are on disk
+//  RETURNS: 0 for success, 1 on error
+static int Seal(ARCHW *c)
+{
+	GORILLA g;
+	int i, len;
+
+	GorillaInit(&g,zbuf,sizeof(zbuf),BLKTIMES(c->blk)[0]);
+	for (i=0; i<ARCHBLOCK; i++)
+		if (GorillaPut(&g,BLKTIMES(c->blk)[i],BLKVALUES(c->blk)[i]))
+			return 1;
+	len = GorillaBytes(&g);
+	if (pwrite(c->fd,zbuf,len,c->end)!=len)
+		return 1;
+	fdatasync(c->fd);
+	c->ix.len = len;
+	c->dirty = 1;
+	SaveIndex(c);
+	fdatasync(c->ifd);
+	__atomic_store_n(&c->hdr->sealed,c->hdr->sealed+1,__ATOMIC_RELEASE);
+	c->end += len;
+	memset(&c->ix,0,sizeof(ARCHIDX));
+	archstats.blocks++;
+	archstats.zbytes += len;
+	LogDbg("archive> %s block %lld, %d bytes",c->hdr->name,c->hdr->sealed-1,len);
+	return 0;
+}
+
+//**************************************************************************
+// open or create the column for a metric
+//  RETURNS: 0 for success, 1 on error
+static int OpenColumn(int id)
+{
+	ARCHW *c = &cols[id];
+	char fname[150], iname[150], *name;
+	ARCHIDX ix;
+	long long i, n, b;
+	struct stat st;
+
+	name = MetricName(id);
+	snprintf(fname,sizeof(fname),"%s/%s.col",archDir,name);
+	snprintf(iname,sizeof(iname),"%s/%s.idx",archDir,name);
+
+	c->fd = open(fname,O_RDWR|O_CREAT,0644);
+	if (c->fd<0)
+		goto fail;
+	fstat(c->fd,&st);
+	if ((st.st_size<ARCHHDRSZ+ARCHBLKSZ) && ftruncate(c->fd,ARCHHDRSZ+ARCHBLKSZ))
+		goto fail;
+	c->hdr = mmap(NULL,ARCHHDRSZ,PROT_READ|PROT_WRITE,MAP_SHARED,c->fd,0);
+	if (c->hdr==MAP_FAILED)
+	{
+		c->hdr = NULL;
+		goto fail;
+	}
+	if (c->hdr->magic==0)
+	{
+		c->hdr->blocksize = ARCHBLOCK;
+		strncpy(c->hdr->name,name,METRICNAMESZ-1);
+		__atomic_store_n(&c->hdr->magic,ARCHMAGIC,__ATOMIC_RELEASE);
+	}
+	else if ((c->hdr->magic!=ARCHMAGIC)||(c->hdr->blocksize!=ARCHBLOCK))
+	{
+		Log("archive> %s is not a column file, %s not archived",fname,name);
+		goto fail;
+	}
+	c->blk = mmap(NULL,ARCHBLKSZ,PROT_READ|PROT_WRITE,MAP_SHARED,c->fd,ARCHHDRSZ);
+	if (c->blk==MAP_FAILED)
+	{
+		c->blk = NULL;
+		goto fail;
+	}
+	c->ifd = open(iname,O_RDWR|O_CREAT,0644);
+	if (c->ifd<0)
+		goto fail;
+
+	// compressed blocks follow the slot, one after another
+	c->end = ARCHHDRSZ+ARCHBLKSZ;
+	for (b=0; b<c->hdr->sealed; b++)
+	{
+		if (pread(c->ifd,&ix,sizeof(ix),b*sizeof(ARCHIDX))!=sizeof(ix))
+			goto fail;
+		c->end += ix.len;
+	}
+
+	// carry on in the slot, its summary may not have been saved if we
+	// stopped in a hurry.  If it is full it was not compressed yet
+	n = c->hdr->count-c->hdr->sealed*ARCHBLOCK;
+	memset(&c->ix,0,sizeof(ARCHIDX));
+	for (i=0; i<n; i++)
+		IndexAdd(&c->ix,BLKTIMES(c->blk)[i],BLKVALUES(c->blk)[i]);
+	c->dirty = (n>0);
+	if ((n==ARCHBLOCK) && Seal(c))
+		goto fail;
+	SaveIndex(c);
+	archstats.columns++;
+	LogDbg("archive> %s open, %lld samples",name,c->hdr->count);
+	return 0;
+
+fail:
+	Log("archive> error %d opening column %s",errno,name);
+	if (c->blk!=NULL) munmap(c->blk,ARCHBLKSZ);
+	if (c->hdr!=NULL) munmap(c->hdr,ARCHHDRSZ);
+	if (c->ifd>=0) close(c->ifd);
+	if (c->fd>=0) close(c->fd);
+	memset(c,0,sizeof(ARCHW));
+	c->fd = c->ifd = -1;
+	c->bad = 1;
+	return 1;
+}
+
+//**************************************************************************
+// store one sample at the end of its column
+//  RETURNS: 0 for success, 1 on error
+static int Append(ARCHW *c, long long t, double v)
+{
+	long long n = c->hdr->count;
+	int k;
+
+	if ((n>0) && (t<c->hdr->last))
+	{
+		archstats.older++;
+		return 0;
+	}
+	k = n-c->hdr->sealed*ARCHBLOCK;
+	if (k==ARCHBLOCK)
+	{
+		if (Seal(c))
+			return 1;
+		k = 0;
+	}
+	BLKTIMES(c->blk)[k] = t;
+	BLKVALUES(c->blk)[k] = v;
+	IndexAdd(&c->ix,t,v);
+	c->dirty = 1;
+	if (n==0)
+		c->hdr->first = t;
+	c->hdr->last = t;
+	// readers go by the count, publish it after the data
+	__atomic_store_n(&c->hdr->count,n+1,__ATOMIC_RELEASE);
+	archstats.written++;
+	return 0;
+}
+
+//**************************************************************************
+// add samples to the archive
+void ArchiveWrite(SAMPLE *s, int n)
+{
+	ARCHW *c;
+	int i;
+
+	if (archDir[0]==0)
+		return;
+	for (i=0; i<n; i++)
+	{
+		if ((s[i].kind==SAMPLE_MEAN)||(s[i].metric<0)||(s[i].metric>=MAXMETRICS))
+			continue;
+		c = &cols[s[i].metric];
+		if ((c->fd<0) && (c->bad || OpenColumn(s[i].metric)))
+		{
+			archstats.errors++;
+			continue;
+		}
+		if (Append(c,llround(s[i].dt*1000),s[i].value))
+		{
+			Log("archive> error %d writing %s",errno,MetricName(s[i].metric));
+			archstats.errors++;
+		}
+	}
+	for (i=0; i<MAXMETRICS; i++)
+		if (cols[i].fd>=0)
+			SaveIndex(&cols[i]);
+}
+
+//**************************************************************************
+// flush and close all columns
+void ArchiveClose(void)
+{
+	ARCHW *c;
+	int i;
+
+	for (i=0; i<MAXMETRICS; i++)
+	{
+		c = &cols[i];
+		if (c->fd<0)
+			continue;
+		SaveIndex(c);
+		msync(c->blk,ARCHBLKSZ,MS_SYNC);
+		munmap(c->blk,ARCHBLKSZ);
+		msync(c->hdr,ARCHHDRSZ,MS_SYNC);
+		munmap(c->hdr,ARCHHDRSZ);
+		close(c->ifd);
+		close(c->fd);
+		memset(c,0,sizeof(ARCHW));
+		c->fd = c->ifd = -1;
+	}
+	archstats.columns = 0;
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void ArchiveGetStats(ARCHSTATS *out)
+{
+	memcpy(out,&archstats,sizeof(ARCHSTATS));
+}
@@ -0,0 +1,285 @@
+/*---------------------------------------------------------------------------
+   archread.c   read side of the column archive
+	2026-10-17   initial edits
+
+	ArchOpen() maps a column file read only, as far as it had been
+	written at that moment, and loads its block index.  The summary
+	of the last block is worked out again from the data since the
+	writer may still be filling it.  Nothing here calls back into the
+	daemon so the query tool can link it on its own.
+
+	2026-10-17   compressed blocks.  One block at a time is unpacked
+	             into a cache as samples in it are asked for, and the
+	             block being filled is copied at open since the writer
+	             reuses its slot.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "weatherstation.h"
+
+//**************************************************************************
+// copy the block being filled.  If the writer compresses it and starts
+// over while we look, try again
+//  RETURNS: 0 for success, 1 on error
+static int CopyTail(ARCHCOL *c)
+{
+	volatile ARCHHDR *hdr = (ARCHHDR *)c->map;
+	long long n;
+	int tries;
+
+	for (tries=0; tries<10; tries++)
+	{
+		c->sealed = __atomic_load_n(&hdr->sealed,__ATOMIC_ACQUIRE);
+		c->count = __atomic_load_n(&hdr->count,__ATOMIC_ACQUIRE);
+		n = c->count-c->sealed*ARCHBLOCK;
+		if ((n<0) || (n>ARCHBLOCK))
+			continue;
+		memcpy(c->tailT,c->map+ARCHHDRSZ,n*sizeof(long long));
+		memcpy(c->tailV,c->map+ARCHHDRSZ+ARCHBLOCK*sizeof(long long),n*sizeof(double));
+		if (__atomic_load_n(&hdr->sealed,__ATOMIC_ACQUIRE)==c->sealed)
+			return 0;
+	}
+	return 1;
+}
+
+//**************************************************************************
+// open the column for a metric
+//  RETURNS: 0 for success, 1 on error
+int ArchOpen(ARCHCOL *c, char *dir, char *name)
+{
+	char fname[150];
+	ARCHHDR hdr;
+	ARCHIDX *ix;
+	struct stat st;
+	long long i, n, first, t;
+	double v;
+	int fd;
+
+	memset(c,0,sizeof(ARCHCOL));
+	c->fd = -1;
+	c->cached = c->cur = -1;
+	snprintf(fname,sizeof(fname),"%s/%s.col",dir,name);
+	c->fd = open(fname,O_RDONLY);
+	if (c->fd<0)
+		return 1;
+	if ((pread(c->fd,&hdr,sizeof(hdr),0)!=sizeof(hdr)) ||
+		(hdr.magic!=ARCHMAGIC) || (hdr.blocksize!=ARCHBLOCK))
+	{
+		ArchClose(c);
+		return 1;
+	}
+	hdr.name[METRICNAMESZ-1] = 0;
+	strcpy(c->name,hdr.name);
+	fstat(c->fd,&st);
+	c->maplen = st.st_size;
+	c->map = mmap(NULL,c->maplen,PROT_READ,MAP_SHARED,c->fd,0);
+	if (c->map==MAP_FAILED)
+	{
+		c->map = NULL;
+		ArchClose(c);
+		return 1;
+	}
+	c->tailT = malloc(ARCHBLOCK*sizeof(long long));
+	c->tailV = malloc(ARCHBLOCK*sizeof(double));
+	c->cacheT = malloc(ARCHBLOCK*sizeof(long long));
+	c->cacheV = malloc(ARCHBLOCK*sizeof(double));
+	if ((c->tailT==NULL) || (c->tailV==NULL) || (c->cacheT==NULL) ||
+		(c->cacheV==NULL) || CopyTail(c))
+	{
+		ArchClose(c);
+		return 1;
+	}
+	c->nidx = (c->count+ARCHBLOCK-1)/ARCHBLOCK;
+
+	// block index, the last entry is rebuilt from the data
+	c->idx = calloc(c->nidx+1,sizeof(ARCHIDX));
+	c->off = calloc(c->nidx+1,sizeof(long long));
+	if ((c->idx==NULL) || (c->off==NULL))
+	{
+		ArchClose(c);
+		return 1;
+	}
+	snprintf(fname,sizeof(fname),"%s/%s.idx",dir,name);
+	fd = open(fname,O_RDONLY);
+	if (fd>=0)
+	{
+		pread(fd,c->idx,c->nidx*sizeof(ARCHIDX),0);
+		close(fd);
+	}
+	c->off[0] = ARCHHDRSZ+ARCHBLKSZ;
+	for (i=0; i<c->sealed; i++)
+		c->off[i+1] = c->off[i]+c->idx[i].len;
+	if (c->off[c->sealed]>c->maplen)
+	{
+		ArchClose(c);
+		return 1;
+	}
+	if (c->nidx>0)
+	{
+		ix = &c->idx[c->nidx-1];
+		memset(ix,0,sizeof(ARCHIDX));
+		first = (c->nidx-1)*(long long)ARCHBLOCK;
+		n = c->count-first;
+		for (i=0; i<n; i++)
+		{
+			t = ArchTime(c,first+i);
+			v = ArchValue(c,first+i);
+			if ((i==0) || (v<ix->min)) ix->min = v;
+			if ((i==0) || (v>ix->max)) ix->max = v;
+			if (i==0) ix->t0 = t;
+			ix->t1 = t;
+			ix->sum += v;
+		}
+		ix->n = n;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// release a column
+void ArchClose(ARCHCOL *c)
+{
+	if (c->map!=NULL)
+		munmap(c->map,c->maplen);
+	if (c->fd>=0)
+		close(c->fd);
+	free(c->idx);
+	free(c->off);
+	free(c->tailT);
+	free(c->tailV);
+	free(c->cacheT);
+	free(c->cacheV);
+	memset(c,0,sizeof(ARCHCOL));
+	c->fd = -1;
+}
+
+//**************************************************************************
+// point times and values at block b, unpacking it if it is compressed.
+// A block that does not unpack reads as all zero
+static void Load(ARCHCOL *c, long long b)
+{
+	GORILLAREAD r;
+	int i;
+
+	c->cur = b;
+	if (b>=c->sealed)
+	{
+		c->times = c->tailT;
+		c->values = c->tailV;
+		return;
+	}
+	if (b!=c->cached)
+	{
+		GorillaReadInit(&r,(BYTE *)c->map+c->off[b],c->idx[b].len,ARCHBLOCK,c->idx[b].t0);
+		for (i=0; i<ARCHBLOCK; i++)
+			if (GorillaNext(&r,&c->cacheT[i],&c->cacheV[i]))
+				break;
+		if (i<ARCHBLOCK)
+		{
+			fprintf(stderr,"%s: block %lld is damaged\n",c->name,b);
+			memset(c->cacheT,0,ARCHBLOCK*sizeof(long long));
+			memset(c->cacheV,0,ARCHBLOCK*sizeof(double));
+		}
+		c->cached = b;
+	}
+	c->times = c->cacheT;
+	c->values = c->cacheV;
+}
+
+//**************************************************************************
+// time of sample i, ms
+long long ArchTime(ARCHCOL *c, long long i)
+{
+	if (i/ARCHBLOCK!=c->cur)
+		Load(c,i/ARCHBLOCK);
+	return c->times[i%ARCHBLOCK];
+}
+
+//**************************************************************************
+// value of sample i
+double ArchValue(ARCHCOL *c, long long i)
+{
+	if (i/ARCHBLOCK!=c->cur)
+		Load(c,i/ARCHBLOCK);
+	return c->values[i%ARCHBLOCK];
+}
+
+//**************************************************************************
+// find the first sample at or after time t (ms)
+//  RETURNS: its index, or count if there is none
+long long ArchFind(ARCHCOL *c, long long t)
+{
+	int lo = 0, hi = c->nidx, mid;
+	long long a, b, m;
+
+	// first block that ends at or after t
+	while (lo<hi)
+	{
+		mid = (lo+hi)/2;
+		if (c->idx[mid].t1<t)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	if (lo>=c->nidx)
+		return c->count;
+
+	// then inside that block
+	if (lo!=c->cur)
+		Load(c,lo);
+	a = 0;
+	b = c->idx[lo].n;
+	while (a<b)
+	{
+		m = (a+b)/2;
+		if (c->times[m]<t)
+			a = m+1;
+		else
+			b = m;
+	}
+	return (long long)lo*ARCHBLOCK + a;
+}
+
+//**************************************************************************
+// count, min, max and sum of the samples from time from up to but
+// not including to (ms).  Blocks that lie wholly inside the range are
+// taken from the index without reading or unpacking them
+void ArchAggregate(ARCHCOL *c, long long from, long long to, ARCHAGG *a)
+{
+	long long i;
+	ARCHIDX *ix;
+	double v;
+
+	memset(a,0,sizeof(ARCHAGG));
+	i = ArchFind(c,from);
+	while (i<c->count)
+	{
+		ix = &c->idx[i/ARCHBLOCK];
+		if ((i%ARCHBLOCK==0) && (ix->n>0) && (ix->t1<to))
+		{
+			if ((a->count==0) || (ix->min<a->min)) a->min = ix->min;
+			if ((a->count==0) || (ix->max>a->max)) a->max = ix->max;
+			a->sum += ix->sum;
+			a->count += ix->n;
+			i += ix->n;
+			continue;
+		}
+		if (ArchTime(c,i)>=to)
+			break;
+		v = ArchValue(c,i);
+		if ((a->count==0) || (v<a->min)) a->min = v;
+		if ((a->count==0) || (v>a->max)) a->max = v;
+		a->sum += v;
+		a->count++;
+		i++;
+	}
+}
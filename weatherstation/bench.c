@@ -0,0 +1,527 @@
+/*---------------------------------------------------------------------------
+   bench.c   end to end throughput and latency benchmark
+	2026-10-17   initial edits
+
+	Runs the real rain, anemometer, sensor scheduler and database writer
+	threads on the simulator backend at rates far above real weather,
+	plus producer threads that push extra samples into StoreSample().
+	Prints one JSON object with the throughput and the p50/p99/p999
+	latency of each stage, so results can be kept and compared between
+	releases.
+
+	usage: weatherstation-bench [-t secs] [-w windHz] [-r rainHz]
+	           [-s samples/sec] [-p producers] [-c conffile] [-m]
+	           [-a archivedir] [-H scrapes/sec] [-o outfile]
+	       weatherstation-bench -g [-o outfile]
+	  -m  insert into the MySQL server named in the config file
+	      instead of throwing rows away
+	  -a  also append every sample to a column archive there
+	  -H  run the status server on 127.0.0.1:18080 and fetch /metrics
+	      over one keep-alive connection at this rate
+
+	2026-10-17   -g runs the series codec (gorilla.c) over made up
+	             weather series instead and prints bytes per sample
+	             and encode and decode speed, plus what a batch takes
+	             packed (pack.c) against line protocol and csv.
+
+---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define EXTERN
+#include "weatherstation.h"
+
+#define MAXPROD 32
+
+static HISTOGRAM	histStore;			// StoreSample() call
+static HISTOGRAM	histLog;			// Log() call
+static HISTOGRAM	histSnap;			// SnapRead() call
+static HISTOGRAM	histScrape;			// GET /metrics round trip
+static double		scrapeRate = 0;		// scrapes per second
+static unsigned long scrapeErrors;
+static double		rate = 20000;		// extra samples per second
+static int			nprod = 4;
+static unsigned long behind;			// samples skipped, producer too slow
+
+//**************************************************************************
+// push samples at rate/nprod per second
+static void *Producer(void *param)
+{
+	char name[32];
+	int id;
+	unsigned long n = 0;
+	unsigned long long t0, now, next, step;
+
+	sprintf(name,"bench%ld",(long)param);
+	id = MetricId(name);
+	step = 1e9*nprod/rate;
+	next = MonoNs();
+	while (kicked==0)
+	{
+		// send everything that is due, then let the others run
+		now = MonoNs();
+		if (now-next>1000000000ULL)
+		{
+			__atomic_add_fetch(&behind,(now-next)/step,__ATOMIC_RELAXED);
+			next = now;
+		}
+		while (next<=now)
+		{
+			t0 = MonoNs();
+			StoreSample(id,(double)n,TimeNow());
+			HistAdd(&histStore,MonoNs()-t0);
+			if ((n%1000)==0)
+			{
+				t0 = MonoNs();
+				Log("bench> %s sample %lu",name,n);
+				HistAdd(&histLog,MonoNs()-t0);
+			}
+			n++;
+			next += step;
+		}
+		Sleep(1);
+	}
+	return 0;
+}
+
+//**************************************************************************
+// read the snapshot the way a dashboard would, while the threads write it
+static void *Reader(void *param)
+{
+	SNAPSHOT s;
+	unsigned long long t0;
+
+	while (kicked==0)
+	{
+		t0 = MonoNs();
+		SnapRead(SnapLocal(),&s);
+		HistAdd(&histSnap,MonoNs()-t0);
+		usleep(100);
+	}
+	return 0;
+}
+
+//**************************************************************************
+// connect to the status server
+static int Connect(void)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(httpPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	fd = socket(AF_INET,SOCK_STREAM,0);
+	if ((fd>=0) && connect(fd,(struct sockaddr*)&addr,sizeof(addr)))
+	{
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+//**************************************************************************
+// fetch /metrics at scrapeRate like a busy Prometheus would
+static void *Scraper(void *param)
+{
+	char req[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	char buf[32768], *p;
+	int fd = -1, n, have, need;
+	unsigned long long t0, next, step;
+
+	step = 1e9/scrapeRate;
+	next = MonoNs();
+	while (kicked==0)
+	{
+		if (fd<0)
+			fd = Connect();
+		t0 = MonoNs();
+		need = -1;
+		have = 0;
+		if ((fd<0) || (write(fd,req,sizeof(req)-1)!=sizeof(req)-1))
+			need = -2;
+		// read the header, then as much body as it says
+		while ((need==-1) || (have<need))
+		{
+			n = read(fd,buf+have,sizeof(buf)-1-have);
+			if (n<=0)
+			{
+				need = -2;
+				break;
+			}
+			have += n;
+			buf[have] = 0;
+			if ((need==-1) && ((p = strstr(buf,"\r\n\r\n"))!=NULL))
+			{
+				need = p+4-buf;
+				p = strstr(buf,"Content-Length:");
+				need += (p!=NULL) ? atoi(p+15) : 0;
+			}
+		}
+		if (need==-2)
+		{
+			scrapeErrors++;
+			if (fd>=0) close(fd);
+			fd = -1;
+		}
+		else
+			HistAdd(&histScrape,MonoNs()-t0);
+		next += step;
+		t0 = MonoNs();
+		if (next>t0)
+			usleep((next-t0)/1000);
+	}
+	if (fd>=0)
+		close(fd);
+	return 0;
+}
+
+#define CODECN		(ARCHBLOCK*256)		// samples per series for -g
+#define CODECBATCH	100					// samples per packed batch
+
+// made up series for -g, a reading every period ms with some jitter,
+// rounded the way the sensors report them
+static struct {
+	char	*name;
+	int		period, jitter;
+	double	start, step, round;			// random walk, step is the most
+	double	still;						// chance it does not move
+} series[] = {
+	{"outsideTemp",	2000, 3, 51.2,  0.1,  0.1,  0.6},
+	{"humidity",	2000, 3, 62.0,  0.1,  0.1,  0.5},
+	{"barometric",	2000, 3, 29.92, 0.01, 0.01, 0.9},
+	{"wind_speed",	1000, 1, 8.0,   2.0,  0.1,  0.1},
+	{"rainfall",	10000,0, 0.0,   0.01, 0.01, 0.98},
+	{"counter",		1,    0, 0.0,   1.0,  1.0,  0.0},
+};
+#define NSERIES		((int)(sizeof(series)/sizeof(series[0])))
+
+static unsigned long long rnd = 88172645463325252ULL;
+
+//**************************************************************************
+// xorshift, 0..1
+static double Rnd(void)
+{
+	rnd ^= rnd<<13;
+	rnd ^= rnd>>7;
+	rnd ^= rnd<<17;
+	return (rnd>>11)/9007199254740992.0;
+}
+
+//**************************************************************************
+// fill t and v with n samples of series k
+static void MakeSeries(int k, long long *t, double *v, int n)
+{
+	double x = series[k].start;
+	long long now = 1792000000000LL;
+	int i;
+
+	for (i=0; i<n; i++)
+	{
+		now += series[k].period;
+		t[i] = now + (series[k].jitter ? (long long)(Rnd()*(2*series[k].jitter+1))-series[k].jitter : 0);
+		if (Rnd()>=series[k].still)
+		{
+			if (k==NSERIES-1)
+				x += series[k].step;
+			else
+				x += (Rnd()*2-1)*series[k].step;
+			if ((k==3) && (x<0))
+				x = -x;
+		}
+		v[i] = round(x/series[k].round)*series[k].round;
+	}
+}
+
+//**************************************************************************
+// time the codec over each series in archive sized blocks, then pack
+// batches of the weather series mixed together
+//  RETURNS: 0 for success, 1 on error
+static int Codec(FILE *out)
+{
+	long long *t = malloc(CODECN*sizeof(long long)), tt;
+	double *v = malloc(CODECN*sizeof(double)), vv;
+	BYTE *z = malloc((size_t)(CODECN/ARCHBLOCK)*ARCHZMAX);
+	int *zlen = malloc((CODECN/ARCHBLOCK)*sizeof(int));
+	SAMPLE s[CODECBATCH];
+	char *text = malloc(CODECBATCH*100);
+	BYTE packed[PACKSIZE(CODECBATCH)];
+	GORILLA g;
+	GORILLAREAD r;
+	unsigned long long t0, enc, dec, bytes;
+	unsigned long long pk = 0, line = 0, csv = 0, bad = 0;
+	int k, b, i, n, m, ids[NSERIES];
+
+	if ((t==NULL) || (v==NULL) || (z==NULL) || (zlen==NULL) || (text==NULL))
+		return 1;
+	fprintf(out,"{\"codec\":{\n");
+	for (k=0; k<NSERIES; k++)
+	{
+		MakeSeries(k,t,v,CODECN);
+		bytes = 0;
+		t0 = MonoNs();
+		for (b=0; b<CODECN/ARCHBLOCK; b++)
+		{
+			GorillaInit(&g,z+(size_t)b*ARCHZMAX,ARCHZMAX,t[b*ARCHBLOCK]);
+			for (i=0; i<ARCHBLOCK; i++)
+				GorillaPut(&g,t[b*ARCHBLOCK+i],v[b*ARCHBLOCK+i]);
+			zlen[b] = GorillaBytes(&g);
+			bytes += zlen[b];
+		}
+		enc = MonoNs()-t0;
+		t0 = MonoNs();
+		for (b=0; b<CODECN/ARCHBLOCK; b++)
+		{
+			GorillaReadInit(&r,z+(size_t)b*ARCHZMAX,zlen[b],ARCHBLOCK,t[b*ARCHBLOCK]);
+			for (i=0; i<ARCHBLOCK; i++)
+			{
+				GorillaNext(&r,&tt,&vv);
+				if ((tt!=t[b*ARCHBLOCK+i]) || (vv!=v[b*ARCHBLOCK+i]))
+					bad++;
+			}
+		}
+		dec = MonoNs()-t0;
+		fprintf(out,"  \"%s\":{\"bytes_per_sample\":%.3f,\"vs_raw\":%.1f,"
+					"\"encode_per_sec\":%.0f,\"decode_per_sec\":%.0f},\n",
+					series[k].name,(double)bytes/CODECN,16.0*CODECN/bytes,
+					CODECN/(enc/1e9),CODECN/(dec/1e9));
+	}
+
+	// the weather series interleaved as they would reach a sink
+	m = CODECN/NSERIES;
+	for (k=0; k<NSERIES-1; k++)
+	{
+		ids[k] = MetricId(series[k].name);
+		MakeSeries(k,t+k*m,v+k*m,m);
+	}
+	n = 0;
+	for (i=0; i<m; i++)
+		for (k=0; k<NSERIES-1; k++)
+		{
+			s[n].metric = ids[k];
+			s[n].kind = SAMPLE_VALUE;
+			s[n].value = v[k*m+i];
+			s[n].dt = t[k*m+i]/1000.0;
+			if (++n==CODECBATCH)
+			{
+				pk += SamplePack(s,n,packed,sizeof(packed));
+				line += SinkFormat(s,n,SINKLINE,text,CODECBATCH*100);
+				csv += SinkFormat(s,n,SINKCSV,text,CODECBATCH*100);
+				n = 0;
+			}
+		}
+	n = m*(NSERIES-1)-n;
+	fprintf(out,"  \"mismatches\":%llu},\n",bad);
+	fprintf(out," \"batch\":{\"samples\":%d,\"packed_bytes_per_sample\":%.3f,"
+				"\"line_bytes_per_sample\":%.3f,\"csv_bytes_per_sample\":%.3f,"
+				"\"vs_line\":%.1f}\n}\n",
+				CODECBATCH,(double)pk/n,(double)line/n,(double)csv/n,(double)line/pk);
+	free(t);
+	free(v);
+	free(z);
+	free(zlen);
+	free(text);
+	return 0;
+}
+
+//**************************************************************************
+static void Usage(void)
+{
+	fprintf(stderr,"usage: weatherstation-bench [-t secs] [-w windHz] [-r rainHz]\n"
+				   "          [-s samples/sec] [-p producers] [-c conffile] [-m] [-a archivedir]\n"
+				   "          [-H scrapes/sec] [-o outfile]\n"
+				   "       weatherstation-bench -g [-o outfile]\n");
+	exit(1);
+}
+
+//**************************************************************************
+int main(int argc, char *argv[])
+{
+	pthread_t	tiddb, tidr, tida, tidi, tids, tidh = 0, tidc = 0;
+	pthread_t	tidp[MAXPROD];
+	double		secs = 10, windHz = 2000, rainHz = 500, elapsed;
+	int			c, i, n, mysql = 0, codec = 0;
+	char		*outName = NULL;
+	char		buf[400];
+	FILE		*out = stdout;
+	DBSTATS		db;
+	I2CSTATS	i2;
+	SENSOR		*sens[MAXSENSORS];
+	SINK		*sinks[MAXSINKS];
+	unsigned long reads = 0, errors = 0;
+	unsigned long long t0;
+
+	while ((c = getopt(argc,argv,"t:w:r:s:p:c:ma:H:o:g"))!=-1)
+	{
+		switch (c)
+		{
+			case 't':	secs = atof(optarg);	break;
+			case 'w':	windHz = atof(optarg);	break;
+			case 'r':	rainHz = atof(optarg);	break;
+			case 's':	rate = atof(optarg);	break;
+			case 'p':	nprod = atoi(optarg);	break;
+			case 'c':	strncpy(confFile,optarg,sizeof(confFile)-1);	break;
+			case 'm':	mysql = 1;				break;
+			case 'a':	strncpy(archivedir,optarg,sizeof(archivedir)-1);	break;
+			case 'H':	scrapeRate = atof(optarg);	break;
+			case 'o':	outName = optarg;		break;
+			case 'g':	codec = 1;				break;
+			default:	Usage();
+		}
+	}
+	if (codec)
+	{
+		if ((outName!=NULL) && ((out = fopen(outName,"w"))==NULL))
+		{
+			perror(outName);
+			return 1;
+		}
+		c = Codec(out);
+		if (out!=stdout)
+			fclose(out);
+		return c;
+	}
+	if ((nprod<1)||(nprod>MAXPROD)||(rate<=0)||(secs<=0))
+		Usage();
+
+	LogOpen("/tmp/weatherstation-bench");
+	LogStart();
+
+	// settings for a fast run, database from the config if asked for
+	strcpy(dbtype,mysql?"mysql":"null");
+	ConfigLoad(confFile);
+	ConfigCopy("database","weather",dbdatabase,sizeof(dbdatabase));
+	ConfigCopy("dbhost","localhost",dbhost,sizeof(dbhost));
+	ConfigCopy("dbuser","ted",dbuser,sizeof(dbuser));
+	ConfigCopy("dbpass","secret",dbpass,sizeof(dbpass));
+	dbbatch = 100;
+	dbflush = 1;
+	dbqsize = 65536;
+	spooldir[0] = 0;
+	windReport = 1;
+	i2cPeriod = 10;
+	strcpy(tempA_ID,"28-000000bench");
+
+	HalSelect("sim");
+	SimRates(windHz,rainHz);
+	if (hal->setup()==-1)
+	{
+		fprintf(stderr,"simulator setup failed\n");
+		return 1;
+	}
+	if (DbQueueInit())
+	{
+		fprintf(stderr,"queue setup failed\n");
+		return 1;
+	}
+
+	// start the pipeline
+	t0 = MonoNs();
+	pthread_create(&tiddb,NULL,dbthread,NULL);
+	pthread_create(&tidr,NULL,rainthread,NULL);
+	pthread_create(&tida,NULL,anemometerthread,NULL);
+	pthread_create(&tidi,NULL,sensorthread,NULL);
+	for (i=0; i<nprod; i++)
+		pthread_create(&tidp[i],NULL,Producer,(void*)(long)i);
+	pthread_create(&tids,NULL,Reader,NULL);
+	if (scrapeRate>0)
+	{
+		httpPort = 18080;
+		strcpy(httpAddr,"127.0.0.1");
+		pthread_create(&tidh,NULL,httpthread,NULL);
+		usleep(100000);
+		pthread_create(&tidc,NULL,Scraper,NULL);
+	}
+
+	usleep(secs*1000000);
+
+	// stop producers, then let the writer finish
+	kicked = 2;
+	RainWake();
+	pthread_join(tidr,NULL);
+	pthread_join(tida,NULL);
+	pthread_join(tidi,NULL);
+	for (i=0; i<nprod; i++)
+		pthread_join(tidp[i],NULL);
+	pthread_join(tids,NULL);
+	if (tidc!=0) pthread_join(tidc,NULL);
+	dbStop = 1;
+	pthread_join(tiddb,NULL);
+	elapsed = (MonoNs()-t0)/1e9;
+	if (tidh!=0) pthread_join(tidh,NULL);
+	LogStop();
+
+	if (outName!=NULL)
+	{
+		out = fopen(outName,"w");
+		if (out==NULL)
+		{
+			perror(outName);
+			return 1;
+		}
+	}
+	DbGetStats(&db);
+	I2cGetStats(&i2);
+	n = SensorList(sens,MAXSENSORS);
+	for (i=0; i<n; i++)
+	{
+		reads += sens[i]->reads;
+		errors += sens[i]->errors;
+	}
+	fprintf(out,"{\"duration_s\":%.3f,\"wind_hz\":%.1f,\"rain_hz\":%.1f,"
+				"\"sample_rate\":%.1f,\"producers\":%d,\"sink\":\"%s\",\n",
+				elapsed,windHz,rainHz,rate,nprod,dbtype);
+	fprintf(out," \"samples_queued\":%lu,\"samples_stored\":%lu,\"samples_dropped\":%lu,"
+				"\"producer_behind\":%lu,\"stored_per_sec\":%.1f,\n",
+				db.queued,db.rows,db.dropped,behind,db.rows/elapsed);
+	fprintf(out," \"pulses\":%lu,\"pulse_overruns\":%lu,\"log_dropped\":%lu,"
+				"\"rollups\":%lu,\"rollups_dropped\":%lu,\n",
+				windPulses.total+rainPulses.total,windPulses.overruns+rainPulses.overruns,
+				LogDropped(),db.rollups,db.rollupsDropped);
+	fprintf(out," \"scrape_rate\":%.1f,\"scrape_errors\":%lu,\n",scrapeRate,scrapeErrors);
+	fprintf(out," \"i2c_transactions\":%lu,\"i2c_errors\":%lu,\"i2c_bytes\":%lu,\n",
+				i2.xfers,i2.errors,i2.bytes);
+	fprintf(out," \"sensors\":%d,\"sensor_reads\":%lu,\"sensor_errors\":%lu,\n",
+				n,reads,errors);
+	n = SinkList(sinks,MAXSINKS);
+	fprintf(out," \"sinks\":{");
+	for (i=0; i<n; i++)
+		fprintf(out,"%s\"%s\":{\"written\":%lu,\"dropped\":%lu,\"errors\":%lu}",
+				i ? "," : "",sinks[i]->name,sinks[i]->stats.written,
+				sinks[i]->stats.dropped,sinks[i]->stats.errors);
+	fprintf(out,"},\n");
+	fprintf(out," \"latency_ns\":{\n");
+	HistJson(&histStore,buf,sizeof(buf));
+	fprintf(out,"  \"store_call\":%s,\n",buf);
+	HistJson(&histLog,buf,sizeof(buf));
+	fprintf(out,"  \"log_call\":%s,\n",buf);
+	HistJson(&histSnap,buf,sizeof(buf));
+	fprintf(out,"  \"snapshot_read\":%s,\n",buf);
+	HistJson(&histScrape,buf,sizeof(buf));
+	fprintf(out,"  \"http_scrape\":%s,\n",buf);
+	HistJson(&histEdge,buf,sizeof(buf));
+	fprintf(out,"  \"edge_to_handler\":%s,\n",buf);
+	HistJson(&histPulse,buf,sizeof(buf));
+	fprintf(out,"  \"pulse_to_thread\":%s,\n",buf);
+	HistJson(&histPersist,buf,sizeof(buf));
+	fprintf(out,"  \"queue_to_stored\":%s,\n",buf);
+	HistJson(&histFlush,buf,sizeof(buf));
+	fprintf(out,"  \"insert\":%s,\n",buf);
+	HistJson(&histI2c,buf,sizeof(buf));
+	fprintf(out,"  \"i2c_transaction\":%s,\n",buf);
+	HistJson(&histSensor,buf,sizeof(buf));
+	fprintf(out,"  \"sensor_late\":%s\n",buf);
+	fprintf(out," }\n}\n");
+	if (out!=stdout)
+		fclose(out);
+	return 0;
+}
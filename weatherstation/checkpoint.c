@@ -0,0 +1,205 @@
+/*---------------------------------------------------------------------------
+   checkpoint.c   running totals saved across restarts
+	2026-10-17   initial edits
+
+	The rain, wind and rollup state lives in memory and used to be
+	lost on every restart.  Each owner now saves its state every
+	stateSave seconds, and at exit, into its own region of a small
+	memory mapped file (statefile), and loads it back at start up.
+
+	Each region has two copies.  CkptBegin() hands out the older one,
+	the owner writes its state straight into it, and CkptEnd() stamps
+	it with a crc and a sequence number one past the newer copy, then
+	msyncs just those pages.  A crash or power cut part way through
+	leaves the other copy whole, and CkptLoad() takes the newest copy
+	whose crc is good.  Regions have one writer each, so no locking.
+
+	Saved state is plain numbers, times in it are relative to when it
+	was saved so it survives a reboot as well.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "weatherstation.h"
+
+#define CKPTMAGIC	0x54504B43			// "CKPT"
+#define CKPTVERSION	1
+#define CKPTHDRSZ	4096
+#define CKPTFILESZ	(CKPTHDRSZ + CKPTREGIONS*2*CKPTSLOTSZ)
+
+// start of the file
+typedef struct {
+	unsigned int	magic;
+	unsigned int	version;
+	unsigned int	slotsize;
+	unsigned int	regions;
+} CKPTHDR;
+
+// start of each copy of a region, the state follows
+typedef struct {
+	unsigned long long	seq;			// newer is higher, 0 never written
+	double				saved;			// TimeNow() when written
+	unsigned int		len;			// bytes of state
+	unsigned int		crc;			// crc32 of the state
+	char				pad[40];		// to 64 bytes, see CKPTDATA
+} CKPTSLOT;
+
+#define SLOT(k,i)	((CKPTSLOT *)(map + CKPTHDRSZ + ((k)*2+(i))*CKPTSLOTSZ))
+
+static char	*map;						// NULL when there is no file
+static int	newest[CKPTREGIONS];		// copy holding the latest state, -1 none
+
+//**************************************************************************
+// is a copy whole
+static int Valid(CKPTSLOT *s)
+{
+	return (s->seq!=0) && (s->len<=CKPTDATA) && (s->crc==Crc32(s+1,s->len));
+}
+
+//**************************************************************************
+// map the checkpoint file, making it if it is not there
+//  RETURNS: 0 for success, 1 if state will not be kept
+int CkptInit(char *file)
+{
+	CKPTHDR *h;
+	struct stat st;
+	int fd, k, fresh;
+
+	for (k=0; k<CKPTREGIONS; k++)
+		newest[k] = -1;
+	if (file[0]==0)
+		return 1;
+	fd = open(file,O_RDWR|O_CREAT,0644);
+	if (fd<0)
+	{
+		Log("checkpoint> error %d opening %s, state not kept",errno,file);
+		return 1;
+	}
+	if (fstat(fd,&st))
+		st.st_size = 0;
+	fresh = (st.st_size!=CKPTFILESZ);
+	if (fresh && (ftruncate(fd,0) || ftruncate(fd,CKPTFILESZ)))
+	{
+		Log("checkpoint> error %d sizing %s, state not kept",errno,file);
+		close(fd);
+		return 1;
+	}
+	map = mmap(NULL,CKPTFILESZ,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if (map==MAP_FAILED)
+	{
+		map = NULL;
+		Log("checkpoint> error %d mapping %s, state not kept",errno,file);
+		return 1;
+	}
+	h = (CKPTHDR *)map;
+	if ((h->magic!=CKPTMAGIC) || (h->version!=CKPTVERSION) ||
+		(h->slotsize!=CKPTSLOTSZ) || (h->regions!=CKPTREGIONS))
+	{
+		if (!fresh)
+			Log("checkpoint> %s is from another version, starting over",file);
+		memset(map,0,CKPTFILESZ);
+		h->magic = CKPTMAGIC;
+		h->version = CKPTVERSION;
+		h->slotsize = CKPTSLOTSZ;
+		h->regions = CKPTREGIONS;
+		msync(map,CKPTFILESZ,MS_SYNC);
+	}
+
+	for (k=0; k<CKPTREGIONS; k++)
+	{
+		if (Valid(SLOT(k,0)))
+			newest[k] = 0;
+		if (Valid(SLOT(k,1)) && ((newest[k]<0) || (SLOT(k,1)->seq>SLOT(k,0)->seq)))
+			newest[k] = 1;
+	}
+	Log("checkpoint> %s",file);
+	return 0;
+}
+
+//**************************************************************************
+// unmap the file, the owners have saved their last state by now
+void CkptClose(void)
+{
+	if (map==NULL)
+		return;
+	msync(map,CKPTFILESZ,MS_SYNC);
+	munmap(map,CKPTFILESZ);
+	map = NULL;
+}
+
+//**************************************************************************
+// the last state saved for a region
+//  RETURNS: pointer to it, NULL if there is none.  len is set to its
+//           size and saved to the TimeNow() it was written
+void *CkptLoad(int region, int *len, double *saved)
+{
+	CKPTSLOT *s;
+
+	if ((map==NULL) || (newest[region]<0))
+		return NULL;
+	s = SLOT(region,newest[region]);
+	*len = s->len;
+	*saved = s->saved;
+	return s+1;
+}
+
+//**************************************************************************
+// start saving a region, write up to CKPTDATA bytes of state at the
+// pointer returned then call CkptEnd()
+//  RETURNS: where to write, NULL if state is not kept
+void *CkptBegin(int region)
+{
+	if (map==NULL)
+		return NULL;
+	return SLOT(region,(newest[region]==0) ? 1 : 0) + 1;
+}
+
+//**************************************************************************
+// finish saving len bytes, they become the newest copy
+void CkptEnd(int region, int len)
+{
+	CKPTSLOT *s, *old;
+	int i;
+	long pg = sysconf(_SC_PAGESIZE);
+	char *p;
+
+	if ((map==NULL) || (len<0) || (len>CKPTDATA))
+		return;
+	i = (newest[region]==0) ? 1 : 0;
+	s = SLOT(region,i);
+	old = (newest[region]<0) ? NULL : SLOT(region,newest[region]);
+	s->len = len;
+	s->crc = Crc32(s+1,len);
+	s->saved = TimeNow();
+	__atomic_store_n(&s->seq,(old!=NULL) ? old->seq+1 : 1,__ATOMIC_RELEASE);
+	newest[region] = i;
+
+	// only the pages this copy uses
+	p = (char *)s;
+	msync(p,((sizeof(CKPTSLOT)+len+pg-1)/pg)*pg,MS_SYNC);
+}
+
+//**************************************************************************
+// time for an owner to save again?  last is its MonoNs() of the last
+// save, updated when this says yes
+//  RETURNS: 1 if a save is due
+int CkptDue(unsigned long long *last)
+{
+	unsigned long long now;
+
+	if ((map==NULL) || (stateSave<=0))
+		return 0;
+	now = MonoNs();
+	if (now-*last<stateSave*1000000000ULL)
+		return 0;
+	*last = now;
+	return 1;
+}
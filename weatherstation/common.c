@@ -3,6 +3,10 @@
          Ted Hale
 	
 	26-Dec-2014  add lock on all MySQL functions to prevent crashes
+	17-Oct-2026  MySQL access moved to dbthread, StoreToDB removed
+	17-Oct-2026  config lock is a plain mutex, no wiringPi needed here
+	17-Oct-2026  ReadConfigString replaced by config.c
+	17-Oct-2026  read_line removed, nothing uses it
 	
 ---------------------------------------------------------------------------*/
 
@@ -10,13 +14,14 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <sys/timeb.h>
+#include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 
-#include <wiringPi.h>
 #include "weatherstation.h"
 
 //***************************************************************************
@@ -26,121 +31,83 @@ int Sleep(int millisecs)
 	return usleep(1000*millisecs);
 }
 
-//************************************************************************
-// read chars into buffer until EOF or newline
-int read_line(FILE *fp, char *bp, int mx)
-{   char c = '\0';
-    int i = 0;
-	memset(bp,0,mx);
-    /* Read one line from the source file */
-    while ( ( (c = getc(fp)) != '\n' ) && (i<mx) )
-    {   
-		if ((c == EOF)||(c == 255))         /* return -1 on EOF */
-		{
-			LogDbg("read_line> got EOF");
-			sleep(1);
-			if (i>0) break;
-            else return(-1);
-		}
-        bp[i++] = c;
-    }
-    bp[i] = '\0';
-    return(i);
+//***************************************************************************
+// monotonic time in nanoseconds, used to time pulses
+unsigned long long MonoNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+//***************************************************************************
+// current unix time with microseconds, used to stamp samples
+double TimeNow(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec + tv.tv_usec/1000000.0;
 }
 
 //************************************************************************
-// get var=value from config file
-int ReadConfigString(char *var, char *defaultVal, char *out, int sz, char *file)
+// standard crc32 (poly 0xEDB88320), used by the spool and checkpoint
+unsigned int Crc32(const void *buf, int len)
 {
-	FILE	*f;
-	char	line[100];
-	char	*p;
+	const unsigned char *p = buf;
+	unsigned int crc = 0xFFFFFFFF;
+	int i;
 
-	LogDbg("ReadConfigString> get %s from %s ",var,file);
-	piLock(1);
-	f = fopen(file,"r");
-	if (!f)
+	while (len--)
 	{
-		Log("ReadConfigString> error %d opening %s",errno,file);
-		piUnlock(1);
-		return 1;
+		crc ^= *p++;
+		for (i=0; i<8; i++)
+			crc = (crc>>1) ^ (0xEDB88320 & (0-(crc&1)));
 	}
+	return ~crc;
+}
 
-	while (read_line(f,line,sizeof(line))>=0)
+//************************************************************************
+// Modbus crc16 (poly 0xA001), the AM2315 sends it after its data
+unsigned short Crc16(const void *buf, int len)
+{
+	const unsigned char *p = buf;
+	unsigned short crc = 0xFFFF;
+	int i;
+
+	while (len--)
 	{
-		LogDbg("ReadConfigString> read: %s",line);
-		if ((line[0]==';')||(line[0]=='#')) 
-			continue;
-		p = strchr(line,'=');
-		if (!p)
-			continue;
-		*p=0;
-		p++;
-		if (!strcmp(line,var))
-		{
-			strncpy(out,p,sz);
-			fclose(f);
-			Log("ReadConfigString> return %s=%s",var,out);
-			piUnlock(1);
-			return 1;
-		}
+		crc ^= *p++;
+		for (i=0; i<8; i++)
+			crc = (crc>>1) ^ (0xA001 & (0-(crc&1)));
 	}
-	fclose(f);
-	strncpy(out,defaultVal,sz);
-	Log("ReadConfigString> return %s=%s",var,out);
-	piUnlock(1);
-	return 0;
+	return crc;
 }
 
-
 //************************************************************************
 // connect/reconnect to MySQL database
-
+// only called from the mysql sink thread so no lock is needed
+//  RETURNS: 0 for success, 1 on error (conn is left NULL)
 int ConnectToDb()
 {
-	piLock(0);
-	///Log("ConnectToDb");
+	unsigned int timeout = 5;
+
+	if (conn!=NULL)
+		mysql_close(conn);
+	conn = mysql_init(NULL);
+	if (conn==NULL)
+	{
+		Log("MySQL init failed");
+		return 1;
+	}
+	mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
 	if (mysql_real_connect(conn, dbhost, dbuser, dbpass, dbdatabase, 0, NULL, 0) == NULL) {
 		Log("MySQL connect error %u: %s\n", mysql_errno(conn), mysql_error(conn));
 		mysql_close(conn);
+		conn = NULL;
 		return 1;
 	}
-	else
-	{
-		Log(" ***** Connected to MySQL on %s",dbhost);
-	}
-	piUnlock(0);
+	Log(" ***** Connected to MySQL on %s",dbhost);
 	return 0;
 }
-
-//************************************************************************
-// store a value in the database
-void StoreToDB(char* var, char* val)
-{
-	char sql[100];
-	int cnt=0;
-	
-	// ignore if no MySQL connection
-	if (conn!=NULL) 
-	{
-		piLock(0);
-		///Log("StoreToDB begin");
-		sprintf(sql,"insert into data (name,value) VALUES ('%s',%s)",var,val);
-		while (cnt<5)
-		{
-			if (mysql_query(conn, sql)&&(mysql_errno(conn)!=0)) {
-				Log("mysql_query Error sql: %s\n         errno = %u:   %s", 
-							sql, mysql_errno(conn), mysql_error(conn));
-				// reconnect
-				ConnectToDb();
-			}
-			else
-			{
-				///Log("StoreToDB  %s  %s",var,val);
-				cnt=999;
-			}
-			cnt++;
-		}
-		piUnlock(0);
-	}
-}
\ No newline at end of file
@@ -0,0 +1,388 @@
+/*---------------------------------------------------------------------------
+   config.c   configuration file, parsed once into a hash table
+	2026-10-17   initial edits
+
+	ConfigLoad() reads the whole file and indexes every name=value line
+	in an open addressed hash table.  After that every lookup is a hash
+	and a string compare, from any thread and without a lock: the table
+	is never changed once it is published, a new load builds a new one
+	and swaps the pointer.
+
+	A SIGHUP loads the file again while the threads keep running.  Each
+	load bumps ConfigGen(), a thread that keeps settings of its own
+	compares it each time round its loop and looks them up again when
+	it has moved.  A reader may still be using the old table when it
+	is replaced so old tables are only freed at exit, a few KB for
+	each reload.  A reload that can not read the file changes nothing.
+
+	Lines are name=value, blanks around either are ignored, lines
+	starting with ; or # are comments.  A [section] line starts a block,
+	the names in it are looked up as "section.name".  Names before the
+	first section have no prefix.  e.g.
+
+		[probe.garden]
+		id=28-000004fcf3ce
+
+	is ConfigStr("probe.garden.id",...), and ConfigSections("probe.")
+	lists every probe block in the file.
+
+	A name given twice keeps its first value, as the old line by line
+	reader did.  The typed getters check the value and fall back to the
+	default, or the nearest limit, with a log line saying so.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#include "weatherstation.h"
+
+#define MAXSECTIONS		64
+
+// one name=value
+typedef struct {
+	char		*key;					// "section.name"
+	char		*value;					// points into the file text
+	unsigned	hash;
+	int			line;
+} CONFENT;
+
+// one loaded file
+typedef struct CONFIG {
+	char		*text;					// whole file, values point into it
+	CONFENT		*slot;					// hash table, size a power of 2
+	int			size;
+	int			count;
+	char		*sections[MAXSECTIONS];	// in file order
+	int			nsect;
+	struct CONFIG	*prev;				// replaced tables, freed at exit
+} CONFIG;
+
+static CONFIG *config;
+static int gen;							// loads so far
+
+//**************************************************************************
+// FNV-1a
+static unsigned Hash(char *s)
+{
+	unsigned h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+//**************************************************************************
+// strip blanks from both ends, in place
+static char *Trim(char *s)
+{
+	char *e;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	e = s+strlen(s);
+	while ((e>s) && isspace((unsigned char)e[-1]))
+		*--e = 0;
+	return s;
+}
+
+//**************************************************************************
+// find a name in a table
+static CONFENT *Find(CONFIG *c, char *key)
+{
+	unsigned h, i;
+
+	if ((c==NULL) || (c->size==0))
+		return NULL;
+	h = Hash(key);
+	for (i=h&(c->size-1); c->slot[i].key!=NULL; i=(i+1)&(c->size-1))
+		if ((c->slot[i].hash==h) && !strcmp(c->slot[i].key,key))
+			return &c->slot[i];
+	return NULL;
+}
+
+//**************************************************************************
+static void Free(CONFIG *c)
+{
+	int i;
+
+	for (i=0; i<c->size; i++)
+		free(c->slot[i].key);
+	for (i=0; i<c->nsect; i++)
+		free(c->sections[i]);
+	free(c->slot);
+	free(c->text);
+	free(c);
+}
+
+//**************************************************************************
+// read and index a file
+//  RETURNS: the new table, NULL if out of memory.  A file that can not
+//           be read gives an empty table
+static CONFIG *Parse(char *file)
+{
+	CONFIG	*c;
+	FILE	*f;
+	long	len;
+	char	*p, *next, *key, *val, *sect = NULL;
+	int		line, lines, i;
+	CONFENT	*e;
+	unsigned h;
+
+	c = calloc(1,sizeof(CONFIG));
+	if (c==NULL)
+		return NULL;
+	f = fopen(file,"r");
+	if (f==NULL)
+	{
+		Log("config> error %d opening %s",errno,file);
+		return c;
+	}
+	fseek(f,0,SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	c->text = (len>=0) ? malloc(len+1) : NULL;
+	if ((c->text==NULL) || (fread(c->text,1,len,f)!=len))
+	{
+		Log("config> error reading %s",file);
+		free(c->text);
+		c->text = NULL;
+		fclose(f);
+		return c;
+	}
+	fclose(f);
+	c->text[len] = 0;
+
+	// room for every line, at most half full
+	for (lines=1, p=c->text; *p; p++)
+		if (*p=='\n')
+			lines++;
+	for (c->size=16; c->size<2*lines; c->size*=2)
+		;
+	c->slot = calloc(c->size,sizeof(CONFENT));
+	if (c->slot==NULL)
+	{
+		Free(c);
+		return NULL;
+	}
+
+	for (p=c->text, line=1; p!=NULL; p=next, line++)
+	{
+		next = strchr(p,'\n');
+		if (next!=NULL)
+			*next++ = 0;
+		p = Trim(p);
+		if ((*p==0) || (*p==';') || (*p=='#'))
+			continue;
+		if (*p=='[')
+		{
+			val = strchr(p,']');
+			if ((val==NULL) || (val[1]!=0) || (val==p+1))
+			{
+				Log("config> %s line %d: bad section %s",file,line,p);
+				continue;
+			}
+			*val = 0;
+			sect = Trim(p+1);
+			if (c->nsect>=MAXSECTIONS)
+				Log("config> %s line %d: more than %d sections",file,line,MAXSECTIONS);
+			else if ((c->sections[c->nsect] = strdup(sect))!=NULL)
+				c->nsect++;
+			continue;
+		}
+		val = strchr(p,'=');
+		if ((val==NULL) || (val==p))
+		{
+			Log("config> %s line %d ignored: %s",file,line,p);
+			continue;
+		}
+		*val++ = 0;
+		p = Trim(p);
+		val = Trim(val);
+		if (sect!=NULL)
+		{
+			key = malloc(strlen(sect)+strlen(p)+2);
+			if (key!=NULL)
+				sprintf(key,"%s.%s",sect,p);
+		}
+		else
+			key = strdup(p);
+		if (key==NULL)
+			continue;
+
+		e = Find(c,key);
+		if (e!=NULL)
+		{
+			Log("config> %s line %d: %s already set on line %d",file,line,key,e->line);
+			free(key);
+			continue;
+		}
+		h = Hash(key);
+		for (i=h&(c->size-1); c->slot[i].key!=NULL; i=(i+1)&(c->size-1))
+			;
+		c->slot[i].key = key;
+		c->slot[i].value = val;
+		c->slot[i].hash = h;
+		c->slot[i].line = line;
+		c->count++;
+	}
+	return c;
+}
+
+//**************************************************************************
+// read a config file and make it the one all lookups use.  A reload
+// that can not read the file keeps the table in use and ConfigGen()
+// does not move
+//  RETURNS: 0 for success, 1 if it could not be read (defaults apply
+//           on the first load)
+int ConfigLoad(char *file)
+{
+	CONFIG *c, *old;
+	int i;
+
+	c = Parse(file);
+	if (c==NULL)
+	{
+		Log("config> no memory for %s",file);
+		return 1;
+	}
+	if ((c->text==NULL) && (config!=NULL))
+	{
+		Log("config> keeping the settings already loaded");
+		Free(c);
+		return 1;
+	}
+	if (c->text==NULL)
+		Log("config> using defaults");
+	for (i=0; i<c->size; i++)
+		if (c->slot[i].key!=NULL)
+			LogDbg("config> %s=%s",c->slot[i].key,c->slot[i].value);
+	Log("config> %d settings in %d sections from %s",c->count,c->nsect,file);
+
+	// readers may still hold the old table, it is kept until exit
+	old = config;
+	c->prev = old;
+	__atomic_store_n(&config,c,__ATOMIC_RELEASE);
+	__atomic_add_fetch(&gen,1,__ATOMIC_RELEASE);
+	return (c->text==NULL);
+}
+
+//**************************************************************************
+// how many times a config has been loaded, changes on every reload
+int ConfigGen(void)
+{
+	return __atomic_load_n(&gen,__ATOMIC_ACQUIRE);
+}
+
+//**************************************************************************
+// drop every table, only once nothing can be reading them
+void ConfigFree(void)
+{
+	CONFIG *c, *prev;
+
+	c = config;
+	config = NULL;
+	for (; c!=NULL; c=prev)
+	{
+		prev = c->prev;
+		Free(c);
+	}
+}
+
+//**************************************************************************
+// look up a string
+//  RETURNS: the value, or def if it is not set.  The value stays valid
+//           until ConfigFree()
+char *ConfigStr(char *key, char *def)
+{
+	CONFENT *e;
+
+	e = Find(__atomic_load_n(&config,__ATOMIC_ACQUIRE),key);
+	return (e!=NULL) ? e->value : def;
+}
+
+//**************************************************************************
+// copy a string into a buffer
+//  RETURNS: 1 if the value was set, 0 if the default was used
+int ConfigCopy(char *key, char *def, char *out, int sz)
+{
+	char *v;
+
+	v = ConfigStr(key,NULL);
+	if (v==NULL)
+		v = def;
+	if (strlen(v)>=sz)
+		Log("config> %s is longer than %d characters, cut short",key,sz-1);
+	snprintf(out,sz,"%s",v);
+	return (v!=def);
+}
+
+//**************************************************************************
+// look up a whole number, limited to min..max
+//  RETURNS: the value, def if it is not set or not a number
+int ConfigInt(char *key, int def, int min, int max)
+{
+	char *v, *end;
+	long n;
+
+	v = ConfigStr(key,NULL);
+	if ((v==NULL) || (*v==0))
+		return def;
+	errno = 0;
+	n = strtol(v,&end,0);
+	if ((errno!=0) || (*end!=0))
+	{
+		Log("config> %s=%s is not a whole number, using %d",key,v,def);
+		return def;
+	}
+	if ((n<min) || (n>max))
+	{
+		n = (n<min) ? min : max;
+		Log("config> %s=%s is outside %d..%d, using %ld",key,v,min,max,n);
+	}
+	return n;
+}
+
+//**************************************************************************
+// look up a number, limited to min..max
+//  RETURNS: the value, def if it is not set or not a number
+double ConfigDouble(char *key, double def, double min, double max)
+{
+	char *v, *end;
+	double d;
+
+	v = ConfigStr(key,NULL);
+	if ((v==NULL) || (*v==0))
+		return def;
+	d = strtod(v,&end);
+	if ((end==v) || (*end!=0) || (d!=d))
+	{
+		Log("config> %s=%s is not a number, using %g",key,v,def);
+		return def;
+	}
+	if ((d<min) || (d>max))
+	{
+		d = (d<min) ? min : max;
+		Log("config> %s=%s is outside %g..%g, using %g",key,v,min,max,d);
+	}
+	return d;
+}
+
+//**************************************************************************
+// names of the sections that start with prefix, in file order
+//  RETURNS: how many were put in names
+int ConfigSections(char *prefix, char **names, int max)
+{
+	CONFIG *c = __atomic_load_n(&config,__ATOMIC_ACQUIRE);
+	int i, n = 0, len = strlen(prefix);
+
+	if (c==NULL)
+		return 0;
+	for (i=0; (i<c->nsect) && (n<max); i++)
+		if (!strncmp(c->sections[i],prefix,len))
+			names[n++] = c->sections[i];
+	return n;
+}
@@ -0,0 +1,236 @@
+/*---------------------------------------------------------------------------
+   dbthread.c   queue samples and send them on to the sinks
+	2026-10-17   initial edits
+
+	Sensor threads call StoreSample() which only copies the sample into
+	a lock-free ring and returns.  This thread empties the ring and
+	sends one multi-row insert when dbbatch samples are waiting or the
+	oldest one is dbflush seconds old.  A slow or dead server only
+	fills the ring; once it is full new samples are dropped and counted
+	so the sampling loops never wait on the database.
+
+	2026-10-17   typed samples, inserts use server side prepared
+	             statements with one bound (dt,name,value) group per row.
+	             A statement is prepared once for each batch size seen
+	             and reused until the connection drops.
+	2026-10-17   batches the server can not take go to the spool (spool.c)
+	             and are replayed in order once it is back.  Nothing is
+	             held in memory waiting for a retry any more.
+	2026-10-17   dbtype=null throws rows away instead of inserting, for
+	             benchmarks.  Queue-to-stored and insert times go into
+	             histPersist and histFlush.  The thread runs until
+	             main sets dbStop after the other threads are gone.
+	2026-10-17   a config reload with a new server or login closes the
+	             connection, the next pass connects with the new one.
+	2026-10-17   open rollup periods are checkpointed and carried over
+	             a restart instead of being written out part done.
+
+	2026-10-17   the MySQL writing moved to sink_mysql.c.  This thread
+	             now archives and rolls up what it takes off the queue
+	             and hands the rest to every sink (sink.c), each with
+	             its own queue and thread, so a slow output no longer
+	             holds up the others.
+	2026-10-17   emptying the queue is DbDrain() so weatherstation-replay
+	             can run it without the thread.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include "weatherstation.h"
+
+static RING		dbq;		// samples waiting to be handed on
+static sem_t	dbsem;		// posted when a full batch is waiting
+static DBSTATS	dbstats;	// counters, see DbGetStats()
+static SAMPLE	*batch;		// samples taken from the ring
+
+//**************************************************************************
+// create the sample queue and the sinks, must be called before any
+// thread stores data
+//  RETURNS: 0 for success, 1 on error
+int DbQueueInit(void)
+{
+	if (dbbatch<1)
+		dbbatch = 1;
+	if (dbqsize<dbbatch*2)
+		dbqsize = dbbatch*2;
+	if (RingInit(&dbq,dbqsize,sizeof(SAMPLE)))
+	{
+		Log("DbQueueInit> no memory for %d samples",dbqsize);
+		return 1;
+	}
+	batch = malloc(dbbatch*sizeof(SAMPLE));
+	if (batch==NULL)
+	{
+		Log("DbQueueInit> no memory for batch of %d",dbbatch);
+		return 1;
+	}
+	if (RollupInit())
+		return 1;
+	sem_init(&dbsem,0,0);
+	SinkInit();
+	Log("DbQueueInit> queue %d samples, batch %d, flush %d sec",
+				dbq.mask+1,dbbatch,dbflush);
+	return 0;
+}
+
+//**************************************************************************
+// put a sample in the queue.  Never blocks, drops it if queue is full
+static void Queue(int metric, double value, double dt, int kind)
+{
+	SAMPLE s;
+
+	if ((dbq.seq==NULL)||(metric<0))
+		return;
+	s.metric = metric;
+	s.kind = kind;
+	s.value = value;
+	s.dt = dt;
+	s.tq = MonoNs();
+	if (RingPut(&dbq,&s))
+	{
+		__atomic_add_fetch(&dbstats.dropped,1,__ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_add_fetch(&dbstats.queued,1,__ATOMIC_RELAXED);
+	// wake the writer once a batch is ready
+	if (RingCount(&dbq)==dbbatch)
+		sem_post(&dbsem);
+}
+
+//**************************************************************************
+// queue a sample for the database
+//  metric is from MetricId(), dt is when the value was measured (TimeNow())
+void StoreSample(int metric, double value, double dt)
+{
+	Queue(metric,value,dt,SAMPLE_VALUE);
+}
+
+//**************************************************************************
+// queue a single reading, it is archived and rolled up but only the
+// mean for each minute is stored in the data table
+void StoreRaw(int metric, double value, double dt)
+{
+	Queue(metric,value,dt,SAMPLE_RAW);
+}
+
+//**************************************************************************
+// queue a minute mean of raw readings, called by rollup.c
+void StoreMean(int metric, double value, double dt)
+{
+	Queue(metric,value,dt,SAMPLE_MEAN);
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void DbGetStats(DBSTATS *out)
+{
+	memcpy(out,&dbstats,sizeof(DBSTATS));
+	MysqlGetStats(out);
+	out->depth = RingCount(&dbq);
+	out->rollupsDropped = RollupDropped();
+}
+
+//**************************************************************************
+// empty the queue, new samples go to the archive and the rollups, then
+// everything but raw readings to the sinks.  Only one thread may call it
+//  RETURNS: samples taken
+int DbDrain(void)
+{
+	int i, j, n, total = 0;
+
+	for (;;)
+	{
+		n = 0;
+		while ((n<dbbatch) && (RingGet(&dbq,&batch[n])==0))
+			n++;
+		if (n==0)
+			break;
+		total += n;
+		ArchiveWrite(batch,n);
+		RollupAdd(batch,n);
+		for (i=j=0; i<n; i++)
+			if (batch[i].kind!=SAMPLE_RAW)
+				batch[j++] = batch[i];
+		SinkPut(batch,j);
+	}
+	return total;
+}
+
+//**************************************************************************
+// save the open rollup periods
+static void SaveRollups(void)
+{
+	void *p;
+
+	p = CkptBegin(CKPTROLLUP);
+	if (p!=NULL)
+		CkptEnd(CKPTROLLUP,RollupSave(p,CKPTDATA));
+}
+
+//**************************************************************************
+// Thread entry point, param is not used
+void *dbthread(void *param)
+{
+	struct timespec ts;
+	unsigned long dropped=0;
+	unsigned long long lastSave=0;
+	int len, keep;
+	double saved;
+	void *p;
+
+	if (batch==NULL)
+	{
+		Log("dbthread> queue not initialized");
+		return 0;
+	}
+	ArchiveInit(archivedir);
+
+	// carry on with the periods that were open when the last run
+	// stopped.  With a checkpoint they are kept open at exit too
+	p = CkptLoad(CKPTROLLUP,&len,&saved);
+	if (p!=NULL)
+		RollupRestore(p,len);
+	keep = (CkptBegin(CKPTROLLUP)!=NULL);
+	lastSave = MonoNs();
+	SinkStart();
+
+	// start the fan out loop
+	Log("dbthread> start fan out loop.");
+	do
+	{
+		// wait until a batch is ready or a second has passed
+		if (!dbStop && (RingCount(&dbq)<dbbatch))
+		{
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_sec += 1;
+			sem_timedwait(&dbsem,&ts);
+		}
+
+		DbDrain();
+		RollupTick(TimeNow(),dbStop && !keep);
+		if (CkptDue(&lastSave))
+			SaveRollups();
+
+		// report new drops once
+		if (dbstats.dropped!=dropped)
+		{
+			Log("dbthread> queue full, %lu samples dropped so far",dbstats.dropped);
+			dropped = dbstats.dropped;
+		}
+
+		// on exit empty the queue
+	} while (!dbStop || (RingCount(&dbq)>0));
+
+	// the sinks write out what they have, the mysql one stores the
+	// rollups the last tick closed
+	SinkStop();
+	SaveRollups();
+	ArchiveClose();
+	Log("dbthread> thread exiting");
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*---------------------------------------------------------------------------
+   filter.c   data quality checks on sensor readings before they are stored
+	2026-10-17   initial edits
+
+	Every reading a sensor gives goes through FilterCheck() before it
+	reaches the database, the archive, the rollups or the snapshot.  A
+	reading that fails is dropped and counted, so the minute averages
+	and everything after them only ever see clean data.
+
+	Three checks, each metric set up in its own [filter.metric] section:
+
+	  range    min= and max=, by default the limits the driver gives
+	           for the part.  Also catches NaN.
+	  spike    window= readings (3..31, odd, default off) and k=
+	           (default 3).  A Hampel filter, a reading more than
+	           k * 1.4826 * MAD from the median of the last window
+	           readings is a spike.  noise= is the smallest difference
+	           that can count as one, so a steady reading with a MAD of
+	           0 does not reject every change.
+	  rate     rate= most change per minute from the last good reading,
+	           default off.  Give or take noise=, for parts that read
+	           in steps.
+
+	e.g.
+		[filter.outsideTemp]
+		window=7
+		noise=0.5
+		rate=5
+
+	A real change looks like a spike or too fast at first.  Spikes stop
+	once it is half the window, and after FILTERRESET rejects in a
+	row the rate check starts again from the new level.
+
+	The window is kept sorted as well as in arrival order.  A reading
+	costs two binary searches and a short memmove to update it, the
+	median is read off the middle, and the MAD is found in O(log w) as
+	the median of two sorted runs: the distances below the median and
+	those above it.
+
+	Only the sensor scheduler calls FilterCheck(), so there is no
+	locking.  Settings are looked up again after a config reload.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "weatherstation.h"
+
+#define FILTERWIN		31				// longest median window
+#define FILTERRESET		5				// rate rejects in a row before
+										// the new level is taken
+
+// one metric's settings and state
+typedef struct {
+	int		gen;						// ConfigGen() when set up, 0 never
+	double	min, max;
+	int		win;						// 0 for no spike check
+	double	k;
+	double	noise;
+	double	rate;						// per second, 0 for none
+	double	ring[FILTERWIN];			// arrival order
+	double	sorted[FILTERWIN];
+	int		head, n;
+	double	last, lastT;				// last good reading, lastT 0 none
+	int		rejects;					// rate rejects in a row
+} FILTER;
+
+static FILTER		filters[MAXMETRICS];
+static FILTERSTATS	stats;
+
+//**************************************************************************
+// look up a metric's settings, starting its window over if it changed
+static void Setup(FILTER *f, int metric, double lo, double hi)
+{
+	char key[80], *name = MetricName(metric);
+	int win;
+
+	snprintf(key,sizeof(key),"filter.%s.min",name);
+	f->min = ConfigDouble(key,lo,-1e9,1e9);
+	snprintf(key,sizeof(key),"filter.%s.max",name);
+	f->max = ConfigDouble(key,hi,-1e9,1e9);
+	snprintf(key,sizeof(key),"filter.%s.window",name);
+	win = ConfigInt(key,0,0,FILTERWIN);
+	if ((win>0) && (win<3))
+		win = 3;
+	if ((win>0) && !(win&1))
+		win++;
+	snprintf(key,sizeof(key),"filter.%s.k",name);
+	f->k = ConfigDouble(key,3,0.5,100);
+	snprintf(key,sizeof(key),"filter.%s.noise",name);
+	f->noise = ConfigDouble(key,0,0,1e9);
+	snprintf(key,sizeof(key),"filter.%s.rate",name);
+	f->rate = ConfigDouble(key,0,0,1e9)/60;
+	if (win!=f->win)
+	{
+		f->win = win;
+		f->head = f->n = 0;
+	}
+	if (f->gen!=0)
+		LogDbg("filter> %s range %g..%g window %d rate %g/min",name,f->min,f->max,
+			   f->win,f->rate*60);
+	f->gen = ConfigGen();
+}
+
+//**************************************************************************
+// where v is, or would go, in the sorted window
+static int Find(FILTER *f, double v)
+{
+	int lo = 0, hi = f->n, mid;
+
+	while (lo<hi)
+	{
+		mid = (lo+hi)/2;
+		if (f->sorted[mid]<v)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+//**************************************************************************
+// add a reading to the window, dropping the oldest once it is full
+static void Add(FILTER *f, double v)
+{
+	int i;
+
+	if (f->n==f->win)
+	{
+		i = Find(f,f->ring[f->head]);
+		memmove(&f->sorted[i],&f->sorted[i+1],(f->n-i-1)*sizeof(double));
+		f->n--;
+	}
+	i = Find(f,v);
+	memmove(&f->sorted[i+1],&f->sorted[i],(f->n-i)*sizeof(double));
+	f->sorted[i] = v;
+	f->n++;
+	f->ring[f->head] = v;
+	f->head = (f->head+1) % f->win;
+}
+
+//**************************************************************************
+// the k'th smallest (from 0) distance from med.  The nl readings below
+// the split give distances that grow going down, the rest grow going
+// up, so this is the k'th of two sorted runs
+static double Kth(FILTER *f, int nl, double med, int k)
+{
+	double *s = f->sorted, a, b;
+	int lo, hi, i, j, nr = f->n-nl;
+
+	#define L(i)	(med - s[nl-1-(i)])
+	#define R(j)	(s[nl+(j)] - med)
+	// take i from the low run and k+1-i from the high one
+	lo = (k+1>nr) ? k+1-nr : 0;
+	hi = (k+1<nl) ? k+1 : nl;
+	while (lo<hi)
+	{
+		i = (lo+hi)/2;
+		j = k+1-i;
+		if ((j>0) && (L(i)<R(j-1)))
+			lo = i+1;
+		else
+			hi = i;
+	}
+	j = k+1-lo;
+	a = (lo>0) ? L(lo-1) : 0;
+	b = (j>0) ? R(j-1) : 0;
+	#undef L
+	#undef R
+	return (a>b) ? a : b;
+}
+
+//**************************************************************************
+// median and median absolute deviation of the window
+static void MedianMad(FILTER *f, double *med, double *mad)
+{
+	int n = f->n, h = n/2;
+
+	*med = (n&1) ? f->sorted[h] : (f->sorted[h-1]+f->sorted[h])/2;
+	*mad = (n&1) ? Kth(f,h,*med,h) : (Kth(f,h,*med,h-1)+Kth(f,h,*med,h))/2;
+}
+
+//**************************************************************************
+// check one reading from a sensor, lo and hi are the driver's limits
+// for it.  t is the unix time it was taken
+//  RETURNS: 0 if it is good, else FILTERRANGE, FILTERSPIKE or FILTERRATE
+int FilterCheck(int metric, double v, double t, double lo, double hi)
+{
+	FILTER *f;
+	double med, mad, lim;
+	int full;
+
+	if ((metric<0) || (metric>=MAXMETRICS))
+		return 0;
+	f = &filters[metric];
+	if (f->gen!=ConfigGen())
+		Setup(f,metric,lo,hi);
+
+	if ((v!=v) || (v<f->min) || (v>f->max))
+	{
+		stats.range++;
+		return FILTERRANGE;
+	}
+
+	// against the readings before it, once there are two to go on,
+	// then it joins them either way
+	if (f->win>0)
+	{
+		full = (f->n>=2);
+		if (full)
+			MedianMad(f,&med,&mad);
+		Add(f,v);
+		if (full)
+		{
+			lim = f->k*1.4826*mad;
+			if (lim<f->noise)
+				lim = f->noise;
+			if (fabs(v-med)>lim)
+			{
+				stats.spike++;
+				return FILTERSPIKE;
+			}
+		}
+	}
+
+	if ((f->rate>0) && (f->lastT>0) && (t>f->lastT) &&
+		(fabs(v-f->last)>f->rate*(t-f->lastT)+f->noise) && (++f->rejects<FILTERRESET))
+	{
+		stats.rate++;
+		return FILTERRATE;
+	}
+	f->rejects = 0;
+	f->last = v;
+	f->lastT = t;
+	stats.passed++;
+	return 0;
+}
+
+//**************************************************************************
+// copy the counters
+void FilterGetStats(FILTERSTATS *out)
+{
+	memcpy(out,&stats,sizeof(FILTERSTATS));
+}
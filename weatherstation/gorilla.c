@@ -0,0 +1,219 @@
+/*---------------------------------------------------------------------------
+   gorilla.c   compressed time series, delta of delta times and xor values
+	2026-10-17   initial edits
+
+	The encoding from Facebook's Gorilla paper, as a bit stream written
+	high bit first.  Times are whole ms.  Each one is stored as the
+	change in the step from the one before, which for readings taken on
+	a schedule is nearly always 0 or a few ms of jitter:
+
+		'0'                   same step as last time
+		'10'   + 7 bits       -63..64
+		'110'  + 9 bits       -255..256
+		'1110' + 12 bits      -2047..2048
+		'1111' + 64 bits      anything else
+
+	The first time is a step from the base given to GorillaInit(), with
+	the step before it taken as 0.  Values are xored with the one before,
+	and a slowly changing reading differs in only a few bits:
+
+		'0'                   same value
+		'10' + the bits       the changed bits fit in the last window
+		'11' + 5 bits leading zeros + 6 bits length-1 + the bits
+
+	The first value is stored whole.  The stream does not say how many
+	samples it holds, the caller keeps that next to it.
+
+	Nothing here calls back into the daemon so the query tool can link
+	it on its own.
+
+---------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "weatherstation.h"
+
+#define MAXSAMPLEBITS	(4+64+2+5+6+64)	// most one sample can take
+
+//**************************************************************************
+// append the low n bits of x
+static void PutBits(GORILLA *g, unsigned long long x, int n)
+{
+	int room, take;
+
+	while (n>0)
+	{
+		room = 8-(g->bits&7);
+		if (room==8)
+			g->buf[g->bits>>3] = 0;
+		take = (n<room) ? n : room;
+		g->buf[g->bits>>3] |= ((x>>(n-take)) & ((1u<<take)-1)) << (room-take);
+		g->bits += take;
+		n -= take;
+	}
+}
+
+//**************************************************************************
+// the next n bits, zeros past the end of the buffer
+static unsigned long long GetBits(GORILLAREAD *r, int n)
+{
+	unsigned long long x = 0;
+	int left, take, b;
+
+	while (n>0)
+	{
+		left = 8-(r->bits&7);
+		take = (n<left) ? n : left;
+		b = ((r->bits>>3)<r->size) ? r->buf[r->bits>>3] : 0;
+		x = (x<<take) | ((b >> (left-take)) & ((1u<<take)-1));
+		r->bits += take;
+		n -= take;
+	}
+	return x;
+}
+
+//**************************************************************************
+// start a stream in buf.  base is the time the first one is stored
+// against, e.g. the start of the batch
+void GorillaInit(GORILLA *g, BYTE *buf, int size, long long base)
+{
+	memset(g,0,sizeof(GORILLA));
+	g->buf = buf;
+	g->size = size;
+	g->t = base;
+	g->lead = -1;
+}
+
+//**************************************************************************
+// add a sample, t in ms
+//  RETURNS: 0 for success, -1 if there may not be room for it
+int GorillaPut(GORILLA *g, long long t, double v)
+{
+	unsigned long long x, bits;
+	long long dod;
+	int lead, trail;
+
+	if (g->bits+MAXSAMPLEBITS>g->size*8)
+		return -1;
+
+	dod = (t-g->t)-g->delta;
+	if (dod==0)
+		PutBits(g,0,1);
+	else if ((dod>=-63) && (dod<=64))
+	{
+		PutBits(g,2,2);
+		PutBits(g,dod,7);
+	}
+	else if ((dod>=-255) && (dod<=256))
+	{
+		PutBits(g,6,3);
+		PutBits(g,dod,9);
+	}
+	else if ((dod>=-2047) && (dod<=2048))
+	{
+		PutBits(g,14,4);
+		PutBits(g,dod,12);
+	}
+	else
+	{
+		PutBits(g,15,4);
+		PutBits(g,dod,64);
+	}
+	g->delta = t-g->t;
+	g->t = t;
+
+	memcpy(&bits,&v,sizeof(bits));
+	if (g->count==0)
+		PutBits(g,bits,64);
+	else if ((x = bits^g->v)==0)
+		PutBits(g,0,1);
+	else
+	{
+		lead = __builtin_clzll(x);
+		trail = __builtin_ctzll(x);
+		if (lead>31)
+			lead = 31;
+		if ((g->lead>=0) && (lead>=g->lead) && (trail>=g->trail))
+		{
+			PutBits(g,2,2);
+			PutBits(g,x>>g->trail,64-g->lead-g->trail);
+		}
+		else
+		{
+			PutBits(g,3,2);
+			PutBits(g,lead,5);
+			PutBits(g,63-lead-trail,6);
+			PutBits(g,x>>trail,64-lead-trail);
+			g->lead = lead;
+			g->trail = trail;
+		}
+	}
+	g->v = bits;
+	g->count++;
+	return 0;
+}
+
+//**************************************************************************
+// bytes the stream takes so far
+int GorillaBytes(GORILLA *g)
+{
+	return (g->bits+7)/8;
+}
+
+//**************************************************************************
+// start reading count samples from a stream made with the same base
+void GorillaReadInit(GORILLAREAD *r, const BYTE *buf, int size, int count, long long base)
+{
+	memset(r,0,sizeof(GORILLAREAD));
+	r->buf = buf;
+	r->size = size;
+	r->count = count;
+	r->t = base;
+}
+
+//**************************************************************************
+// the next sample
+//  RETURNS: 0 for success, 1 at the end or if the stream is cut short
+int GorillaNext(GORILLAREAD *r, long long *t, double *v)
+{
+	unsigned long long x;
+	long long dod;
+	int n, sig;
+
+	if (r->n>=r->count)
+		return 1;
+
+	for (n=0; (n<4) && GetBits(r,1); n++)
+		;
+	switch (n)
+	{
+		case 0:	dod = 0;								break;
+		case 1:	dod = GetBits(r,7);  if (dod>64) dod -= 128;	break;
+		case 2:	dod = GetBits(r,9);  if (dod>256) dod -= 512;	break;
+		case 3:	dod = GetBits(r,12); if (dod>2048) dod -= 4096;	break;
+		default: dod = GetBits(r,64);						break;
+	}
+	r->delta += dod;
+	r->t += r->delta;
+
+	if (r->n==0)
+		r->v = GetBits(r,64);
+	else if (GetBits(r,1))
+	{
+		if (GetBits(r,1))
+		{
+			r->lead = GetBits(r,5);
+			sig = GetBits(r,6)+1;
+			r->trail = 64-r->lead-sig;
+		}
+		sig = 64-r->lead-r->trail;
+		x = GetBits(r,sig);
+		r->v ^= x<<r->trail;
+	}
+	if (r->bits>r->size*8)
+		return 1;
+	*t = r->t;
+	memcpy(v,&r->v,sizeof(*v));
+	r->n++;
+	return 0;
+}
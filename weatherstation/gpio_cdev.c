@@ -0,0 +1,232 @@
+/*---------------------------------------------------------------------------
+   gpio_cdev.c   wind and rain edges from the GPIO character device
+	2026-10-17   initial edits
+
+	wiringPiISR() runs a thread per pin that wakes once per edge and
+	only knows the time the thread got to run.  This takes the wind
+	and rain pins instead through the Linux GPIO uAPI v2 (Linux 5.10
+	on): both lines in one line request, falling edges only, with
+	the debounce done in the kernel.  The kernel stamps each edge with
+	CLOCK_MONOTONIC, the clock MonoNs() reads, when it happens, and
+	queues the edges until they are read.  A read takes up to
+	GPIOBATCH of them at once, so a burst of anemometer pulses costs
+	one wakeup.
+
+	Lines are offsets on the chip, BCM numbers on the Pi:
+
+		gpiochip=       the chip, /dev/gpiochip0.  Blank to use wiringPi
+		gpio_wind=      anemometer line, 18 (wiringPi pin 1)
+		gpio_rain=      rain gauge line, 23 (wiringPi pin 4)
+		gpio_debounce=  microseconds an edge must hold, 0 for none.  The
+		                time stamp is taken when that has passed, so the
+		                edges all come that much late
+
+	With eventloop=1 the request fd is read on the reactor.c thread,
+	otherwise by a thread of its own that polls it and an eventfd
+	GpioStop() signals.  The edge handlers run there.
+	Edges the kernel had to drop show up as gaps in its sequence
+	numbers and are counted in /stats.
+
+	The same code runs on any Linux box with the gpio-sim module.  Make
+	a chip through configfs:
+
+		cd /sys/kernel/config/gpio-sim
+		mkdir ws ws/bank0
+		echo 32 >ws/bank0/num_lines
+		echo 1 >ws/live
+		cat ws/bank0/chip_name
+
+	then set backend=sim and sim_gpiochip=/dev/<chip_name>, and make
+	edges by writing pull-up then pull-down to
+	/sys/devices/platform/<dev_name>/<chip_name>/sim_gpio18/pull.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/gpio.h>
+
+#include "weatherstation.h"
+
+#define GPIOLINES		2				// wind, rain
+#define GPIOBATCH		16				// edges per read
+#define GPIOBUFFER		256				// edges the kernel holds for us
+
+static int			reqFd = -1;			// the line request
+static int			offset[GPIOLINES];
+static void			(*edgeFn[GPIOLINES])(unsigned long long t);
+static unsigned long long lastSeq;
+static pthread_t	gpioTid;
+static int			stopFd = -1;		// wakes the thread to exit
+static GPIOSTATS	stats;
+
+//**************************************************************************
+// request the wind and rain lines on chip
+//  RETURNS: 0 for success, 1 if the chip or lines can not be had
+int GpioOpen(char *chip)
+{
+	struct gpio_v2_line_request req;
+	int fd, us;
+
+	if (chip[0]==0)
+		return 1;
+	offset[0] = ConfigInt("gpio_wind",18,0,1023);
+	offset[1] = ConfigInt("gpio_rain",23,0,1023);
+	us = ConfigInt("gpio_debounce",1000,0,1000000);
+	if (offset[0]==offset[1])
+	{
+		Log("gpio> gpio_wind and gpio_rain are both line %d",offset[0]);
+		return 1;
+	}
+	fd = open(chip,O_RDONLY|O_CLOEXEC);
+	if (fd<0)
+	{
+		Log("gpio> error %d opening %s",errno,chip);
+		return 1;
+	}
+	memset(&req,0,sizeof(req));
+	req.offsets[0] = offset[0];
+	req.offsets[1] = offset[1];
+	req.num_lines = GPIOLINES;
+	strncpy(req.consumer,"weatherstation",sizeof(req.consumer)-1);
+	req.event_buffer_size = GPIOBUFFER;
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT|GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	if (us>0)
+	{
+		req.config.num_attrs = 1;
+		req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+		req.config.attrs[0].attr.debounce_period_us = us;
+		req.config.attrs[0].mask = (1<<GPIOLINES)-1;
+	}
+	if (ioctl(fd,GPIO_V2_GET_LINE_IOCTL,&req)<0)
+	{
+		Log("gpio> %s lines %d,%d: %s",chip,offset[0],offset[1],strerror(errno));
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	reqFd = req.fd;
+	stats.on = 1;
+	Log("gpio> %s wind line %d rain line %d debounce %d us",chip,offset[0],offset[1],us);
+	return 0;
+}
+
+//**************************************************************************
+// one read of up to GPIOBATCH edges, each passed to its handler
+//  RETURNS: edges read, 0 if there were none, -1 on error
+static int GpioRead(void)
+{
+	struct gpio_v2_line_event ev[GPIOBATCH];
+	int n, i, l;
+
+	n = read(reqFd,ev,sizeof(ev));
+	if (n<0)
+		return ((errno==EAGAIN) || (errno==EINTR)) ? 0 : -1;
+	n /= sizeof(ev[0]);
+	__atomic_add_fetch(&stats.reads,1,__ATOMIC_RELAXED);
+	for (i=0; i<n; i++)
+	{
+		__atomic_add_fetch(&stats.events,1,__ATOMIC_RELAXED);
+		if (lastSeq && (ev[i].seqno>lastSeq+1))
+			__atomic_add_fetch(&stats.lost,ev[i].seqno-lastSeq-1,__ATOMIC_RELAXED);
+		lastSeq = ev[i].seqno;
+		for (l=0; l<GPIOLINES; l++)
+			if (ev[i].offset==offset[l])
+				break;
+		if ((l<GPIOLINES) && (edgeFn[l]!=NULL))
+			edgeFn[l](ev[i].timestamp_ns);
+		else
+			__atomic_add_fetch(&stats.dropped,1,__ATOMIC_RELAXED);
+	}
+	return n;
+}
+
+//**************************************************************************
+// eventloop=1, the request fd is readable
+static void GpioEvent(void *arg)
+{
+	if (GpioRead()<0)
+		Log("gpio> read error %d",errno);
+}
+
+//**************************************************************************
+// eventloop=0, read edges as they come until GpioStop() or an error
+static void *GpioThread(void *param)
+{
+	struct pollfd p[2];
+
+	p[0].fd = reqFd;
+	p[1].fd = stopFd;
+	p[0].events = p[1].events = POLLIN;
+	for (;;)
+	{
+		if (poll(p,2,-1)<0)
+		{
+			if (errno==EINTR)
+				continue;
+			break;
+		}
+		if (p[1].revents)
+			return 0;
+		if (p[0].revents && (GpioRead()<0))
+			break;
+	}
+	Log("gpio> read error %d, no more edges",errno);
+	return 0;
+}
+
+//**************************************************************************
+// call fn with the time of each falling edge on pin, WIND_PIN or
+// RAIN_PIN.  The first call starts reading the lines
+//  RETURNS: 0 for success, -1 on error
+int GpioEdge(int pin, void (*fn)(unsigned long long t))
+{
+	int first = (edgeFn[0]==NULL) && (edgeFn[1]==NULL);
+
+	if (reqFd<0)
+		return -1;
+	if (pin==WIND_PIN)
+		edgeFn[0] = fn;
+	else if (pin==RAIN_PIN)
+		edgeFn[1] = fn;
+	else
+		return -1;
+	if (!first)
+		return 0;
+	fcntl(reqFd,F_SETFL,fcntl(reqFd,F_GETFL)|O_NONBLOCK);
+	if (eventLoop)
+		return ReactorWatch(reqFd,GpioEvent,NULL) ? -1 : 0;
+	stopFd = eventfd(0,EFD_CLOEXEC);
+	if ((stopFd<0) || pthread_create(&gpioTid,NULL,GpioThread,NULL))
+		return -1;
+	return 0;
+}
+
+//**************************************************************************
+// stop the reader thread, if there is one, and wait for it
+void GpioStop(void)
+{
+	unsigned long long one = 1;
+
+	if (stopFd<0)
+		return;
+	write(stopFd,&one,sizeof(one));
+	pthread_join(gpioTid,NULL);
+	close(stopFd);
+	stopFd = -1;
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void GpioGetStats(GPIOSTATS *out)
+{
+	memcpy(out,&stats,sizeof(GPIOSTATS));
+}
@@ -0,0 +1,42 @@
+/*---------------------------------------------------------------------------
+   hal.c   pick the hardware backend
+	2026-10-17   initial edits
+
+	All GPIO, I2C and 1-wire access goes through the HAL table pointed
+	to by hal.  "pi" talks to the real hardware through wiringPi,
+	i2c-dev, sysfs and the GPIO character device, "sim" makes up
+	pulses and register values (hal_sim.c) so the whole program runs
+	on any Linux box.  A build with NO_WIRINGPI defined only has the
+	simulator.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "weatherstation.h"
+
+#ifndef NO_WIRINGPI
+extern HAL halPi;
+#endif
+extern HAL halSim;
+
+//**************************************************************************
+// select the backend by name
+//  RETURNS: 0 for success, 1 if name is not known
+int HalSelect(char *name)
+{
+#ifndef NO_WIRINGPI
+	if (!strcmp(name,"pi"))
+	{
+		hal = &halPi;
+		return 0;
+	}
+#endif
+	if (!strcmp(name,"sim"))
+	{
+		hal = &halSim;
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,204 @@
+/*---------------------------------------------------------------------------
+   hal_pi.c   hardware backend for the Raspberry Pi
+	2026-10-17   initial edits, moved here from the thread files
+
+	GPIO through wiringPi, I2C through i2c-dev, 1-wire through the
+	w1-gpio and w1-therm kernel drivers in /sys/bus/w1/devices.
+
+	2026-10-17   I2C straight through i2c-dev with I2C_RDWR, a whole
+	             transaction per ioctl.  One bus fd for every device.
+	2026-10-17   1-wire bulk conversion and probe resolution, both
+	             need w1-therm from Linux 5.10 on
+	2026-10-17   edge handlers are passed the edge time.  wiringPi
+	             does not know it, so it is always 0 here
+	2026-10-17   wind and rain edges from the GPIO character device,
+	             see gpio_cdev.c.  wiringPiISR() only if there is none
+	             or gpiochip= is blank
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include <wiringPi.h>
+#include "weatherstation.h"
+
+static int i2cBus = -1;			// /dev/i2c-N, shared by every device
+static int cdev;				// edges through gpio_cdev.c
+
+// wiringPi handlers take no arguments, so one of these per edge pin
+#define MAXEDGES	4
+static void (*edgeFn[MAXEDGES])(unsigned long long t);
+static void Edge0(void) { edgeFn[0](0); }
+static void Edge1(void) { edgeFn[1](0); }
+static void Edge2(void) { edgeFn[2](0); }
+static void Edge3(void) { edgeFn[3](0); }
+static void (*edgeStub[MAXEDGES])(void) = { Edge0, Edge1, Edge2, Edge3 };
+static int nedges;
+
+//**************************************************************************
+static int PiSetup(void)
+{
+	char chip[64];
+
+	ConfigCopy("gpiochip","/dev/gpiochip0",chip,sizeof(chip));
+	cdev = (GpioOpen(chip)==0);
+	if (!cdev)
+		Log("hal_pi> edges through wiringPi");
+	return wiringPiSetup();
+}
+
+//**************************************************************************
+static int PiEdge(int pin, void (*fn)(unsigned long long t))
+{
+	if (cdev)
+		return GpioEdge(pin, fn);
+	if (nedges>=MAXEDGES)
+		return -1;
+	edgeFn[nedges] = fn;
+	return wiringPiISR(pin, INT_EDGE_FALLING, edgeStub[nedges++]);
+}
+
+//**************************************************************************
+static void PiOutput(int pin)
+{
+	pinMode(pin, OUTPUT);
+}
+
+//**************************************************************************
+static void PiWrite(int pin, int value)
+{
+	digitalWrite(pin, value);
+}
+
+//**************************************************************************
+// open the bus the first time, the handle is the device address
+static int PiI2cOpen(int addr)
+{
+	if (i2cBus<0)
+		i2cBus = open("/dev/i2c-1",O_RDWR);
+	if (i2cBus<0)
+		i2cBus = open("/dev/i2c-0",O_RDWR);		// first Pi boards
+	if (i2cBus<0)
+	{
+		Log("hal_pi> error %d opening the i2c bus",errno);
+		return -1;
+	}
+	return addr;
+}
+
+//**************************************************************************
+// the whole transaction in one ioctl, repeated starts between parts
+static int PiI2cXfer(int fd, I2CMSG *msg, int n)
+{
+	struct i2c_msg m[I2CMAXMSG];
+	struct i2c_rdwr_ioctl_data x;
+	int i;
+
+	if ((n<1) || (n>I2CMAXMSG))
+		return -1;
+	for (i=0; i<n; i++)
+	{
+		m[i].addr = fd;
+		m[i].flags = (msg[i].flags&I2CREAD) ? I2C_M_RD : 0;
+		m[i].len = msg[i].len;
+		m[i].buf = msg[i].buf;
+	}
+	x.msgs = m;
+	x.nmsgs = n;
+	return (ioctl(i2cBus,I2C_RDWR,&x)==n) ? 0 : -1;
+}
+
+//**************************************************************************
+// read the w1_slave file for a device
+//  RETURNS: bytes read, -1 if the device can not be opened
+static int PiW1Read(char *id, char *buf, int sz)
+{
+	char fname[80];
+	int fd, n, tot=0;
+
+	sprintf(fname,"/sys/bus/w1/devices/%s/w1_slave",id);
+	fd = open(fname,O_RDONLY);
+	if (fd<0)
+	{
+		Log("hal_pi> Error %d opening %s",errno,fname);
+		return -1;
+	}
+	while ((tot<sz-1) && ((n = read(fd,buf+tot,sz-1-tot))>0))
+		tot += n;
+	close(fd);
+	buf[tot] = 0;
+	return tot;
+}
+
+//**************************************************************************
+// write a short string to a sysfs file
+//  RETURNS: 0 for success, -1 on error
+static int PutSys(char *fname, char *text)
+{
+	int fd, n;
+
+	fd = open(fname,O_WRONLY);
+	if (fd<0)
+		return -1;
+	n = write(fd,text,strlen(text));
+	close(fd);
+	return (n==strlen(text)) ? 0 : -1;
+}
+
+//**************************************************************************
+// start a conversion on every probe of every bus master at once
+//  RETURNS: 0 for success, -1 if no master could do it
+static int PiW1Bulk(void)
+{
+	glob_t g;
+	int i, ok = 0;
+
+	if (glob("/sys/bus/w1/devices/w1_bus_master*/therm_bulk_read",0,NULL,&g))
+		return -1;
+	for (i=0; i<g.gl_pathc; i++)
+		if (PutSys(g.gl_pathv[i],"trigger\n")==0)
+			ok = 1;
+	globfree(&g);
+	return ok ? 0 : -1;
+}
+
+//**************************************************************************
+// set a probe's resolution, 9 to 12 bits
+//  RETURNS: 0 for success, -1 on error
+static int PiW1Resolution(char *id, int bits)
+{
+	char fname[80], text[8];
+
+	snprintf(fname,sizeof(fname),"/sys/bus/w1/devices/%s/resolution",id);
+	snprintf(text,sizeof(text),"%d\n",bits);
+	return PutSys(fname,text);
+}
+
+//**************************************************************************
+static void PiDelay(int ms)
+{
+	delay(ms);
+}
+
+HAL halPi = {
+	"pi",
+	PiSetup,
+	PiEdge,
+	PiOutput,
+	PiWrite,
+	PiI2cOpen,
+	PiI2cXfer,
+	PiW1Read,
+	PiW1Bulk,
+	PiW1Resolution,
+	PiDelay
+};
@@ -0,0 +1,360 @@
+/*---------------------------------------------------------------------------
+   hal_sim.c   simulated hardware backend
+	2026-10-17   initial edits
+
+	Lets the whole program run, be tested and be profiled on a box
+	with no sensors.  A thread ticks every millisecond and fires the
+	edge handlers for the wind and rain pins, either from the rates
+	in the config file (sim_wind_hz, sim_rain_hz) or from a recorded
+	file (sim_replay) played back sim_speed times faster than real.
+	Rates far above real weather are fine, all the pulses that are due
+	in a tick are fired together.
+
+	Replay file lines are "<seconds> W" or "<seconds> R", seconds
+	counted from the start of the file.  The handlers are passed the
+	time each edge was due, so histEdge shows how late this thread
+	was, the tick included.
+
+	The AM2315, MPL115A2 and 1-wire probes answer with values that
+	drift slowly on a sim_period second cycle.  1-wire reads take as
+	long as the real ones, a conversion unless a bulk conversion is
+	under way or done, then the scratchpad read.  sim_glitch is the
+	fraction of AM2315 and probe readings that come back wild, to
+	exercise the filters.
+
+	sim_gpiochip= takes the wind and rain edges from that GPIO chip
+	instead, normally one made with the gpio-sim module, through the
+	same code as the pi backend (gpio_cdev.c).  Nothing is made up
+	for them then.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "weatherstation.h"
+
+#define MAXPINS 64
+
+static void			(*edgeFn[MAXPINS])(unsigned long long t);
+static double		windHz, rainHz, speed, period, glitch;
+static FILE			*replay;
+static pthread_t	simTid;
+static BYTE			amReply[8];			// next AM2315 read
+static int			mplReg;				// MPL115A2 register pointer
+static unsigned long long simStart;
+static unsigned long long w1Bulk;		// MonoNs() of the last bulk conversion
+static unsigned long long w1Read;		// probes read since, a bit per id hash
+static int			w1Bits = 12;		// resolution, one for all probes
+static double		setWind=-1, setRain=-1;	// SimRates() overrides
+static int			gpio;				// edges from sim_gpiochip
+
+//**************************************************************************
+// pulse rates to use instead of the config file, call before setup
+void SimRates(double wind, double rain)
+{
+	setWind = wind;
+	setRain = rain;
+}
+
+//**************************************************************************
+// slowly varying value, 0..1 on a period second cycle
+static double SimCycle(double phase)
+{
+	double t = (MonoNs()-simStart)/1e9;
+	return 0.5 + 0.5*sin(2*M_PI*t/period + phase);
+}
+
+//**************************************************************************
+// an edge on pin at MonoNs() time t
+static void SimFire(int pin, unsigned long long t)
+{
+	if ((pin>=0) && (pin<MAXPINS) && (edgeFn[pin]!=NULL))
+		edgeFn[pin](t);
+}
+
+//**************************************************************************
+// pulse generator / replay thread
+static void *SimThread(void *param)
+{
+	struct timespec ts;
+	double windAcc=0, rainAcc=0, t, rate, nextAt=-1;
+	char line[80], kind='W';
+	unsigned long long last, now;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	last = MonoNs();
+	for (;;)
+	{
+		// tick every millisecond
+		ts.tv_nsec += 1000000;
+		if (ts.tv_nsec>=1000000000)
+		{
+			ts.tv_nsec -= 1000000000;
+			ts.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL);
+		now = MonoNs();
+		t = (now-simStart)/1e9;
+
+		if (replay!=NULL)
+		{
+			// fire everything in the file that is due
+			for (;;)
+			{
+				if (nextAt<0)
+				{
+					if (fgets(line,sizeof(line),replay)==NULL)
+					{
+						Log("hal_sim> end of replay file");
+						fclose(replay);
+						replay = NULL;
+						break;
+					}
+					if (sscanf(line,"%lf %c",&nextAt,&kind)!=2)
+					{
+						nextAt = -1;
+						continue;
+					}
+				}
+				if (nextAt>t*speed)
+					break;
+				SimFire((kind=='R') ? RAIN_PIN : WIND_PIN,simStart+nextAt/speed*1e9);
+				nextAt = -1;
+			}
+		}
+		else
+		{
+			// wind gusts +/-50% on a 20 second cycle
+			// each edge is timed where its count came due in the tick
+			rate = windHz * (1.0 + 0.5*sin(2*M_PI*t/20.0));
+			windAcc += rate*(now-last)/1e9;
+			while (windAcc>=1.0)
+			{
+				windAcc -= 1.0;
+				SimFire(WIND_PIN,now-(unsigned long long)(windAcc/rate*1e9));
+			}
+			rainAcc += rainHz*(now-last)/1e9;
+			while (rainAcc>=1.0)
+			{
+				rainAcc -= 1.0;
+				SimFire(RAIN_PIN,now-(unsigned long long)(rainAcc/rainHz*1e9));
+			}
+		}
+		last = now;
+	}
+	return 0;
+}
+
+//**************************************************************************
+static int SimSetup(void)
+{
+	char temp[100];
+
+	windHz = ConfigDouble("sim_wind_hz",5,0,1000);
+	rainHz = ConfigDouble("sim_rain_hz",0.05,0,1000);
+	if (setWind>=0) windHz = setWind;
+	if (setRain>=0) rainHz = setRain;
+	speed = ConfigDouble("sim_speed",1,0.001,1e6);
+	period = ConfigDouble("sim_period",600,1,1e9);
+	glitch = ConfigDouble("sim_glitch",0,0,1);
+	srand48(MonoNs());
+	ConfigCopy("sim_gpiochip","",temp,sizeof(temp));
+	if (temp[0])
+	{
+		if (GpioOpen(temp))
+			return -1;
+		gpio = 1;
+		simStart = MonoNs();
+		return 0;
+	}
+	ConfigCopy("sim_replay","",temp,sizeof(temp));
+	if (temp[0])
+	{
+		replay = fopen(temp,"r");
+		if (replay==NULL)
+			Log("hal_sim> error %d opening %s",errno,temp);
+	}
+	simStart = MonoNs();
+	Log("hal_sim> wind %.2f Hz  rain %.2f Hz  replay '%s' x%.1f",windHz,rainHz,temp,speed);
+	return pthread_create(&simTid,NULL,SimThread,NULL) ? -1 : 0;
+}
+
+//**************************************************************************
+static int SimEdge(int pin, void (*fn)(unsigned long long t))
+{
+	if (gpio)
+		return GpioEdge(pin, fn);
+	if ((pin<0)||(pin>=MAXPINS))
+		return -1;
+	edgeFn[pin] = fn;
+	return 0;
+}
+
+//**************************************************************************
+static void SimOutput(int pin)
+{
+}
+
+//**************************************************************************
+static void SimWrite(int pin, int value)
+{
+}
+
+//**************************************************************************
+// the handle is just the bus address
+static int SimI2cOpen(int addr)
+{
+	return addr;
+}
+
+//**************************************************************************
+// AM2315 read request, make up the reply
+static void SimAm2315(void)
+{
+	int hum, cel;
+	unsigned short crc;
+
+	hum = 300 + 500*SimCycle(1.0);			// 30-80 %, x10
+	cel = -50 + 300*SimCycle(0.0);			// -5-25 C, x10
+	if (drand48()<glitch)
+		cel += 400;
+	amReply[0] = 3;
+	amReply[1] = 4;
+	amReply[2] = hum>>8;
+	amReply[3] = hum&0xFF;
+	if (cel<0)
+	{
+		cel = -cel;
+		amReply[4] = 0x80 | (cel>>8);
+	}
+	else
+		amReply[4] = cel>>8;
+	amReply[5] = cel&0xFF;
+	crc = Crc16(amReply,6);
+	amReply[6] = crc&0xFF;
+	amReply[7] = crc>>8;
+}
+
+//**************************************************************************
+// MPL115A2 register, coefficients are the data sheet example
+static BYTE SimMpl115a2(int reg)
+{
+	static const BYTE coef[8] = { 0x3E,0xCE,0xB3,0xF9,0xC5,0x17,0x33,0xC8 };
+	int padc, tadc;
+
+	padc = (360 + 30*SimCycle(2.0)) * 64;		// raw 10 bit << 6
+	tadc = (490 + 30*SimCycle(0.0)) * 64;
+	switch (reg)
+	{
+		case 0:	return padc>>8;
+		case 1:	return padc&0xFF;
+		case 2:	return tadc>>8;
+		case 3:	return tadc&0xFF;
+	}
+	if ((reg>=4)&&(reg<12))
+		return coef[reg-4];
+	return 0;
+}
+
+//**************************************************************************
+// one transaction to either device.  A write to the MPL115A2 sets its
+// register pointer, reads carry on from there
+static int SimI2cXfer(int fd, I2CMSG *msg, int n)
+{
+	int i, k;
+
+	for (i=0; i<n; i++)
+	{
+		if (fd==0x5c)
+		{
+			if (!(msg[i].flags&I2CREAD) && (msg[i].len==3) && (msg[i].buf[0]==3))
+				SimAm2315();
+			else if (msg[i].flags&I2CREAD)
+				memcpy(msg[i].buf,amReply,(msg[i].len>8) ? 8 : msg[i].len);
+		}
+		else if (fd==0x60)
+		{
+			if (!(msg[i].flags&I2CREAD) && (msg[i].len>0))
+				mplReg = msg[i].buf[0];
+			else if (msg[i].flags&I2CREAD)
+				for (k=0; k<msg[i].len; k++)
+					msg[i].buf[k] = SimMpl115a2(mplReg++);
+		}
+		else
+			return -1;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// w1_slave contents, each id gets its own offset
+static int SimW1Read(char *id, char *buf, int sz)
+{
+	int mc, h = 0;
+	char *p;
+	unsigned long long conv, now, bit;
+
+	for (p=id; *p; p++)
+		h += *p;
+	// wait for the bulk conversion, or do one of its own
+	conv = 750000000ULL >> (12-w1Bits);
+	bit = 1ULL << (h%64);
+	now = MonoNs();
+	if ((w1Bulk!=0) && !(w1Read&bit))
+	{
+		if (now<w1Bulk+conv)
+			usleep((w1Bulk+conv-now)/1000);
+	}
+	else
+		usleep(conv/1000);
+	w1Read |= bit;
+	usleep(13000);							// 9 bytes of scratchpad
+	mc = 5000 + 15000*SimCycle(0.5) + (h%20)*100;
+	if (drand48()<glitch)
+		mc = (drand48()<0.5) ? 85000 : mc-30000;
+	return snprintf(buf,sz,
+		"72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=%d\n",mc);
+}
+
+//**************************************************************************
+// every probe starts converting
+static int SimW1Bulk(void)
+{
+	w1Bulk = MonoNs();
+	w1Read = 0;
+	return 0;
+}
+
+//**************************************************************************
+static int SimW1Resolution(char *id, int bits)
+{
+	w1Bits = bits;
+	return 0;
+}
+
+//**************************************************************************
+static void SimDelay(int ms)
+{
+	Sleep(ms);
+}
+
+HAL halSim = {
+	"sim",
+	SimSetup,
+	SimEdge,
+	SimOutput,
+	SimWrite,
+	SimI2cOpen,
+	SimI2cXfer,
+	SimW1Read,
+	SimW1Bulk,
+	SimW1Resolution,
+	SimDelay
+};
@@ -0,0 +1,98 @@
+/*---------------------------------------------------------------------------
+   histogram.c   log-linear latency histogram
+	2026-10-17   initial edits
+
+	Values (normally nanoseconds) are counted in buckets that double
+	in width every 16 buckets, so any value from 1 ns to hours is
+	kept to within about 6%, HDR histogram style, in fixed memory.
+	HistAdd() is lock-free and safe from any number of threads.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "weatherstation.h"
+
+#define SUBBITS	4
+#define SUB		(1<<SUBBITS)
+
+//**************************************************************************
+// bucket index for a value
+static int HistBucket(unsigned long long v)
+{
+	int msb;
+
+	if (v<SUB)
+		return (int)v;
+	msb = 63-__builtin_clzll(v);
+	return (msb-SUBBITS+1)*SUB + (int)((v>>(msb-SUBBITS))&(SUB-1));
+}
+
+//**************************************************************************
+// middle of the range a bucket covers
+static unsigned long long HistValue(int b)
+{
+	int msb;
+	unsigned long long lo;
+
+	if (b<SUB)
+		return b;
+	msb = b/SUB + SUBBITS - 1;
+	lo = (1ULL<<msb) | ((unsigned long long)(b%SUB) << (msb-SUBBITS));
+	return lo + (1ULL<<(msb-SUBBITS))/2;
+}
+
+//**************************************************************************
+// count one value
+void HistAdd(HISTOGRAM *h, unsigned long long v)
+{
+	unsigned long long m;
+
+	__atomic_add_fetch(&h->count[HistBucket(v)],1,__ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->total,1,__ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->sum,v,__ATOMIC_RELAXED);
+	m = __atomic_load_n(&h->max,__ATOMIC_RELAXED);
+	while ((v>m) && !__atomic_compare_exchange_n(&h->max,&m,v,1,
+						__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+		;
+}
+
+//**************************************************************************
+// value below which fraction q (0..1) of the counts fall
+unsigned long long HistPercentile(HISTOGRAM *h, double q)
+{
+	unsigned long long want, n = 0;
+	int b;
+
+	if (h->total==0)
+		return 0;
+	want = (unsigned long long)(q*h->total + 0.5);
+	if (want<1) want = 1;
+	for (b=0; b<HISTBUCKETS; b++)
+	{
+		n += h->count[b];
+		if (n>=want)
+			return (HistValue(b)<h->max) ? HistValue(b) : h->max;
+	}
+	return h->max;
+}
+
+//**************************************************************************
+// clear all counts
+void HistReset(HISTOGRAM *h)
+{
+	memset(h,0,sizeof(HISTOGRAM));
+}
+
+//**************************************************************************
+// summary as a JSON object, values in the units that were added
+//  RETURNS: length written
+int HistJson(HISTOGRAM *h, char *buf, int sz)
+{
+	return snprintf(buf,sz,
+		"{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+		h->total, h->total ? h->sum/h->total : 0,
+		HistPercentile(h,0.50), HistPercentile(h,0.99),
+		HistPercentile(h,0.999), h->max);
+}
@@ -0,0 +1,570 @@
+/*---------------------------------------------------------------------------
+   httpthread.c   small HTTP server for current conditions and counters
+	2026-10-17   initial edits
+
+	One thread, one epoll set, non-blocking sockets.  Connection slots
+	and their buffers are allocated once when the thread starts, each
+	response is printed straight into its slot so a request costs no
+	allocation.  Keep-alive is supported so a scraper can reuse its
+	connection.  Everything shown is read without locks: the readings
+	come from the snapshot (snapshot.c), the counters are plain reads.
+
+	  GET /now       current readings, JSON
+	  GET /stats     queue, database, spool, archive, pulse and sensor
+	                 counters, filter rejects, real-time settings, plus
+	                 latency percentiles, JSON
+	  GET /metrics   all of the above in Prometheus text format
+
+	httpport=0 turns it off.  It listens on httpaddr, 127.0.0.1 unless
+	the config says otherwise.
+
+---------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE			// strcasestr
+#include <errno.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "weatherstation.h"
+
+#define HTTPCONNS		32			// connections at once
+#define HTTPINSZ		2048		// longest request header
+#define HTTPOUTSZ		16384		// longest response body
+#define HTTPIDLE		30			// seconds before an idle connection is closed
+
+// one connection slot
+typedef struct {
+	int		fd;						// -1 when free
+	char	in[HTTPINSZ];			// request read so far
+	int		nin;
+	char	hdr[256];				// response header
+	int		nhdr;
+	char	body[HTTPOUTSZ];		// response body
+	int		nbody;
+	int		sent;					// of nhdr+nbody
+	int		keep;					// keep-alive after this response
+	time_t	last;					// last activity
+} HTTPCONN;
+
+static HTTPCONN			*conns;
+static int				epfd = -1;
+static unsigned long	requests;
+
+//**************************************************************************
+// add text to the response body, anything past the end is cut off
+static void Put(HTTPCONN *c, char *format, ...)
+{
+	va_list arglist;
+	int n;
+
+	va_start(arglist,format);
+	n = vsnprintf(c->body+c->nbody,HTTPOUTSZ-c->nbody,format,arglist);
+	va_end(arglist);
+	if (n>0)
+		c->nbody += (n<HTTPOUTSZ-c->nbody) ? n : HTTPOUTSZ-1-c->nbody;
+}
+
+//**************************************************************************
+// latency histogram as a Prometheus summary in seconds
+static void PutSummary(HTTPCONN *c, char *name, char *help, HISTOGRAM *h)
+{
+	Put(c,"# HELP %s %s\n# TYPE %s summary\n",name,help,name);
+	Put(c,"%s{quantile=\"0.5\"} %.9f\n",name,HistPercentile(h,0.50)/1e9);
+	Put(c,"%s{quantile=\"0.99\"} %.9f\n",name,HistPercentile(h,0.99)/1e9);
+	Put(c,"%s{quantile=\"0.999\"} %.9f\n",name,HistPercentile(h,0.999)/1e9);
+	Put(c,"%s_sum %.9f\n%s_count %llu\n",name,h->sum/1e9,name,h->total);
+}
+
+//**************************************************************************
+// one Prometheus counter or gauge, readings are rounded to what the
+// sensors can tell
+static void PutMetric(HTTPCONN *c, char *name, char *type, char *help, double v)
+{
+	Put(c,"# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+	Put(c,strncmp(name,"weather_",8) ? "%s %.15g\n" : "%s %.3f\n",name,v);
+}
+
+//**************************************************************************
+// GET /now
+static void PageNow(HTTPCONN *c)
+{
+	SNAPSHOT s;
+
+	SnapRead(SnapLocal(),&s);
+	Put(c,"{\"updated\":%.3f,\"outsideTemp\":%.1f,\"humidity\":%.1f,"
+		  "\"boardTemp\":%.1f,\"barometric\":%.2f,\"tempA\":%.1f,",
+		  s.updated,s.outsideTemp,s.humidity,s.boardTemp,s.barometric,s.tempA);
+	Put(c,"\"windSpeed\":%.1f,\"windGust\":%.1f,\"windNow\":%.1f,"
+		  "\"rainPeriod\":%.3f,\"rainToday\":%.2f,\"rainRate\":%.2f,"
+		  "\"rainRate5\":%.2f,\"rainRate15\":%.2f}\n",
+		  s.windSpeed,s.windGust,s.windNow,s.rainPeriod,s.rainToday,
+		  s.rainRate,s.rainRate5,s.rainRate15);
+}
+
+//**************************************************************************
+// GET /stats
+static void PageStats(HTTPCONN *c)
+{
+	DBSTATS db;
+	SPOOLSTATS sp;
+	ARCHSTATS ar;
+	I2CSTATS i2;
+	FILTERSTATS fs;
+	REACTORSTATS rs;
+	RTSTATS rt;
+	GPIOSTATS gp;
+	SENSOR *sens[MAXSENSORS];
+	SINK *sinks[MAXSINKS];
+	char buf[200];
+	int i, n;
+
+	DbGetStats(&db);
+	FilterGetStats(&fs);
+	SpoolGetStats(&sp);
+	ArchiveGetStats(&ar);
+	I2cGetStats(&i2);
+	ReactorGetStats(&rs);
+	RtGetStats(&rt);
+	GpioGetStats(&gp);
+	Put(c,"{\"samples\":{\"queued\":%lu,\"dropped\":%lu,\"depth\":%d,\"metrics\":%d},\n",
+		  db.queued,db.dropped,db.depth,MetricCount());
+	Put(c," \"db\":{\"rows\":%lu,\"inserts\":%lu,\"errors\":%lu,\"rollups\":%lu,"
+		  "\"rollups_dropped\":%lu,\"connected\":%s},\n",
+		  db.rows,db.flushes,db.errors,db.rollups,db.rollupsDropped,
+		  (conn!=NULL)?"true":"false");
+	Put(c," \"spool\":{\"written\":%lu,\"replayed\":%lu,\"dropped\":%lu,\"corrupt\":%lu,"
+		  "\"pending\":%d},\n",
+		  sp.written,sp.replayed,sp.dropped,sp.corrupt,sp.pending);
+	Put(c," \"archive\":{\"written\":%lu,\"older\":%lu,\"errors\":%lu,\"columns\":%d,"
+		  "\"blocks\":%lu,\"bytes_per_sample\":%.2f},\n",
+		  ar.written,ar.older,ar.errors,ar.columns,ar.blocks,
+		  ar.blocks ? (double)ar.zbytes/(ar.blocks*(double)ARCHBLOCK) : 0.0);
+	Put(c," \"pulses\":{\"wind\":%lu,\"wind_overruns\":%lu,\"rain\":%lu,\"rain_overruns\":%lu},\n",
+		  windPulses.total,windPulses.overruns,rainPulses.total,rainPulses.overruns);
+	Put(c," \"gpio\":{\"chardev\":%s,\"edges\":%lu,\"reads\":%lu,\"lost\":%lu,\"dropped\":%lu},\n",
+		  gp.on ? "true" : "false",gp.events,gp.reads,gp.lost,gp.dropped);
+	Put(c," \"i2c\":{\"transactions\":%lu,\"errors\":%lu,\"bytes\":%lu},\n",
+		  i2.xfers,i2.errors,i2.bytes);
+	Put(c," \"event_loop\":{\"on\":%s,\"wakeups\":%lu,\"timers\":%lu,\"events\":%lu},\n",
+		  eventLoop ? "true" : "false",rs.wakeups,rs.timers,rs.events);
+	Put(c," \"realtime\":{\"isr_prio\":%d,\"sample_prio\":%d,\"locked\":%s,"
+		  "\"threads\":%lu,\"failed\":%lu},\n",
+		  rt.isrPrio,rt.samplePrio,rt.locked ? "true" : "false",rt.threads,rt.failed);
+	n = SensorList(sens,MAXSENSORS);
+	Put(c," \"sensors\":[");
+	for (i=0; i<n; i++)
+		Put(c,"%s{\"name\":\"%s\",\"driver\":\"%s\",\"reads\":%lu,\"errors\":%lu,"
+			  "\"rejected\":%lu}",i ? "," : "",sens[i]->name,sens[i]->drv->name,
+			  sens[i]->reads,sens[i]->errors,sens[i]->rejected);
+	Put(c,"],\n");
+	n = SinkList(sinks,MAXSINKS);
+	Put(c," \"sinks\":[");
+	for (i=0; i<n; i++)
+		Put(c,"%s{\"name\":\"%s\",\"type\":\"%s\",\"queued\":%lu,\"dropped\":%lu,"
+			  "\"written\":%lu,\"batches\":%lu,\"errors\":%lu,\"depth\":%d}",
+			  i ? "," : "",sinks[i]->name,sinks[i]->type->name,sinks[i]->stats.queued,
+			  sinks[i]->stats.dropped,sinks[i]->stats.written,sinks[i]->stats.batches,
+			  sinks[i]->stats.errors,RingCount(&sinks[i]->q));
+	Put(c,"],\n");
+	Put(c," \"filter\":{\"passed\":%lu,\"range\":%lu,\"spike\":%lu,\"rate\":%lu},\n",
+		  fs.passed,fs.range,fs.spike,fs.rate);
+	Put(c," \"log_dropped\":%lu,\"http_requests\":%lu,\n",LogDropped(),requests);
+	HistJson(&histEdge,buf,sizeof(buf));
+	Put(c," \"latency_ns\":{\"edge_to_handler\":%s,\n",buf);
+	HistJson(&histPulse,buf,sizeof(buf));
+	Put(c,"  \"pulse_to_thread\":%s,\n",buf);
+	HistJson(&histPersist,buf,sizeof(buf));
+	Put(c,"  \"queue_to_stored\":%s,\n",buf);
+	HistJson(&histFlush,buf,sizeof(buf));
+	Put(c,"  \"insert\":%s,\n",buf);
+	HistJson(&histI2c,buf,sizeof(buf));
+	Put(c,"  \"i2c_transaction\":%s,\n",buf);
+	HistJson(&histSensor,buf,sizeof(buf));
+	Put(c,"  \"sensor_late\":%s}}\n",buf);
+}
+
+//**************************************************************************
+// GET /metrics
+static void PageMetrics(HTTPCONN *c)
+{
+	SNAPSHOT s;
+	DBSTATS db;
+	SPOOLSTATS sp;
+	ARCHSTATS ar;
+	I2CSTATS i2;
+	REACTORSTATS rs;
+	GPIOSTATS gp;
+	SENSOR *sens[MAXSENSORS];
+	SINK *sinks[MAXSINKS];
+	int i, n;
+
+	SnapRead(SnapLocal(),&s);
+	DbGetStats(&db);
+	SpoolGetStats(&sp);
+	ArchiveGetStats(&ar);
+	I2cGetStats(&i2);
+	ReactorGetStats(&rs);
+	GpioGetStats(&gp);
+
+	PutMetric(c,"weather_outside_temperature_fahrenheit","gauge","Outside temperature",s.outsideTemp);
+	PutMetric(c,"weather_humidity_percent","gauge","Relative humidity",s.humidity);
+	PutMetric(c,"weather_board_temperature_fahrenheit","gauge","Interface board temperature",s.boardTemp);
+	PutMetric(c,"weather_pressure_inhg","gauge","Barometric pressure",s.barometric);
+	PutMetric(c,"weather_probe_temperature_fahrenheit","gauge","1-wire probe temperature",s.tempA);
+	PutMetric(c,"weather_wind_speed_mph","gauge","Average wind speed over the last report",s.windSpeed);
+	PutMetric(c,"weather_wind_gust_mph","gauge","Highest 3 second gust over the last report",s.windGust);
+	PutMetric(c,"weather_wind_now_mph","gauge","Wind speed from the latest pulses",s.windNow);
+	PutMetric(c,"weather_rain_today_inches","gauge","Rain since midnight",s.rainToday);
+	PutMetric(c,"weather_rain_rate_inches_per_hour","gauge","Rain rate over 1 minute",s.rainRate);
+	PutMetric(c,"weather_snapshot_updated_seconds","gauge","Unix time of the last reading",s.updated);
+
+	PutMetric(c,"weatherstation_samples_queued_total","counter","Samples accepted by the queue",db.queued);
+	PutMetric(c,"weatherstation_samples_dropped_total","counter","Samples lost, queue full",db.dropped);
+	PutMetric(c,"weatherstation_queue_depth","gauge","Samples waiting for the fan out",db.depth);
+	PutMetric(c,"weatherstation_db_rows_total","counter","Rows inserted",db.rows);
+	PutMetric(c,"weatherstation_db_inserts_total","counter","Insert statements",db.flushes);
+	PutMetric(c,"weatherstation_db_errors_total","counter","Failed inserts",db.errors);
+	PutMetric(c,"weatherstation_db_connected","gauge","1 while connected to MySQL",conn!=NULL);
+	PutMetric(c,"weatherstation_rollups_total","counter","Rollup rows inserted",db.rollups);
+	PutMetric(c,"weatherstation_rollups_dropped_total","counter","Rollups lost",db.rollupsDropped);
+	PutMetric(c,"weatherstation_spool_pending","gauge","Samples waiting in the spool",sp.pending);
+	PutMetric(c,"weatherstation_spool_written_total","counter","Samples spooled",sp.written);
+	PutMetric(c,"weatherstation_spool_dropped_total","counter","Spooled samples lost to the size limit",sp.dropped);
+	PutMetric(c,"weatherstation_archive_written_total","counter","Samples archived",ar.written);
+	PutMetric(c,"weatherstation_archive_blocks_total","counter","Archive blocks compressed",ar.blocks);
+	PutMetric(c,"weatherstation_archive_block_bytes_total","counter","Bytes the compressed blocks took",ar.zbytes);
+	PutMetric(c,"weatherstation_wind_pulses_total","counter","Anemometer pulses",windPulses.total);
+	PutMetric(c,"weatherstation_wind_overruns_total","counter","Anemometer pulses lost",windPulses.overruns);
+	PutMetric(c,"weatherstation_rain_pulses_total","counter","Rain gauge tips",rainPulses.total);
+	PutMetric(c,"weatherstation_rain_overruns_total","counter","Rain gauge tips lost",rainPulses.overruns);
+	PutMetric(c,"weatherstation_gpio_edges_total","counter","Edges read from the GPIO character device",gp.events);
+	PutMetric(c,"weatherstation_gpio_reads_total","counter","Reads of the GPIO character device",gp.reads);
+	PutMetric(c,"weatherstation_gpio_lost_total","counter","Edges the kernel dropped",gp.lost);
+	PutMetric(c,"weatherstation_i2c_transactions_total","counter","I2C transactions",i2.xfers);
+	PutMetric(c,"weatherstation_i2c_errors_total","counter","I2C transactions that failed",i2.errors);
+	PutMetric(c,"weatherstation_i2c_bytes_total","counter","I2C data bytes moved",i2.bytes);
+	PutMetric(c,"weatherstation_event_loop_wakeups_total","counter","Times the event loop woke up",rs.wakeups);
+	PutMetric(c,"weatherstation_event_loop_timers_total","counter","Timers the event loop ran",rs.timers);
+	n = SensorList(sens,MAXSENSORS);
+	Put(c,"# HELP weatherstation_sensor_reads_total Good sensor readings\n"
+		  "# TYPE weatherstation_sensor_reads_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sensor_reads_total{sensor=\"%s\"} %lu\n",sens[i]->name,sens[i]->reads);
+	Put(c,"# HELP weatherstation_sensor_errors_total Failed sensor readings\n"
+		  "# TYPE weatherstation_sensor_errors_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sensor_errors_total{sensor=\"%s\"} %lu\n",sens[i]->name,sens[i]->errors);
+	Put(c,"# HELP weatherstation_sensor_rejected_total Sensor values dropped by the filter\n"
+		  "# TYPE weatherstation_sensor_rejected_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sensor_rejected_total{sensor=\"%s\"} %lu\n",sens[i]->name,sens[i]->rejected);
+	n = SinkList(sinks,MAXSINKS);
+	Put(c,"# HELP weatherstation_sink_written_total Samples a sink has written\n"
+		  "# TYPE weatherstation_sink_written_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sink_written_total{sink=\"%s\"} %lu\n",sinks[i]->name,sinks[i]->stats.written);
+	Put(c,"# HELP weatherstation_sink_dropped_total Samples lost, sink queue full\n"
+		  "# TYPE weatherstation_sink_dropped_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sink_dropped_total{sink=\"%s\"} %lu\n",sinks[i]->name,sinks[i]->stats.dropped);
+	Put(c,"# HELP weatherstation_sink_errors_total Failed sink writes\n"
+		  "# TYPE weatherstation_sink_errors_total counter\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sink_errors_total{sink=\"%s\"} %lu\n",sinks[i]->name,sinks[i]->stats.errors);
+	Put(c,"# HELP weatherstation_sink_queue_depth Samples waiting for a sink\n"
+		  "# TYPE weatherstation_sink_queue_depth gauge\n");
+	for (i=0; i<n; i++)
+		Put(c,"weatherstation_sink_queue_depth{sink=\"%s\"} %d\n",sinks[i]->name,RingCount(&sinks[i]->q));
+	PutMetric(c,"weatherstation_log_dropped_total","counter","Log lines lost",LogDropped());
+	PutMetric(c,"weatherstation_http_requests_total","counter","HTTP requests served",requests);
+	PutSummary(c,"weatherstation_edge_latency_seconds","GPIO edge to its handler",&histEdge);
+	PutSummary(c,"weatherstation_pulse_latency_seconds","Interrupt to sensor thread",&histPulse);
+	PutSummary(c,"weatherstation_queue_to_stored_seconds","StoreSample() to row stored",&histPersist);
+	PutSummary(c,"weatherstation_insert_seconds","One insert",&histFlush);
+	PutSummary(c,"weatherstation_i2c_transaction_seconds","One I2C transaction",&histI2c);
+	PutSummary(c,"weatherstation_sensor_late_seconds","Sensor step due to started",&histSensor);
+}
+
+//**************************************************************************
+// close a connection and free its slot
+static void CloseConn(HTTPCONN *c)
+{
+	epoll_ctl(epfd,EPOLL_CTL_DEL,c->fd,NULL);
+	close(c->fd);
+	c->fd = -1;
+}
+
+//**************************************************************************
+// send what is left of the response
+//  RETURNS: 0 to keep the connection, 1 if it was closed
+static int Send(HTTPCONN *c)
+{
+	struct iovec iov[2];
+	struct epoll_event ev;
+	int n;
+
+	while (c->sent<c->nhdr+c->nbody)
+	{
+		if (c->sent<c->nhdr)
+		{
+			iov[0].iov_base = c->hdr+c->sent;
+			iov[0].iov_len = c->nhdr-c->sent;
+			iov[1].iov_base = c->body;
+			iov[1].iov_len = c->nbody;
+			n = writev(c->fd,iov,2);
+		}
+		else
+			n = write(c->fd,c->body+(c->sent-c->nhdr),c->nbody-(c->sent-c->nhdr));
+		if (n<0)
+		{
+			if ((errno==EAGAIN)||(errno==EWOULDBLOCK))
+			{
+				// wait until the socket can take more
+				ev.events = EPOLLOUT;
+				ev.data.u32 = (c-conns)+1;
+				epoll_ctl(epfd,EPOLL_CTL_MOD,c->fd,&ev);
+				return 0;
+			}
+			CloseConn(c);
+			return 1;
+		}
+		c->sent += n;
+	}
+	if (!c->keep)
+	{
+		CloseConn(c);
+		return 1;
+	}
+	c->nhdr = c->nbody = c->sent = 0;
+	ev.events = EPOLLIN;
+	ev.data.u32 = (c-conns)+1;
+	epoll_ctl(epfd,EPOLL_CTL_MOD,c->fd,&ev);
+	return 0;
+}
+
+//**************************************************************************
+// answer the request at the front of c->in, len bytes including the
+// blank line
+static void Answer(HTTPCONN *c, int len)
+{
+	char method[8], path[64], version[16], *status = "200 OK";
+	char *type = "application/json";
+
+	c->in[len-1] = 0;
+	method[0] = path[0] = version[0] = 0;
+	sscanf(c->in,"%7s %63s %15s",method,path,version);
+	// HTTP/1.1 keeps the connection unless told not to, 1.0 the other way
+	if (!strcmp(version,"HTTP/1.1"))
+		c->keep = (strcasestr(c->in,"\nConnection: close")==NULL);
+	else
+		c->keep = (strcasestr(c->in,"\nConnection: keep-alive")!=NULL);
+
+	c->nbody = 0;
+	if (strcmp(method,"GET"))
+	{
+		status = "405 Method Not Allowed";
+		type = "text/plain";
+		Put(c,"only GET\n");
+	}
+	else if (!strcmp(path,"/now"))
+		PageNow(c);
+	else if (!strcmp(path,"/stats"))
+		PageStats(c);
+	else if (!strcmp(path,"/metrics"))
+	{
+		type = "text/plain; version=0.0.4";
+		PageMetrics(c);
+	}
+	else
+	{
+		status = "404 Not Found";
+		type = "text/plain";
+		Put(c,"try /now, /stats or /metrics\n");
+	}
+	c->nhdr = snprintf(c->hdr,sizeof(c->hdr),
+			"HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n"
+			"Connection: %s\r\n\r\n",status,type,c->nbody,c->keep?"keep-alive":"close");
+	c->sent = 0;
+	requests++;
+
+	// keep anything the client already sent after this request
+	memmove(c->in,c->in+len,c->nin-len);
+	c->nin -= len;
+}
+
+//**************************************************************************
+// read from a connection and answer any complete requests
+static void Receive(HTTPCONN *c)
+{
+	char *end;
+	int n;
+
+	for (;;)
+	{
+		n = read(c->fd,c->in+c->nin,HTTPINSZ-1-c->nin);
+		if (n==0)
+		{
+			CloseConn(c);
+			return;
+		}
+		if (n<0)
+		{
+			if ((errno==EAGAIN)||(errno==EWOULDBLOCK))
+				break;
+			CloseConn(c);
+			return;
+		}
+		c->nin += n;
+		c->in[c->nin] = 0;
+		if (c->nin>=HTTPINSZ-1)
+			break;
+	}
+	// one request at a time, the next waits until this one is sent
+	while ((c->fd>=0) && (c->nhdr==0) && ((end = strstr(c->in,"\r\n\r\n"))!=NULL))
+	{
+		Answer(c,end-c->in+4);
+		c->in[c->nin] = 0;
+		if (Send(c))
+			return;
+	}
+	if ((c->fd>=0) && (c->nin>=HTTPINSZ-1))
+	{
+		Log("httpthread> request too long, connection closed");
+		CloseConn(c);
+	}
+}
+
+//**************************************************************************
+// take a new connection
+static void Accept(int lfd, time_t now)
+{
+	struct epoll_event ev;
+	int fd, i, one = 1;
+
+	while ((fd = accept(lfd,NULL,NULL))>=0)
+	{
+		for (i=0; i<HTTPCONNS; i++)
+			if (conns[i].fd<0)
+				break;
+		if (i==HTTPCONNS)
+		{
+			LogDbg("httpthread> too many connections");
+			close(fd);
+			continue;
+		}
+		fcntl(fd,F_SETFL,fcntl(fd,F_GETFL)|O_NONBLOCK);
+		setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+		conns[i].fd = fd;
+		conns[i].nin = conns[i].nhdr = conns[i].nbody = conns[i].sent = 0;
+		conns[i].last = now;
+		ev.events = EPOLLIN;
+		ev.data.u32 = i+1;
+		epoll_ctl(epfd,EPOLL_CTL_ADD,fd,&ev);
+	}
+}
+
+//**************************************************************************
+// Thread entry point, param is not used
+void *httpthread(void *param)
+{
+	struct epoll_event ev, evs[16];
+	struct sockaddr_in addr;
+	HTTPCONN *c;
+	time_t now, lastIdle = 0;
+	int lfd, i, n, one = 1;
+
+	if (httpPort<=0)
+	{
+		Log("httpthread> disabled");
+		return 0;
+	}
+	conns = calloc(HTTPCONNS,sizeof(HTTPCONN));
+	if (conns==NULL)
+	{
+		Log("httpthread> no memory for %d connections",HTTPCONNS);
+		return 0;
+	}
+	for (i=0; i<HTTPCONNS; i++)
+		conns[i].fd = -1;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(httpPort);
+	if (inet_pton(AF_INET,httpAddr,&addr.sin_addr)!=1)
+	{
+		Log("httpthread> bad httpaddr %s",httpAddr);
+		free(conns);
+		return 0;
+	}
+	lfd = socket(AF_INET,SOCK_STREAM|SOCK_NONBLOCK,0);
+	if (lfd>=0)
+		setsockopt(lfd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+	if ((lfd<0) || bind(lfd,(struct sockaddr*)&addr,sizeof(addr)) || listen(lfd,64))
+	{
+		Log("httpthread> error %d listening on %s:%d",errno,httpAddr,httpPort);
+		if (lfd>=0) close(lfd);
+		free(conns);
+		return 0;
+	}
+	epfd = epoll_create1(0);
+	ev.events = EPOLLIN;
+	ev.data.u32 = 0;
+	epoll_ctl(epfd,EPOLL_CTL_ADD,lfd,&ev);
+
+	Log("httpthread> listening on %s:%d",httpAddr,httpPort);
+	while (kicked!=2)
+	{
+		n = epoll_wait(epfd,evs,16,1000);
+		time(&now);
+		for (i=0; i<n; i++)
+		{
+			if (evs[i].data.u32==0)
+			{
+				Accept(lfd,now);
+				continue;
+			}
+			c = &conns[evs[i].data.u32-1];
+			if (c->fd<0)
+				continue;
+			c->last = now;
+			if (evs[i].events & (EPOLLERR|EPOLLHUP))
+				CloseConn(c);
+			else if (evs[i].events & EPOLLOUT)
+			{
+				if (Send(c)==0)
+					Receive(c);
+			}
+			else
+				Receive(c);
+		}
+		// drop idle connections
+		if (now!=lastIdle)
+		{
+			lastIdle = now;
+			for (i=0; i<HTTPCONNS; i++)
+				if ((conns[i].fd>=0) && (now-conns[i].last>HTTPIDLE))
+					CloseConn(&conns[i]);
+		}
+	}
+
+	for (i=0; i<HTTPCONNS; i++)
+		if (conns[i].fd>=0)
+			CloseConn(&conns[i]);
+	close(epfd);
+	close(lfd);
+	epfd = -1;
+	free(conns);
+	Log("httpthread> thread exiting");
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*---------------------------------------------------------------------------
+   i2c.c   I2C transactions, timed and counted
+	2026-10-17   initial edits
+
+	The sensor code builds each bus operation as a list of I2CMSG
+	parts and hands it to the backend in one call (I2C_RDWR on the Pi),
+	so a register read is one transaction with a repeated start instead
+	of a byte at a time.  Every transaction is timed into histI2c and
+	counted, whatever thread makes it.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "weatherstation.h"
+
+static I2CSTATS i2cstats;
+
+//**************************************************************************
+// run one transaction, the parts are joined with repeated starts
+//  RETURNS: 0 for success, -1 on error or no acknowledge
+int I2cXfer(int fd, I2CMSG *msg, int n)
+{
+	unsigned long long t0;
+	int i, err, bytes = 0;
+
+	t0 = MonoNs();
+	err = hal->i2cXfer(fd,msg,n);
+	HistAdd(&histI2c,MonoNs()-t0);
+	__atomic_add_fetch(&i2cstats.xfers,1,__ATOMIC_RELAXED);
+	if (err)
+	{
+		__atomic_add_fetch(&i2cstats.errors,1,__ATOMIC_RELAXED);
+		return -1;
+	}
+	for (i=0; i<n; i++)
+		bytes += msg[i].len;
+	__atomic_add_fetch(&i2cstats.bytes,bytes,__ATOMIC_RELAXED);
+	return 0;
+}
+
+//**************************************************************************
+// write len bytes
+//  RETURNS: 0 for success, -1 on error
+int I2cWrite(int fd, BYTE *buf, int len)
+{
+	I2CMSG m = { 0, len, buf };
+
+	return I2cXfer(fd,&m,1);
+}
+
+//**************************************************************************
+// read len bytes
+//  RETURNS: 0 for success, -1 on error
+int I2cRead(int fd, BYTE *buf, int len)
+{
+	I2CMSG m = { I2CREAD, len, buf };
+
+	return I2cXfer(fd,&m,1);
+}
+
+//**************************************************************************
+// read len registers starting at reg, in one transaction
+//  RETURNS: 0 for success, -1 on error
+int I2cReadRegs(int fd, int reg, BYTE *buf, int len)
+{
+	BYTE r = reg;
+	I2CMSG m[2] = { { 0, 1, &r }, { I2CREAD, len, buf } };
+
+	return I2cXfer(fd,m,2);
+}
+
+//**************************************************************************
+// write one register
+//  RETURNS: 0 for success, -1 on error
+int I2cWriteReg(int fd, int reg, int value)
+{
+	BYTE b[2] = { reg, value };
+
+	return I2cWrite(fd,b,2);
+}
+
+//**************************************************************************
+// copy the counters
+void I2cGetStats(I2CSTATS *out)
+{
+	memcpy(out,&i2cstats,sizeof(I2CSTATS));
+}
@@ -2,46 +2,84 @@
    Filename:   logfile.cpp
 
 	 antiquity   Ted Hale  created
+	 2026-10-17  messages go through a lock-free ring to a writer
+	             thread, callers never wait on the SD card
+	 2026-10-17  LogStop() leaves the ring allocated
+
+	Log() only formats the message into a ring slot.  The writer
+	thread started by LogStart() stamps the date (formatted once per
+	second), handles the daily file change and writes everything that
+	is waiting with one fflush.  logSync sets how often, in seconds,
+	the file is also fdatasync'd, 0 leaves that to the kernel.  When
+	the ring is full messages are dropped and counted.  Before
+	LogStart() and after LogStop() messages are written directly.
+	Threads that are never joined can still be in Log() when LogStop()
+	runs, so the ring is left allocated for them.
+
+	LogDbg() is a macro in weatherstation.h, the arguments are not
+	even evaluated unless debug is set, and building with NO_DEBUG_LOG
+	removes the calls altogether.
 
 ************************************************************************/
 
 /* system includes */
 #include <stdio.h>
-#include <stdlib.h>  
+#include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "weatherstation.h"
+
+#define LOGSLOTS	1024		// messages that can wait
+#define LOGTEXTSZ	248
+
+// one queued message
+typedef struct {
+	time_t		t;
+	char		text[LOGTEXTSZ];
+} LOGMSG;
 
 /* global data*/
 
-FILE *logfp = 0;      
+FILE *logfp = 0;
 unsigned long LineNum = 0;
 int Julian = 0;
 char FileName[100];
-int debug = 0;
+
+static RING				logq;
+static sem_t			logsem;
+static pthread_t		logTid;
+static int				logRunning = 0;
+static int				logQuit = 0;
+static unsigned long	logDropped = 0;
+static pthread_mutex_t	logLock = PTHREAD_MUTEX_INITIALIZER;	// direct writes only
 
 //**************************************************************************
 // Close the current log file if it is in use.
-void LogClose(void) 
+void LogClose(void)
 {
 	if (logfp != 0)
 	{
-		fclose(logfp); 
+		fclose(logfp);
 		logfp = 0;
 	}
-}     
+}
 
 
 
 //**************************************************************************
-//   Opens the logfile with the specified name and current date 
+//   Opens the logfile with the specified name and current date
 //   RETURNS: 1 if an error occurred creating the file
 //            0 for success
 //  filename should include full path but not suffix
-int LogOpen(char *filename) 
+int LogOpen(char *filename)
 {
 	char temp[200];
-	struct tm *today;
+	struct tm today;
 	time_t now;
 
 	if (filename == NULL) {
@@ -49,17 +87,18 @@ int LogOpen(char *filename)
 	}
 
 	time(&now);
-	today = localtime(&now);
+	localtime_r(&now,&today);
 
 	// save params globally for later
-	strncpy(FileName, filename, strlen(filename));
+	if (filename != FileName)
+		strncpy(FileName, filename, sizeof(FileName)-1);
 
 	// save this in global variable so we know when day changes
-	Julian = today->tm_yday+1;
+	Julian = today.tm_yday+1;
 
 	// put together the file name
-	sprintf(temp,"%s_%04d-%02d-%02d.log",filename,
-			 today->tm_year+1900,today->tm_mon+1,today->tm_mday);
+	snprintf(temp,sizeof(temp),"%s_%04d-%02d-%02d.log",filename,
+			 today.tm_year+1900,today.tm_mon+1,today.tm_mday);
 	logfp = fopen (temp, "a" );
 
 	if ( logfp == NULL ) {
@@ -71,64 +110,176 @@ int LogOpen(char *filename)
 }
 
 //**************************************************************************
-//  Write a message to the previously opened log file.
-//  Passed in a format string and variable number of parameters,
-//   in the format used by printf.
-void Log(char *format, ... ) 
+// write one message with line number and time stamp, the date string is
+// only formatted again when the second changes
+static void LogWrite(time_t t, char *text)
 {
-	char dtbuf[30];
-	va_list arglist;
-    struct tm *today;
-    time_t now;
+	static time_t lastT = 0;
+	static char dtbuf[80];
+	struct tm today;
 
-	time(&now);
-    today = localtime(&now);
-
-	if( Julian != today->tm_yday+1 ) {
-		LogClose();
-		LogOpen( FileName );
+	if (t!=lastT)
+	{
+		localtime_r(&t,&today);
+		if( Julian != today.tm_yday+1 ) {
+			if (logfp!=NULL) fflush(logfp);
+			LogClose();
+			LogOpen( FileName );
+		}
+		snprintf(dtbuf,sizeof(dtbuf),"%02d/%02d/%04d %02d:%02d:%02d",today.tm_mon+1,today.tm_mday,
+			today.tm_year+1900,today.tm_hour,today.tm_min,today.tm_sec);
+		lastT = t;
 	}
 
 	if (logfp==NULL) return;
 
-	sprintf(dtbuf,"%02d/%02d/%04d %02d:%02d:%02d",today->tm_mon+1,today->tm_mday,
-		today->tm_year+1900,today->tm_hour,today->tm_min,today->tm_sec);
-	fprintf(logfp, "%5lu  %s ",LineNum++,dtbuf);
-	va_start ( arglist, format );
-	vfprintf (logfp, format, arglist );
-	fprintf(logfp,"\r\n");
-	fflush ( logfp );
+	fprintf(logfp, "%5lu  %s %s\r\n",LineNum++,dtbuf,text);
 }
 
 //**************************************************************************
-//  same as Log but does nothind if debug is 0
-void LogDbg(char *format, ... ) 
+// writer thread, empties the ring
+static void *LogThread(void *param)
 {
-	char dtbuf[30];
-	va_list arglist;
-    struct tm *today;
-    time_t now;
+	LOGMSG m;
+	struct timespec ts;
+	time_t lastSync = 0, now;
+	unsigned long dropped = 0;
+	char tmp[60];
+	int n;
+
+	for (;;)
+	{
+		clock_gettime(CLOCK_REALTIME,&ts);
+		ts.tv_sec += 1;
+		sem_timedwait(&logsem,&ts);
+
+		// everything waiting goes out with a single flush
+		n = 0;
+		while (RingGet(&logq,&m)==0)
+		{
+			LogWrite(m.t,m.text);
+			n++;
+		}
+		if (logDropped!=dropped)
+		{
+			dropped = logDropped;
+			snprintf(tmp,sizeof(tmp),"log> queue full, %lu messages dropped so far",dropped);
+			LogWrite(time(NULL),tmp);
+			n++;
+		}
+		if ((n>0) && (logfp!=NULL))
+		{
+			fflush(logfp);
+			time(&now);
+			if ((logSync>0) && (now-lastSync>=logSync))
+			{
+				fdatasync(fileno(logfp));
+				lastSync = now;
+			}
+		}
+		if (logQuit && (RingCount(&logq)==0))
+			break;
+	}
+	if (logfp!=NULL)
+	{
+		fflush(logfp);
+		fdatasync(fileno(logfp));
+	}
+	return 0;
+}
+
+//**************************************************************************
+// start the writer thread, from here on Log() does not block
+//  RETURNS: 0 for success, 1 on error
+int LogStart(void)
+{
+	if (logRunning)
+		return 0;
+	if ((logq.data==NULL) && RingInit(&logq,LOGSLOTS,sizeof(LOGMSG)))
+		return 1;
+	sem_init(&logsem,0,0);
+	logQuit = 0;
+	if (pthread_create(&logTid,NULL,LogThread,NULL))
+		return 1;
+	__atomic_store_n(&logRunning,1,__ATOMIC_RELEASE);
+	return 0;
+}
+
+//**************************************************************************
+// write out anything waiting and stop the writer thread.  The ring
+// is not freed, a thread may have seen logRunning just before
+void LogStop(void)
+{
+	LOGMSG m;
 
-	if (!debug)
+	if (!logRunning)
 		return;
-		
-	time(&now);
-    today = localtime(&now);
+	logQuit = 1;
+	sem_post(&logsem);
+	pthread_join(logTid,NULL);
+	__atomic_store_n(&logRunning,0,__ATOMIC_RELEASE);
+	// anything put while the writer was on its way out
+	pthread_mutex_lock(&logLock);
+	while (RingGet(&logq,&m)==0)
+		LogWrite(m.t,m.text);
+	if (logfp!=NULL)
+		fflush(logfp);
+	pthread_mutex_unlock(&logLock);
+}
+
+//**************************************************************************
+// messages lost because the ring was full
+unsigned long LogDropped(void)
+{
+	return logDropped;
+}
+
+//**************************************************************************
+// queue or write one message
+static void LogMsg(char *format, va_list arglist)
+{
+	LOGMSG m;
 
-	if( Julian != today->tm_yday+1 ) {
-		LogClose();
-		LogOpen( FileName );
+	m.t = time(NULL);
+	vsnprintf(m.text, sizeof(m.text), format, arglist);
+	if (__atomic_load_n(&logRunning,__ATOMIC_ACQUIRE))
+	{
+		if (RingPut(&logq,&m))
+			__atomic_add_fetch(&logDropped,1,__ATOMIC_RELAXED);
+		else
+			sem_post(&logsem);
+		return;
 	}
+	// no writer thread, do it here
+	pthread_mutex_lock(&logLock);
+	LogWrite(m.t,m.text);
+	if (logfp!=NULL)
+		fflush(logfp);
+	pthread_mutex_unlock(&logLock);
+}
 
-	if (logfp==NULL) return;
+//**************************************************************************
+//  Write a message to the previously opened log file.
+//  Passed in a format string and variable number of parameters,
+//   in the format used by printf.
+void Log(char *format, ... )
+{
+	va_list arglist;
+
+	va_start ( arglist, format );
+	LogMsg(format, arglist);
+	va_end ( arglist );
+}
+
+//**************************************************************************
+//  same as Log, called by the LogDbg macro only when debug is set
+void LogDbgMsg(char *format, ... )
+{
+	va_list arglist;
 
-	sprintf(dtbuf,"%02d/%02d/%04d %02d:%02d:%02d",today->tm_mon+1,today->tm_mday,
-		today->tm_year+1900,today->tm_hour,today->tm_min,today->tm_sec);
-	fprintf(logfp, "%5lu  %s ",LineNum++,dtbuf);
 	va_start ( arglist, format );
-	vfprintf (logfp, format, arglist );
-	fprintf(logfp,"\r\n");
-	fflush ( logfp );
+	LogMsg(format, arglist);
+	va_end ( arglist );
 }
 
 //**************************************************************************
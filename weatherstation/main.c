@@ -4,6 +4,21 @@
 	By Ted B. Hale
 
   2014-11-27  initial edits
+  2026-10-17  database writes go through the dbthread queue
+  2026-10-17  hardware backend chosen by config, config file on cmd line
+  2026-10-17  log writer thread
+  2026-10-17  local column archive
+  2026-10-17  current conditions in shared memory
+  2026-10-17  HTTP status server
+  2026-10-17  config file parsed once, see config.c
+  2026-10-17  SIGHUP reloads the config without stopping the threads
+  2026-10-17  running totals checkpointed across restarts
+  2026-10-17  one sensor scheduler thread instead of i2c and w1 threads
+  2026-10-17  pulselog= records wind and rain pulses for weatherstation-replay
+  2026-10-17  eventloop=1 runs sensors, rain, wind and the heartbeat on
+              one reactor.c thread instead of polling threads
+  2026-10-17  rtprio, rtsample, rtcpus and mlock, see rt.c
+  2026-10-17  a reload that can not read the config file keeps the old settings
   
 ---------------------------------------------------------------------------*/
 
@@ -18,35 +33,89 @@
 #include <unistd.h>
 #include <pthread.h>
 
-#include <wiringPi.h>
-#include <wiringPiSPI.h>
-
 // this defines the pre-processor variable EXTERN to be nothing
 // it results in the variables in RPiHouse.h being defined only here 
 #define EXTERN
 #include "weatherstation.h"
 
+static volatile int reload;				// SIGHUP seen
+static char logFile[100];				// settings only read at startup
+static char backend[20];
+static TIMER beat;						// heartbeat LED, eventloop=1
+
 //************************************************************************
-// read various configuration values for program
-void readConfig(char *fname)
+// a string setting that is only read at startup, on a reload a change
+// is logged and otherwise ignored
+static void Fixed(char *name, char *def, char *var, int sz, int reloading)
 {
-	char temp[100];
-	
-	ReadConfigString("debug","0",temp,sizeof(temp),fname);
-	debug = atoi(temp);	
-	ReadConfigString("database","weather",dbdatabase,sizeof(dbdatabase),fname);
-	ReadConfigString("dbhost","localhost",dbhost,sizeof(dbhost),fname);
-	ReadConfigString("dbuser","ted",dbuser,sizeof(dbuser),fname);
-	ReadConfigString("dbpass","secret",dbpass,sizeof(dbpass),fname);
-
-	ReadConfigString("tempA","",tempA_ID,sizeof(tempA_ID),fname);
+	if (!reloading)
+		ConfigCopy(name,def,var,sz);
+	else if (strcmp(ConfigStr(name,def),var))
+		Log("Main> %s changed, restart weatherstation to use it",name);
+}
+
+//************************************************************************
+// the same for a number
+static void FixedInt(char *name, int def, int min, int max, int *var, int reloading)
+{
+	int x;
+
+	x = ConfigInt(name,def,min,max);
+	if (!reloading)
+		*var = x;
+	else if (x!=*var)
+		Log("Main> %s changed, restart weatherstation to use it",name);
+}
+
+//************************************************************************
+// read various configuration values for program.  On a reload the
+// threads are left running: they check the plain numbers below each
+// time round their loops, and sensorthread and dbthread pick up their own
+// settings from the new table when ConfigGen() changes.  A reload of a
+// file that can not be read leaves everything as it was
+void readConfig(char *fname, int reloading)
+{
+	if (ConfigLoad(fname) && reloading)
+		return;
+	debug = ConfigInt("debug",0,0,9);
+	dbflush = ConfigInt("dbflush",10,1,3600);
+	windReport = ConfigInt("windreport",120,10,86400);
+	i2cPeriod = ConfigInt("i2cperiod",3000,1,3600000);
+	logSync = ConfigInt("logsync",60,0,86400);
+	stateSave = ConfigInt("statesave",10,0,3600);
+
+	Fixed("dbtype","mysql",dbtype,sizeof(dbtype),reloading);
+	FixedInt("dbbatch",20,1,1000,&dbbatch,reloading);
+	FixedInt("dbqueue",1024,16,1<<20,&dbqsize,reloading);
+	Fixed("spooldir","/var/spool/weatherstation",spooldir,sizeof(spooldir),reloading);
+	FixedInt("spoolmax",64,1,1<<20,&spoolmax,reloading);
+	Fixed("archivedir","/var/lib/weatherstation/archive",archivedir,sizeof(archivedir),reloading);
+	Fixed("pulselog","",pulseLog,sizeof(pulseLog),reloading);
+	Fixed("statefile","/var/lib/weatherstation/state",stateFile,sizeof(stateFile),reloading);
+	FixedInt("httpport",8080,0,65535,&httpPort,reloading);
+	Fixed("httpaddr","127.0.0.1",httpAddr,sizeof(httpAddr),reloading);
+	Fixed("logfile","/opt/projects/logs/weatherstation",logFile,sizeof(logFile),reloading);
+	Fixed("backend","pi",backend,sizeof(backend),reloading);
+	FixedInt("eventloop",0,0,1,&eventLoop,reloading);
+	FixedInt("rtprio",0,0,99,&rtPrio,reloading);
+	FixedInt("rtsample",0,0,99,&rtSample,reloading);
+	Fixed("rtcpus","",rtCpus,sizeof(rtCpus),reloading);
+	FixedInt("mlock",0,0,1,&rtLock,reloading);
+	if (reloading)
+		return;
+
+	ConfigCopy("database","weather",dbdatabase,sizeof(dbdatabase));
+	ConfigCopy("dbhost","localhost",dbhost,sizeof(dbhost));
+	ConfigCopy("dbuser","ted",dbuser,sizeof(dbuser));
+	ConfigCopy("dbpass","secret",dbpass,sizeof(dbpass));
+	ConfigCopy("tempA","",tempA_ID,sizeof(tempA_ID));
 	
 	Log("%s %s %s %s",dbhost,dbdatabase,dbuser,dbpass);
 }
 
 
 //************************************************************************
-// handles signals to restart or shutdown
+// handles signals to reload the config or shutdown
 void sig_handler(int signo)
 {
     switch (signo) {
@@ -54,9 +123,10 @@ void sig_handler(int signo)
         break;
 
       case SIGHUP:
-	    // do a restart
-	    Log("SIG restart\n");
-		kicked = 1;
+	    // reload the config, the main loop does it
+	    Log("SIG reload\n");
+		reload = 1;
+		ReactorWake();
         break;
 
       case SIGINT:
@@ -64,18 +134,104 @@ void sig_handler(int signo)
 		// do a clean exit
 	    Log("SIG exit\n");
 	    kicked = 2;
+		ReactorWake();
         break;
     }
 }
+//************************************************************************
+// eventloop=1: blink the heartbeat LED and reload the config when asked
+static void Heartbeat(TIMER *t)
+{
+	static int on;
+
+	on = !on;
+	hal->gpioWrite(HEARTBEAT_PIN,on);
+	if (reload)
+	{
+		reload = 0;
+		readConfig(confFile,1);
+		Log("Main> config reloaded");
+		SensorWake();
+	}
+	TimerAt(t,t->when+500000000ULL);
+}
+
+//************************************************************************
+// a thread each for the sensors, rain and wind, this one blinks the
+// heartbeat until a signal to exit
+static void RunThreads(void)
+{
+	pthread_t	tid1,tid2,tid3;				// thread IDs
+	int x;
+
+	tid1 = tid2 = tid3 = 0;
+
+	// start the various threads, they run until exit
+	Log("Main> start threads");
+	pthread_create(&tid1, NULL, sensorthread, NULL);
+	Sleep(100);
+	pthread_create(&tid2, NULL, rainthread, NULL);
+	Sleep(100);
+	pthread_create(&tid3, NULL, anemometerthread, NULL);
+
+	// wait for signal to exit, reloading the config when asked
+	x = 0;
+	do
+	{
+		// blink the heartbeat LED
+		if (x==0)
+		{
+			hal->gpioWrite(HEARTBEAT_PIN,1);
+			x = 20;
+		} else if (x==10)
+		{
+			hal->gpioWrite(HEARTBEAT_PIN,0);
+		}
+		if (reload)
+		{
+			reload = 0;
+			readConfig(confFile,1);
+			Log("Main> config reloaded");
+			SensorWake();
+		}
+		Sleep(50);
+		x--;
+	} while (kicked==0); 
+	RainWake();
+	
+	// wait for running threads to stop
+	if (tid1!=0) pthread_join(tid1, NULL);
+	if (tid2!=0) pthread_join(tid2, NULL);
+	if (tid3!=0) pthread_join(tid3, NULL);
+}
+
+//************************************************************************
+// eventloop=1: everything on this thread until a signal to exit
+static void RunEvents(void)
+{
+	Log("Main> start event loop");
+	RtThread("event loop",rtSample);
+	SensorStart();
+	RainStart();
+	AnemometerStart();
+	TimerInit(&beat,Heartbeat,NULL);
+	TimerAt(&beat,MonoNs());
+	ReactorRun();
+	AnemometerStop();
+	RainStop();
+	SensorStop();
+}
+
 //************************************************************************
 // and finally, the main program
 // a cmd line parameter of "f" will cause it to run in the foreground 
-// instead of as a daemon 
+// instead of as a daemon, a second parameter names the config file
 int main(int argc, char *argv[])
 {
     pid_t		pid;
 	FILE		*f;
-	pthread_t	tid1,tid2,tid3,tid4;		// thread IDs
+	pthread_t	tiddb = 0;					// database writer
+	pthread_t	tidhttp = 0;				// status server
 	int x;
 	
 	// check cmd line param
@@ -115,75 +271,78 @@ int main(int argc, char *argv[])
 	LogOpen("/opt/projects/logs/weatherstation");
 
 	// read config values
-	readConfig(CONFFILE);
+	strncpy(confFile,(argc>2)?argv[2]:CONFFILE,sizeof(confFile)-1);
+	readConfig(confFile,0);
+
+	// move the log if the config says so
+	if (strcmp(logFile,"/opt/projects/logs/weatherstation"))
+	{
+		LogClose();
+		LogOpen(logFile);
+	}
 	
 	// set log debug flag
 	LogSetDebug(debug);
+
+	// from here on log lines are written by their own thread
+	LogStart();
+
+	// lock memory before the threads are started
+	RtInit();
 	
-	// initialize the WiringPi interface
-	Log("Main> init wiringPi");
-	x = wiringPiSetup ();
+	// initialize the hardware interface
+	if (HalSelect(backend))
+	{
+		Log("Main> unknown backend %s.  weatherstation quitting.",backend);
+		LogStop();
+		return 0;
+	}
+	Log("Main> init %s backend",hal->name);
+	x = hal->setup();
 	if (x == -1)
 	{
-		Log("Main> Error on wiringPiSetup.  weatherstation quitting.");
+		Log("Main> Error on %s setup.  weatherstation quitting.",hal->name);
+		LogStop();
 		return 0;
 	}	
 	// config heartbeat pin
-	pinMode (11, OUTPUT);
+	hal->gpioOutput(HEARTBEAT_PIN);
+
+	// current conditions for other programs
+	SnapInit();
+	// running totals from the last run
+	CkptInit(stateFile);
 
-	// open database
-	conn = mysql_init(NULL);
-	ConnectToDb();
+	// start database writer, it runs until the sensor threads are gone
+	if (DbQueueInit()==0)
+		pthread_create(&tiddb, NULL, dbthread, NULL);
+	pthread_create(&tidhttp, NULL, httpthread, NULL);
 	
-	// start the main loop
-	do
+	if (eventLoop && ReactorInit())
 	{
-		// start the various threads
-		Log("Main> start threads");
-		tid1 = tid2 = tid3 = tid4 = 0;
-		pthread_create(&tid1, NULL, i2cthread, NULL);
-		Sleep(100);
-		pthread_create(&tid2, NULL, w1thread, NULL);
-		Sleep(100);
-		pthread_create(&tid3, NULL, rainthread, NULL);
-		Sleep(100);
-		pthread_create(&tid4, NULL, anemometerthread, NULL);
-	
-		// wait for signal to restart or exit
-		int i=0;
-		do
-		{
-			// blink the heartbeat LED
-			if (i==0)
-			{
-				digitalWrite(11,1);
-				i=20;
-			} else if (i==10)
-			{
-				digitalWrite(11,0);
-			}
-			Sleep(50);
-			i--;
-		} while (kicked==0); 
-		
-		// wait for running threads to stop
-		if (tid1!=0) pthread_join(tid1, NULL);
-		if (tid2!=0) pthread_join(tid2, NULL);
-		if (tid3!=0) pthread_join(tid3, NULL);
-		if (tid4!=0) pthread_join(tid4, NULL);
-
-		// exit?
-		if (kicked==2) break;
-		// else restart, set flag back to 0
-		kicked = 0;
-
-	} while (1); // forever
+		Log("Main> no event loop, starting threads");
+		eventLoop = 0;
+	}
+	if (eventLoop)
+		RunEvents();
+	else
+		RunThreads();
+	GpioStop();
+
+	// let the writer empty its queue
+	dbStop = 1;
+	if (tiddb!=0) pthread_join(tiddb, NULL);
+	if (tidhttp!=0) pthread_join(tidhttp, NULL);
+	CkptClose();
 
 	// delete the PID file
     unlink(PIDFILE);
+	SnapClose();
 
 	Log("Program Exit *****");
 	Log(" ");
+	LogStop();
+	ConfigFree();
 
 	return 0;
 }
@@ -0,0 +1,71 @@
+/*---------------------------------------------------------------------------
+   metric.c   table of metric names
+	2026-10-17   initial edits
+
+	Threads look up the id for each name they store once at start up
+	and then pass the small integer around instead of the string.  Ids
+	are never removed, so a name read with MetricName() stays valid.
+	Names are kept to METRICNAMESZ-1 characters and looked up the
+	same way, so a longer name still gets the one id.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "weatherstation.h"
+
+static char				names[MAXMETRICS][METRICNAMESZ];
+static int				nmetrics = 0;
+static pthread_mutex_t	metricLock = PTHREAD_MUTEX_INITIALIZER;
+
+//**************************************************************************
+// get the id for a metric name, adding it if it is new
+//  RETURNS: id, or -1 if the table is full
+int MetricId(char *name)
+{
+	int i, n;
+
+	// ids already published can be searched without the lock
+	n = __atomic_load_n(&nmetrics, __ATOMIC_ACQUIRE);
+	for (i=0; i<n; i++)
+		if (!strncmp(names[i],name,METRICNAMESZ-1))
+			return i;
+
+	pthread_mutex_lock(&metricLock);
+	for (i=0; i<nmetrics; i++)
+		if (!strncmp(names[i],name,METRICNAMESZ-1))
+			break;
+	if (i==nmetrics)
+	{
+		if (nmetrics>=MAXMETRICS)
+		{
+			pthread_mutex_unlock(&metricLock);
+			Log("MetricId> table full, %s ignored",name);
+			return -1;
+		}
+		if (strlen(name)>=METRICNAMESZ)
+			Log("MetricId> %s is kept as its first %d characters",name,METRICNAMESZ-1);
+		strncpy(names[i],name,METRICNAMESZ-1);
+		__atomic_store_n(&nmetrics, i+1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&metricLock);
+	return i;
+}
+
+//**************************************************************************
+// get the name for an id
+char *MetricName(int id)
+{
+	if ((id<0)||(id>=__atomic_load_n(&nmetrics, __ATOMIC_ACQUIRE)))
+		return "unknown";
+	return names[id];
+}
+
+//**************************************************************************
+// number of metrics defined so far
+int MetricCount(void)
+{
+	return __atomic_load_n(&nmetrics, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,134 @@
+/*---------------------------------------------------------------------------
+   now.c   print current conditions from the daemon's snapshot
+	2026-10-17   initial edits
+
+	usage: weatherstation-now [-j] [-w secs] [field]
+	  -j  one JSON object per reading instead of name value lines
+	  -w  print again every secs seconds until killed
+	  field  print just that value, e.g. weatherstation-now windGust
+
+	Reads the shared memory snapshot (snapshot.c), it does not lock
+	anything or wait on the daemon.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "weatherstation.h"
+
+// fields that can be printed
+static struct {
+	char	*name;
+	int		offset;
+	char	*fmt;
+} fields[] = {
+	{ "outsideTemp",	offsetof(SNAPSHOT,outsideTemp),	"%.1f" },
+	{ "humidity",		offsetof(SNAPSHOT,humidity),	"%.1f" },
+	{ "boardTemp",		offsetof(SNAPSHOT,boardTemp),	"%.1f" },
+	{ "barometric",		offsetof(SNAPSHOT,barometric),	"%.2f" },
+	{ "tempA",			offsetof(SNAPSHOT,tempA),		"%.1f" },
+	{ "windSpeed",		offsetof(SNAPSHOT,windSpeed),	"%.1f" },
+	{ "windGust",		offsetof(SNAPSHOT,windGust),	"%.1f" },
+	{ "windNow",		offsetof(SNAPSHOT,windNow),		"%.1f" },
+	{ "rainPeriod",		offsetof(SNAPSHOT,rainPeriod),	"%.3f" },
+	{ "rainToday",		offsetof(SNAPSHOT,rainToday),	"%.2f" },
+	{ "rainRate",		offsetof(SNAPSHOT,rainRate),	"%.2f" },
+	{ "rainRate5",		offsetof(SNAPSHOT,rainRate5),	"%.2f" },
+	{ "rainRate15",		offsetof(SNAPSHOT,rainRate15),	"%.2f" },
+	{ "updated",		offsetof(SNAPSHOT,updated),		"%.3f" },
+	{ NULL, 0, NULL }
+};
+
+#define FIELD(s,i)	(*(double *)((char *)(s)+fields[i].offset))
+
+//**************************************************************************
+static void Usage(void)
+{
+	fprintf(stderr,"usage: weatherstation-now [-j] [-w secs] [field]\n");
+	exit(1);
+}
+
+//**************************************************************************
+// print one reading
+static void Print(SNAPSHOT *s, int json, int only)
+{
+	int i;
+
+	if (only>=0)
+	{
+		printf(fields[only].fmt,FIELD(s,only));
+		printf("\n");
+		return;
+	}
+	if (json)
+		printf("{\"running\":%s",(s->pid!=0)?"true":"false");
+	else
+		printf("%-12s %s\n","running",(s->pid!=0)?"yes":"no");
+	for (i=0; fields[i].name!=NULL; i++)
+	{
+		if (json)
+		{
+			printf(",\"%s\":",fields[i].name);
+			printf(fields[i].fmt,FIELD(s,i));
+		}
+		else
+		{
+			printf("%-12s ",fields[i].name);
+			printf(fields[i].fmt,FIELD(s,i));
+			printf("\n");
+		}
+	}
+	printf(json?"}\n":"\n");
+}
+
+//**************************************************************************
+int main(int argc, char *argv[])
+{
+	SNAPSHOT *shm, s;
+	int c, i, json = 0, only = -1;
+	double every = 0;
+
+	while ((c = getopt(argc,argv,"jw:"))!=-1)
+	{
+		switch (c)
+		{
+			case 'j':	json = 1;				break;
+			case 'w':	every = atof(optarg);	break;
+			default:	Usage();
+		}
+	}
+	if (optind<argc-1)
+		Usage();
+	if (optind==argc-1)
+	{
+		for (i=0; fields[i].name!=NULL; i++)
+			if (!strcmp(fields[i].name,argv[optind]))
+				only = i;
+		if (only<0)
+			Usage();
+	}
+
+	shm = SnapOpen(SNAPNAME);
+	if (shm==NULL)
+	{
+		fprintf(stderr,"no snapshot, is weatherstation running?\n");
+		return 1;
+	}
+	do
+	{
+		if (SnapRead(shm,&s))
+		{
+			fprintf(stderr,"snapshot stuck mid update\n");
+			return 1;
+		}
+		Print(&s,json,only);
+		fflush(stdout);
+		if (every>0)
+			usleep(every*1000000);
+	} while (every>0);
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*---------------------------------------------------------------------------
+   pack.c   a batch of samples packed small, for the spool and the wire
+	2026-10-17   initial edits
+
+	The samples are split up by metric, keeping their order, and each
+	metric's run is a gorilla stream (gorilla.c) against the batch's
+	first time:
+
+		8 bytes    first time in the batch, ms
+		2 bytes    number of metrics
+		then for each metric
+		1 byte     name length, then the name
+		4 bytes    samples
+		4 bytes    stream length in bytes, then the stream
+
+	Numbers are in host order, the same as the other files we write.
+	Names are carried rather than ids since ids change between runs.
+	Times are kept to the ms, values exactly.  The sample kind is not
+	kept, unpacked samples are all SAMPLE_VALUE.
+
+---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "weatherstation.h"
+
+//**************************************************************************
+// pack n samples into buf.  PACKSIZE(n) bytes is always enough
+//  RETURNS: bytes used, -1 if they do not fit
+int SamplePack(SAMPLE *s, int n, BYTE *buf, int sz)
+{
+	GORILLA g;
+	BYTE done[n>0?n:1];
+	long long base;
+	uint16_t metrics = 0;
+	uint32_t cnt, len;
+	char *name;
+	int i, j, p, namelen, at;
+
+	if (sz<10)
+		return -1;
+	base = (n>0) ? llround(s[0].dt*1000) : 0;
+	memcpy(buf,&base,8);
+	p = 10;
+	memset(done,0,n);
+	for (i=0; i<n; i++)
+	{
+		if (done[i])
+			continue;
+		name = MetricName(s[i].metric);
+		namelen = strlen(name);
+		if (namelen>METRICNAMESZ-1)
+			namelen = METRICNAMESZ-1;
+		at = p+1+namelen+8;
+		if (at>sz)
+			return -1;
+		buf[p] = namelen;
+		memcpy(buf+p+1,name,namelen);
+		GorillaInit(&g,buf+at,sz-at,base);
+		for (j=i; j<n; j++)
+		{
+			if (done[j] || (s[j].metric!=s[i].metric))
+				continue;
+			if (GorillaPut(&g,llround(s[j].dt*1000),s[j].value))
+				return -1;
+			done[j] = 1;
+		}
+		cnt = g.count;
+		len = GorillaBytes(&g);
+		memcpy(buf+p+1+namelen,&cnt,4);
+		memcpy(buf+p+1+namelen+4,&len,4);
+		p = at+len;
+		metrics++;
+	}
+	memcpy(buf+8,&metrics,2);
+	return p;
+}
+
+//**************************************************************************
+// unpack up to max samples from a packed batch, grouped by metric
+//  RETURNS: number of samples, -1 if it is damaged or holds more than max
+int SampleUnpack(const BYTE *buf, int len, SAMPLE *s, int max)
+{
+	GORILLAREAD r;
+	char name[METRICNAMESZ];
+	long long base, t;
+	uint16_t metrics;
+	uint32_t cnt, zlen;
+	int m, id, namelen, p, n = 0;
+	double v;
+
+	if (len<10)
+		return -1;
+	memcpy(&base,buf,8);
+	memcpy(&metrics,buf+8,2);
+	p = 10;
+	for (m=0; m<metrics; m++)
+	{
+		if (p+1>len)
+			return -1;
+		namelen = buf[p];
+		if ((namelen>METRICNAMESZ-1) || (p+1+namelen+8>len))
+			return -1;
+		memcpy(name,buf+p+1,namelen);
+		name[namelen] = 0;
+		memcpy(&cnt,buf+p+1+namelen,4);
+		memcpy(&zlen,buf+p+1+namelen+4,4);
+		p += 1+namelen+8;
+		if ((zlen>(uint32_t)(len-p)) || (cnt>(uint32_t)(max-n)))
+			return -1;
+		id = MetricId(name);
+		GorillaReadInit(&r,buf+p,zlen,cnt,base);
+		while (!GorillaNext(&r,&t,&v))
+		{
+			s[n].metric = id;
+			s[n].kind = SAMPLE_VALUE;
+			s[n].value = v;
+			s[n].dt = t/1000.0;
+			s[n].tq = 0;
+			n++;
+		}
+		if (r.n!=(int)cnt)
+			return -1;
+		p += zlen;
+	}
+	return n;
+}
@@ -0,0 +1,123 @@
+/*---------------------------------------------------------------------------
+   pulse.c   single producer / single consumer ring of pulse times
+	2026-10-17   initial edits
+
+	The interrupt handler for a counter pin is the only writer and
+	the thread that processes the pulses is the only reader, so plain
+	loads and stores with acquire/release ordering are all that is
+	needed.  Times are CLOCK_MONOTONIC nanoseconds from MonoNs().
+
+	2026-10-17   the consumer can also write the pulses it takes to a
+	             daily file, "<unix seconds> W" a line, for
+	             weatherstation-replay (replay.c)
+	2026-10-17   a file that will not open is tried again the next
+	             day or after PULSERETRY seconds, not every pulse
+
+---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "weatherstation.h"
+
+#define PULSERETRY	60				// seconds between tries at a pulse file
+
+//**************************************************************************
+// set up ring for at least n pulses
+//  RETURNS: 0 for success, 1 if out of memory
+int PulseInit(PULSERING *p, int n)
+{
+	unsigned int sz = 2;
+
+	while (sz<(unsigned int)n)
+		sz <<= 1;
+	memset(p,0,sizeof(PULSERING));
+	p->buf = calloc(sz,sizeof(unsigned long long));
+	if (p->buf==NULL)
+		return 1;
+	p->mask = sz-1;
+	return 0;
+}
+
+//**************************************************************************
+// add a pulse time, called from the interrupt handler only
+void PulsePut(PULSERING *p, unsigned long long t)
+{
+	unsigned int h, tl;
+
+	if (p->buf==NULL)
+		return;
+	h = p->head;
+	tl = __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE);
+	if (h-tl>p->mask)
+	{
+		// consumer fell behind, count it but keep the old pulses
+		p->overruns++;
+		return;
+	}
+	p->buf[h & p->mask] = t;
+	__atomic_store_n(&p->head, h+1, __ATOMIC_RELEASE);
+	p->total++;
+}
+
+//**************************************************************************
+// take the oldest pulse time, called from the consumer thread only
+//  RETURNS: 0 for success, 1 if empty
+int PulseGet(PULSERING *p, unsigned long long *t)
+{
+	unsigned int h, tl;
+
+	tl = p->tail;
+	h = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+	if (h==tl)
+		return 1;
+	*t = p->buf[tl & p->mask];
+	__atomic_store_n(&p->tail, tl+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+//**************************************************************************
+// record a pulse at unix time t in <base>_<name>_YYYY-MM-DD.txt, a new
+// file each local day.  base empty records nothing, and so does a
+// file that failed to open until it is tried again
+void PulseLogPut(PULSELOG *l, char *base, double t)
+{
+	char fname[150];
+	time_t tt = (time_t)t;
+	struct tm tm;
+
+	if (base[0]==0)
+		return;
+	localtime_r(&tt,&tm);
+	if ((l->f==NULL) && (tm.tm_yday==l->yday) && (t<l->retry))
+		return;
+	if ((l->f==NULL) || (tm.tm_yday!=l->yday))
+	{
+		if (l->f!=NULL)
+			fclose(l->f);
+		snprintf(fname,sizeof(fname),"%s_%s_%04d-%02d-%02d.txt",base,l->name,
+				 tm.tm_year+1900,tm.tm_mon+1,tm.tm_mday);
+		l->f = fopen(fname,"a");
+		l->yday = tm.tm_yday;
+		if (l->f==NULL)
+		{
+			if (!l->failed)
+				Log("pulse> can not open %s",fname);
+			l->failed = 1;
+			l->retry = t+PULSERETRY;
+			return;
+		}
+		l->failed = 0;
+	}
+	fprintf(l->f,"%.6f %c\n",t,l->kind);
+}
+
+//**************************************************************************
+// write out what has been recorded
+void PulseLogFlush(PULSELOG *l)
+{
+	if (l->f!=NULL)
+		fflush(l->f);
+}
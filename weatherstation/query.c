@@ -0,0 +1,242 @@
+/*---------------------------------------------------------------------------
+   query.c   read the local column archive
+	2026-10-17   initial edits
+
+	usage: weatherstation-query [-d dir] [-f from] [-t to] [-b bucket] metric
+	       weatherstation-query [-d dir] -l
+	  -l  list the metrics in the archive, with what the compressed
+	      blocks take per sample
+	  -f, -t  time range, "YYYY-MM-DD", "YYYY-MM-DD HH:MM[:SS]" local
+	      time or unix seconds.  Default is everything
+	  -b  raw (default), minute, hour, day, or a number of seconds.
+	      Anything but raw prints count, min, max, mean and sum for
+	      each interval that has samples
+
+	e.g. the daily rain totals for this year
+	  weatherstation-query -f 2026-01-01 -b day rainfall
+
+---------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE			// strptime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "weatherstation.h"
+
+#define ARCHIVEDIR	"/var/lib/weatherstation/archive"
+
+//**************************************************************************
+static void Usage(void)
+{
+	fprintf(stderr,"usage: weatherstation-query [-d dir] [-f from] [-t to] [-b bucket] metric\n"
+				   "       weatherstation-query [-d dir] -l\n"
+				   "  bucket is raw, minute, hour, day or seconds\n");
+	exit(1);
+}
+
+//**************************************************************************
+// monotonic clock in ms, for the timing line
+static double Ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec*1000.0 + ts.tv_nsec/1e6;
+}
+
+//**************************************************************************
+// parse a time argument
+//  RETURNS: ms since 1970, or -1 if it can not be read
+static long long ParseTime(char *s)
+{
+	struct tm tm;
+	char *p;
+
+	memset(&tm,0,sizeof(tm));
+	p = strptime(s,"%Y-%m-%d",&tm);
+	if (p!=NULL)
+	{
+		if ((*p!=0) && (strptime(p," %H:%M:%S",&tm)==NULL) &&
+			(strptime(p," %H:%M",&tm)==NULL))
+			return -1;
+		tm.tm_isdst = -1;
+		return mktime(&tm)*1000LL;
+	}
+	if (strspn(s,"0123456789")!=strlen(s))
+		return -1;
+	return atoll(s)*1000LL;
+}
+
+//**************************************************************************
+// print a time as local date and time
+static char *FmtTime(long long ms, char *buf)
+{
+	time_t t = ms/1000;
+	struct tm tm;
+
+	localtime_r(&t,&tm);
+	sprintf(buf,"%04d-%02d-%02d %02d:%02d:%02d",tm.tm_year+1900,tm.tm_mon+1,
+			tm.tm_mday,tm.tm_hour,tm.tm_min,tm.tm_sec);
+	return buf;
+}
+
+//**************************************************************************
+// start of the bucket holding t.  Hours and days follow local time,
+// so a day runs from midnight to midnight even across a DST change
+static long long BucketStart(long long t, char *bucket, long long secs)
+{
+	time_t tt = t/1000;
+	struct tm tm;
+
+	if (secs>0)
+		return (t/(secs*1000))*secs*1000;
+	localtime_r(&tt,&tm);
+	tm.tm_sec = 0;
+	tm.tm_min = 0;
+	if (!strcmp(bucket,"day"))
+		tm.tm_hour = 0;
+	tm.tm_isdst = -1;
+	return mktime(&tm)*1000LL;
+}
+
+//**************************************************************************
+// start of the bucket after the one starting at t
+static long long BucketNext(long long t, char *bucket, long long secs)
+{
+	time_t tt = t/1000;
+	struct tm tm;
+
+	if (secs>0)
+		return t+secs*1000;
+	localtime_r(&tt,&tm);
+	if (!strcmp(bucket,"day"))
+		tm.tm_mday++;
+	else
+		tm.tm_hour++;
+	tm.tm_isdst = -1;
+	return mktime(&tm)*1000LL;
+}
+
+//**************************************************************************
+// list the metrics in the archive
+static int List(char *dir)
+{
+	DIR *d;
+	struct dirent *e;
+	char name[METRICNAMESZ+8], b1[40], b2[40], b3[20];
+	ARCHCOL c;
+	int len;
+
+	d = opendir(dir);
+	if (d==NULL)
+	{
+		perror(dir);
+		return 1;
+	}
+	printf("%-24s %12s  %-19s  %-19s  %s\n","metric","samples","first","last","bytes/sample");
+	while ((e = readdir(d))!=NULL)
+	{
+		len = strlen(e->d_name);
+		if ((len<5)||(len>=sizeof(name))||strcmp(e->d_name+len-4,".col"))
+			continue;
+		strcpy(name,e->d_name);
+		name[len-4] = 0;
+		if (ArchOpen(&c,dir,name))
+			continue;
+		// what the compressed blocks take, the one being filled is raw
+		if (c.sealed>0)
+			sprintf(b3,"%.2f",(double)(c.off[c.sealed]-c.off[0])/(c.sealed*ARCHBLOCK));
+		else
+			strcpy(b3,"-");
+		if (c.count>0)
+			printf("%-24s %12lld  %s  %s  %s\n",name,c.count,
+					FmtTime(ArchTime(&c,0),b1),FmtTime(ArchTime(&c,c.count-1),b2),b3);
+		ArchClose(&c);
+	}
+	closedir(d);
+	return 0;
+}
+
+//**************************************************************************
+int main(int argc, char *argv[])
+{
+	char		*dir = ARCHIVEDIR, *bucket = "raw";
+	long long	from = -1, to = -1, secs = 0, i, n = 0, t, next;
+	int			c, list = 0;
+	char		buf[40];
+	double		t0;
+	ARCHCOL		col;
+	ARCHAGG		a;
+
+	while ((c = getopt(argc,argv,"d:f:t:b:l"))!=-1)
+	{
+		switch (c)
+		{
+			case 'd':	dir = optarg;				break;
+			case 'f':	from = ParseTime(optarg);	if (from<0) Usage();	break;
+			case 't':	to = ParseTime(optarg);		if (to<0) Usage();		break;
+			case 'b':	bucket = optarg;			break;
+			case 'l':	list = 1;					break;
+			default:	Usage();
+		}
+	}
+	if (list)
+		return List(dir);
+	if (optind!=argc-1)
+		Usage();
+	if (strcmp(bucket,"raw") && strcmp(bucket,"hour") && strcmp(bucket,"day"))
+	{
+		secs = strcmp(bucket,"minute") ? atoll(bucket) : 60;
+		if (secs<=0)
+			Usage();
+	}
+
+	t0 = Ms();
+	if (ArchOpen(&col,dir,argv[optind]))
+	{
+		fprintf(stderr,"no archive for %s in %s\n",argv[optind],dir);
+		return 1;
+	}
+	if (col.count==0)
+		return 0;
+	if (from<0)
+		from = ArchTime(&col,0);
+	if (to<0)
+		to = ArchTime(&col,col.count-1)+1;
+
+	if (!strcmp(bucket,"raw"))
+	{
+		for (i=ArchFind(&col,from); (i<col.count) && ((t = ArchTime(&col,i))<to); i++, n++)
+			printf("%s\t%g\n",FmtTime(t,buf),ArchValue(&col,i));
+	}
+	else
+	{
+		printf("%-19s\t%s\t%s\t%s\t%s\t%s\n","start","count","min","max","mean","sum");
+		for (t=BucketStart(from,bucket,secs); t<to; t=next)
+		{
+			next = BucketNext(t,bucket,secs);
+			// skip straight over gaps in the data
+			i = ArchFind(&col,(t<from)?from:t);
+			if (i>=col.count)
+				break;
+			if (ArchTime(&col,i)>=next)
+			{
+				next = BucketStart(ArchTime(&col,i),bucket,secs);
+				continue;
+			}
+			ArchAggregate(&col,(t<from)?from:t,(next>to)?to:next,&a);
+			if (a.count==0)
+				continue;
+			printf("%s\t%lld\t%g\t%g\t%g\t%g\n",FmtTime(t,buf),a.count,
+					a.min,a.max,a.sum/a.count,a.sum);
+			n++;
+		}
+	}
+	fprintf(stderr,"# %lld rows in %.3f ms\n",n,Ms()-t0);
+	ArchClose(&col);
+	return 0;
+}
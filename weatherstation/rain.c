@@ -0,0 +1,225 @@
+/*---------------------------------------------------------------------------
+   rain.c   rainfall and rain rate from tipping bucket tip times
+	2026-10-17   initial edits
+
+	Tip times are kept for the longest rate window.  Each window has
+	its own tail index that moves forward as tips age out, so adding
+	a tip or asking for the rates is O(1) amortized.  Rates are inches
+	per hour over the last 1, 5 and 15 minutes.  The peak is the
+	highest 1 minute rate seen since the last report, checked at every
+	tip so short bursts in a storm are not averaged away.
+
+	No globals are touched here so the replay tool can use it too.
+
+	2026-10-17   state can be saved to and picked up from a checkpoint
+	2026-10-17   RainReportDay() keeps the daily total, a report that
+	             crosses midnight gives the new day only the tips
+	             after it
+	2026-10-17   RainNext() puts reports on whole minutes, as
+	             WindNext()
+
+---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+#include <math.h>
+
+#include "weatherstation.h"
+
+static const unsigned long long winNs[RAINRATES] = {
+	60*1000000000ULL, 300*1000000000ULL, 900*1000000000ULL };
+
+//**************************************************************************
+// start a new calculation, now is from MonoNs()
+void RainInit(RAINCALC *r, unsigned long long now)
+{
+	memset(r,0,sizeof(RAINCALC));
+	r->start = now;
+}
+
+//**************************************************************************
+// move the window tails past tips older than now
+static void RainAge(RAINCALC *r, unsigned long long now)
+{
+	int k;
+
+	for (k=0; k<RAINRATES; k++)
+	{
+		// a full buffer overwrites the oldest tips
+		if (r->head-r->tail[k]>RAINWIN)
+			r->tail[k] = r->head-RAINWIN;
+		while ((r->tail[k]!=r->head) && 
+			   (now-r->tips[r->tail[k]&(RAINWIN-1)] >= winNs[k]))
+			r->tail[k]++;
+	}
+}
+
+//**************************************************************************
+// rate in inches/hour over window k
+static double RainWinRate(RAINCALC *r, int k)
+{
+	return (r->head-r->tail[k]) * RAIN_PER_TIP * 3600e9 / winNs[k];
+}
+
+//**************************************************************************
+// add one tip, tips must be passed in time order
+void RainTip(RAINCALC *r, unsigned long long t)
+{
+	double x;
+
+	r->tips[r->head&(RAINWIN-1)] = t;
+	r->head++;
+	RainAge(r,t);
+	x = RainWinRate(r,0);
+	if (x>r->peak)
+		r->peak = x;
+	if (r->last!=0)
+		r->period = t-r->last;
+	r->last = t;
+	r->count++;
+}
+
+//**************************************************************************
+// instantaneous rate from the last tip interval, in/hr.  Falls off
+// as time since the last tip grows, 0 once it is 15 minutes.
+double RainNow(RAINCALC *r, unsigned long long now)
+{
+	unsigned long long p;
+
+	if ((r->period==0) || (now-r->last>=winNs[RAINRATES-1]))
+		return 0.0;
+	p = r->period;
+	if (now-r->last>p)
+		p = now-r->last;
+	return RAIN_PER_TIP * 3600e9 / p;
+}
+
+//**************************************************************************
+// rates over 1, 5 and 15 minutes ending now, in/hr
+void RainRates(RAINCALC *r, unsigned long long now, double *rates)
+{
+	int k;
+
+	RainAge(r,now);
+	for (k=0; k<RAINRATES; k++)
+		rates[k] = RainWinRate(r,k);
+}
+
+//**************************************************************************
+// end the report interval, returns rain in inches since the last
+// report and the peak 1 minute rate in that time
+void RainReport(RAINCALC *r, unsigned long long now, double *amount, double *peak)
+{
+	*amount = r->count * RAIN_PER_TIP;
+	*peak = r->peak;
+	r->count = 0;
+	r->peak = 0;
+	r->start = now;
+}
+
+//**************************************************************************
+// when to make the report after the one due at at, on the next whole
+// minute.  t and at are as for WindNext()
+double RainNext(double t, double at)
+{
+	if (fabs(t-at)>=1)
+		at = t;
+	return (floor(at/60)+1)*60;
+}
+
+//**************************************************************************
+// local midnight at the start of the day holding t, unix seconds
+double RainMidnight(double t)
+{
+	time_t tt = (time_t)t;
+	struct tm tm;
+
+	localtime_r(&tt,&tm);
+	tm.tm_sec = tm.tm_min = tm.tm_hour = 0;
+	tm.tm_isdst = -1;
+	return mktime(&tm);
+}
+
+//**************************************************************************
+// RainReport() and add the rain to *today, the total for the day that
+// began at *day.  wall is the report time in unix seconds.  The
+// report that crosses midnight starts the new day with the tips after
+// midnight only, the ones before it went into the old day's total.  A
+// report right at midnight still belongs to the day it ends
+void RainReportDay(RAINCALC *r, unsigned long long now, double wall,
+				   double *amount, double *peak, double *today, double *day)
+{
+	unsigned long long since;
+	unsigned int n;
+	double m;
+
+	m = RainMidnight(wall);
+	if (m==wall)
+		m = RainMidnight(wall-1);
+	if (m==*day)
+	{
+		RainReport(r,now,amount,peak);
+		*today += *amount;
+		return;
+	}
+
+	// tips of this interval newer than midnight, newest first
+	since = ((wall-m)*1e9<now) ? now-(unsigned long long)((wall-m)*1e9) : 0;
+	for (n=0; (n<r->count) && (n<RAINWIN) && (r->tips[(r->head-1-n)&(RAINWIN-1)]>since); n++)
+		;
+	RainReport(r,now,amount,peak);
+	*today = n * RAIN_PER_TIP;
+	*day = m;
+}
+
+//**************************************************************************
+// copy the state into a checkpoint, times become ns before now.  Only
+// the newest CKPTTIPS tips are kept
+//  RETURNS: bytes of ck used
+int RainSave(RAINCALC *r, unsigned long long now, RAINCKPT *ck)
+{
+	unsigned int i, n;
+
+	RainAge(r,now);
+	ck->start = now-r->start;
+	ck->last = (r->last!=0) ? now-r->last : CKPTNONE;
+	ck->period = r->period;
+	ck->count = r->count;
+	ck->peak = r->peak;
+	n = r->head-r->tail[RAINRATES-1];
+	if (n>CKPTTIPS)
+		n = CKPTTIPS;
+	for (i=0; i<n; i++)
+		ck->tips[i] = now-r->tips[(r->head-n+i)&(RAINWIN-1)];
+	ck->ntips = n;
+	return offsetof(RAINCKPT,tips) + n*sizeof(ck->tips[0]);
+}
+
+//**************************************************************************
+// pick up from a checkpoint taken gap ns ago, as WindRestore()
+void RainRestore(RAINCALC *r, unsigned long long now, RAINCKPT *ck, unsigned long long gap)
+{
+	unsigned int i, k;
+	unsigned long long age;
+
+	RainInit(r,now);
+	r->start = now - ((ck->start<now) ? ck->start : now);
+	if ((ck->last!=CKPTNONE) && (ck->last+gap<now))
+	{
+		r->last = now-ck->last-gap;
+		r->period = ck->period;
+	}
+	r->count = ck->count;
+	r->peak = ck->peak;
+	for (i=0; (i<ck->ntips) && (i<CKPTTIPS); i++)
+	{
+		age = ck->tips[i]+gap;
+		if ((age<winNs[RAINRATES-1]) && (age<now))
+			r->tips[r->head++&(RAINWIN-1)] = now-age;
+	}
+	for (k=0; k<RAINRATES; k++)
+		r->tail[k] = 0;
+	RainAge(r,now);
+}
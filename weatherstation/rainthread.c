@@ -3,9 +3,26 @@
          Ted Hale
 	2014-11-27   initial edits
 	2014-12-05   add db update
+	2026-10-17   tips are time stamped by the ISR, rates over 1, 5 and
+	             15 minutes from rain.c.  Thread sleeps between tips.
+	2026-10-17   reports are published in the snapshot
+	2026-10-17   rainToday starts over at midnight, it and the tips
+	             are checkpointed so a restart carries on with them
+	2026-10-17   tips are written to the pulselog files if set
+	2026-10-17   the loop body is RainPoll(), eventloop=1 runs it from
+	             the ISR's eventfd and a reactor.c timer instead
+	2026-10-17   rtprio= and rtsample= from rt.c, edge to ISR latency
+	             in histEdge when the backend times the edge
+	2026-10-17   reports missed in a stall are skipped, the minute
+	             that crosses midnight is split between the days
+	2026-10-17   reports fall on whole minutes from RainNext(), as
+	             replay makes them, and are stamped with that time
 
-	NOTE: to get total rainfall from MySQL
+	NOTE: tables are described in sink_mysql.c
+	to get total rainfall from MySQL
 	select dt,sum(value+0.0) as total from data where name="rainfall"
+	or daily totals from the local archive
+	weatherstation-query -b day rainfall
 	
 ---------------------------------------------------------------------------*/
 
@@ -17,58 +34,249 @@
 #include <signal.h>
 #include <sys/timeb.h>
 #include <pthread.h>
-#include <wiringPi.h>
+#include <semaphore.h>
+#include <time.h>
+#include <stddef.h>
 
 #include "weatherstation.h"
 
-int rainCounter;	// counter for rain guage clicks
+PULSERING rainPulses;	// tip times from rainInterrupt
+static sem_t rainSem;	// posted for each tip
+static PULSELOG rainLog = {"rain",'R'};
+static RAINCALC r;
+static unsigned long long next, lastSave;	// next report, last checkpoint
+static double day;		// midnight rainToday started at
+static double due;		// next report, unix seconds
+static int idRain, idToday, idRate, idRate5, idRate15, idPeak;
+static TIMER rainTimer;	// eventloop=1 only
+static int rainEvent = -1;
 
 //************************************************************************
-// rainInterrupt:  called for rain gauge counter
-void rainInterrupt(void) {
-   rainCounter++;
+// rainInterrupt:  called for rain gauge counter, edge is the time of
+// the edge if the backend knows it, else 0
+void rainInterrupt(unsigned long long edge) {
+   static int rt;
+   unsigned long long now = MonoNs();
+
+   if (!rt)
+      rt = RtThread("rain edge",rtPrio);
+   if (edge)
+      HistAdd(&histEdge, (now>edge) ? now-edge : 0);
+   else
+      edge = now;
+   PulsePut(&rainPulses, edge);
+   if (rainEvent>=0)
+      ReactorSignal(rainEvent);
+   else
+      sem_post(&rainSem);
+}
+
+//************************************************************************
+// save the rain state and today's total
+static void SaveRain(void)
+{
+	RAINCKPT *ck;
+
+	ck = CkptBegin(CKPTRAIN);
+	if (ck==NULL)
+		return;
+	ck->today = rainToday;
+	ck->day = day;
+	CkptEnd(CKPTRAIN,RainSave(&r,MonoNs(),ck));
+}
+
+//************************************************************************
+// wake the thread so it sees kicked without waiting for a tip
+void RainWake(void)
+{
+	if (rainPulses.buf!=NULL)
+		sem_post(&rainSem);
 }
 
 //**************************************************************************
-// Thread entry point, param is not used
-void *rainthread(void *param)
+// set up the tip ring, the ISR and the rain state
+//  RETURNS: 0 for success, 1 on error
+static int RainSetup(void)
 {
-	char tmp[80];
-	time_t now, lastUpdate=0;
-	double rainFall;
+	unsigned long long t, now;
+	double saved, wall;
+	int len;
+	RAINCKPT *ck;
+	
+	idRain = MetricId("rainfall");
+	idToday = MetricId("rainfall_today");
+	idRate = MetricId("rain_rate");
+	idRate5 = MetricId("rain_rate5");
+	idRate15 = MetricId("rain_rate15");
+	idPeak = MetricId("rain_peak");
+
+	// the ring is never freed, the ISR can feed it until the process exits
+	if (rainPulses.buf==NULL)
+	{
+		if (PulseInit(&rainPulses,4096))
+		{
+			Log("rainthread> no memory for tip ring");
+			return 1;
+		}
+		sem_init(&rainSem,0,0);
+	}
 	
 	// set up rain gauge interrupt
-	rainCounter = 0;
-	if ( wiringPiISR (RAIN_PIN, INT_EDGE_FALLING, &rainInterrupt) < 0 ) {
+	if ( hal->gpioEdge (RAIN_PIN, &rainInterrupt) < 0 ) {
 		Log("Unable to setup ISR: %s\n", strerror (errno));
 	}	
 		
-	// start polling loop
-	Log("rainthread> start polling loop.");
-	time(&lastUpdate);
+	now = MonoNs();
+	while (PulseGet(&rainPulses,&t)==0)
+		;
+	RainInit(&r,now);
+	wall = TimeNow();
+	due = RainNext(wall,0);
+	next = now + (due-wall)*1e9;
+
+	// carry on from the last checkpoint, today's total only if it is
+	// still the same day
+	day = RainMidnight(TimeNow());
+	ck = CkptLoad(CKPTRAIN,&len,&saved);
+	if ((ck!=NULL) && (len>=offsetof(RAINCKPT,tips)))
+	{
+		RainRestore(&r,now,ck,(TimeNow()>saved) ? (TimeNow()-saved)*1e9 : 0);
+		if (ck->day==day)
+			rainToday = ck->today;
+		Log("rainthread> checkpoint from %.0f seconds ago, today = %4.2f",
+					TimeNow()-saved,rainToday);
+	}
+	lastSave = now;
+	return 0;
+}
+
+//**************************************************************************
+// take the tips in and report when it is due
+static void RainPoll(void)
+{
+	char tmp[120];
+	unsigned long long t, now;
+	double rainFall, peak, rates[RAINRATES], off, wall;
+	SNAPSHOT *snap;
+
+	now = MonoNs();
+	off = TimeNow()-now/1e9;
+	while (PulseGet(&rainPulses,&t)==0)
+	{
+		HistAdd(&histPulse,(now>t)?now-t:0);
+		RainTip(&r,t);
+		PulseLogPut(&rainLog,pulseLog,off+t/1e9);
+	}
+	PulseLogFlush(&rainLog);
+
+	// report every minute
+	now = MonoNs();
+	if (now>=next)
+	{
+		// the daily total starts over at midnight
+		RainReportDay(&r,now,due,&rainFall,&peak,&rainToday,&day);
+		RainRates(&r,now,rates);
+		rainPeriod = rainFall;
+		rainRate = rates[0];
+		sprintf(tmp,"rainthread> rainFall = %6.3f   today = %4.1f   rate = %5.2f %5.2f %5.2f  peak = %5.2f",
+					rainFall,rainToday,rates[0],rates[1],rates[2],peak);
+		Log(tmp);
+		// update database
+		StoreSample(idRain,rainFall,due);
+		StoreSample(idToday,rainToday,due);
+		StoreSample(idRate,rates[0],due);
+		StoreSample(idRate5,rates[1],due);
+		StoreSample(idRate15,rates[2],due);
+		StoreSample(idPeak,peak,due);
+		snap = SnapBegin();
+		snap->rainPeriod = rainPeriod;
+		snap->rainToday = rainToday;
+		snap->rainRate = rates[0];
+		snap->rainRate5 = rates[1];
+		snap->rainRate15 = rates[2];
+		snap->rainTime = TimeNow();
+		SnapEnd();
+		// skip the reports a stall made us miss
+		wall = TimeNow();
+		now = MonoNs();
+		due = RainNext(wall,due);
+		next = now + (due-wall)*1e9;
+	}
+	if (CkptDue(&lastSave))
+		SaveRain();
+}
+
+//**************************************************************************
+// Thread entry point, param is not used
+void *rainthread(void *param)
+{
+	struct timespec ts;
+	unsigned long long t, now;
+
+	RtThread("rainthread",rtSample);
+	if (RainSetup())
+		return 0;
+
+	// start event loop
+	Log("rainthread> start event loop.");
     do
     {
-		time(&now);
-		// check count every minute
-		if ((now-lastUpdate)>=60)
+		// sleep until a tip comes in or the next report is due
+		now = MonoNs();
+		if (next>now)
 		{
-			// process data
-			rainFall = rainCounter*0.000045;
-			rainToday += rainFall;
-			sprintf(tmp,"rainthread> rainFall = %6.3f   today = %4.1f",rainFall,rainToday);
-			Log(tmp);
-			rainCounter = 0;
-			// update database
-			sprintf(tmp,"%f",rainFall);
-			StoreToDB("rainfall",tmp);;
-			sprintf(tmp,"%f",rainToday);
-			StoreToDB("rainfall_today",tmp);
-			lastUpdate = now;
+			clock_gettime(CLOCK_REALTIME,&ts);
+			t = ts.tv_nsec + (next-now);
+			ts.tv_sec += t/1000000000ULL;
+			ts.tv_nsec = t%1000000000ULL;
+			sem_timedwait(&rainSem,&ts);
 		}
-		// let other threads run
-		Sleep(5);
+		RainPoll();
 	} while (kicked==0);  // exit loop if flag set
 	
+	SaveRain();
 	Log("rainthread> thread exiting");
 	return 0;
 }
+
+//**************************************************************************
+// eventloop=1: a tip or the report, whichever comes first
+static void RainEvent(void *arg)
+{
+	RainPoll();
+	TimerAt(&rainTimer,next);
+}
+
+//**************************************************************************
+static void RainDue(TIMER *t)
+{
+	RainEvent(NULL);
+}
+
+//**************************************************************************
+// start the rain code on the reactor.c thread
+//  RETURNS: 0 for success, 1 on error
+int RainStart(void)
+{
+	if (RainSetup())
+		return 1;
+	rainEvent = ReactorEvent(RainEvent,NULL);
+	if (rainEvent<0)
+	{
+		Log("rainthread> no event for the ISR");
+		return 1;
+	}
+	TimerInit(&rainTimer,RainDue,NULL);
+	TimerAt(&rainTimer,next);
+	Log("rainthread> started on the event loop.");
+	return 0;
+}
+
+//**************************************************************************
+// the event loop has stopped, save the state
+void RainStop(void)
+{
+	TimerCancel(&rainTimer);
+	SaveRain();
+	Log("rainthread> stopped");
+}
@@ -0,0 +1,374 @@
+/*---------------------------------------------------------------------------
+   reactor.c   one thread that runs timers and events, eventloop=1
+	2026-10-17   initial edits
+
+	With eventloop=1 the wind, rain and sensor code and the heartbeat
+	run on the main thread instead of each having its own thread
+	waking up to look at the clock.  Everything they wait for is a
+	TIMER or an eventfd, and the thread sleeps in epoll_wait() until
+	the first of them.
+
+	Timers are kept in a hierarchical wheel of 1 ms ticks, four levels
+	of 64 slots each, so adding, moving and cancelling a timer is a
+	list insert or remove however many there are.  Level 0 holds
+	timers due in the next 64 ms, one slot per tick, level 1 the next
+	4 seconds in 64 ms slots, level 2 the next 4 minutes and level 3
+	about the next 4.6 hours.  When level 0 wraps, the level 1 slot
+	now due is emptied back into the wheel, and so on up, the same
+	as the old Linux timer wheel.  Anything further off sits in the
+	last level 3 slot and is put back until it fits.
+
+	One timerfd is set for the first tick with anything to do: the
+	first busy level 0 slot, or the first time a busy slot further
+	up is due to come down.  Time that passes with nothing due is
+	skipped in one step, so a quiet station only wakes when it has
+	work.
+
+	ReactorEvent() gives an eventfd that runs a function on the
+	reactor thread when ReactorSignal() is called on it, from any
+	thread or an interrupt handler.  ReactorWake() just gets the loop
+	to look at kicked.  ReactorWatch() runs a function whenever some
+	other fd is readable, it does its own reading.  Timers are only
+	set and cancelled on the reactor thread, from its callbacks or
+	before ReactorRun().
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "weatherstation.h"
+
+#define WHEELBITS		6
+#define WHEELSIZE		(1<<WHEELBITS)
+#define WHEELMASK		(WHEELSIZE-1)
+#define WHEELLEVELS		4
+#define WHEELSPAN		(1ULL<<(WHEELBITS*WHEELLEVELS))	// ticks the wheel holds
+#define TICKNS			1000000ULL		// 1 ms
+#define MAXEVENTS		8
+
+// an fd and what to run when it is readable
+typedef struct {
+	int		fd;
+	int		counter;					// an eventfd, read it before fn
+	void	(*fn)(void *arg);
+	void	*arg;
+} REACTORFD;
+
+static TIMER			wheel[WHEELLEVELS][WHEELSIZE];	// list heads
+static unsigned long long	tick;			// next tick to run
+static int				epfd = -1;
+static int				tfd = -1;
+static int				wakefd = -1;
+static REACTORFD		fds[MAXEVENTS];
+static int				nfds;
+static REACTORSTATS		stats;
+
+//**************************************************************************
+// the slot a timer due at exp goes in
+static TIMER *Slot(unsigned long long exp)
+{
+	unsigned long long d;
+	int l;
+
+	if (exp<tick)
+		exp = tick;
+	d = exp-tick;
+	if (d>=WHEELSPAN)
+		exp = tick+WHEELSPAN-1;
+	for (l=0; l<WHEELLEVELS-1; l++)
+		if (d<(1ULL<<(WHEELBITS*(l+1))))
+			break;
+	return &wheel[l][(exp>>(WHEELBITS*l))&WHEELMASK];
+}
+
+//**************************************************************************
+// put a timer on a list
+static void Link(TIMER *head, TIMER *t)
+{
+	t->next = head->next;
+	t->prev = head;
+	head->next->prev = t;
+	head->next = t;
+}
+
+//**************************************************************************
+// take a timer off its list, if it is on one
+static void Unlink(TIMER *t)
+{
+	if (t->next==NULL)
+		return;
+	t->next->prev = t->prev;
+	t->prev->next = t->next;
+	t->next = t->prev = NULL;
+}
+
+//**************************************************************************
+// put the timers in a slot of a higher level back in the wheel, they
+// land lower down now that they are closer
+//  RETURNS: the slot index, 0 when the level above is due as well
+static int Cascade(int level)
+{
+	int i = (tick>>(WHEELBITS*level))&WHEELMASK;
+	TIMER *head = &wheel[level][i], *t;
+
+	while ((t = head->next)!=head)
+	{
+		Unlink(t);
+		Link(Slot((t->when+TICKNS-1)/TICKNS),t);
+	}
+	return i;
+}
+
+//**************************************************************************
+// the first tick at or after tick with something to do
+//  RETURNS: the tick, 0 if the wheel is empty
+static unsigned long long NextTick(void)
+{
+	unsigned long long best = 0, b;
+	int l, j, shift;
+
+	for (j=0; j<WHEELSIZE; j++)
+		if (wheel[0][(tick+j)&WHEELMASK].next!=&wheel[0][(tick+j)&WHEELMASK])
+		{
+			best = tick+j;
+			break;
+		}
+	// or the first boundary before it where a busy slot comes down
+	for (l=1; l<WHEELLEVELS; l++)
+	{
+		shift = WHEELBITS*l;
+		for (j=0; j<WHEELSIZE; j++)
+		{
+			b = (((tick+(1ULL<<shift)-1)>>shift)+j)<<shift;
+			if (wheel[l][(b>>shift)&WHEELMASK].next!=&wheel[l][(b>>shift)&WHEELMASK])
+			{
+				if ((best==0) || (b<best))
+					best = b;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+//**************************************************************************
+// run the timers due up to and including tick now
+static void Expire(unsigned long long now)
+{
+	unsigned long long next;
+	TIMER *head, *t;
+	int i, l;
+
+	while (tick<=now)
+	{
+		// nothing to do before the next busy tick, go straight there
+		next = NextTick();
+		if ((next==0) || (next>now))
+		{
+			tick = now+1;
+			break;
+		}
+		tick = next;
+		i = tick&WHEELMASK;
+		for (l=1; (i==0) && (l<WHEELLEVELS); l++)
+			i = Cascade(l);
+		head = &wheel[0][tick&WHEELMASK];
+		while ((t = head->next)!=head)
+		{
+			Unlink(t);
+			stats.timers++;
+			t->fn(t);
+		}
+		tick++;
+	}
+}
+
+//**************************************************************************
+// set the timerfd for the next tick with work, or stop it
+static void Arm(void)
+{
+	struct itimerspec its;
+	unsigned long long next = NextTick(), ns;
+
+	memset(&its,0,sizeof(its));
+	if (next!=0)
+	{
+		ns = next*TICKNS;
+		its.it_value.tv_sec = ns/1000000000ULL;
+		its.it_value.tv_nsec = ns%1000000000ULL;
+		if ((its.it_value.tv_sec==0) && (its.it_value.tv_nsec==0))
+			its.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(tfd,TFD_TIMER_ABSTIME,&its,NULL);
+}
+
+//**************************************************************************
+// set up the wheel, the epoll set and the wakeup eventfd
+//  RETURNS: 0 for success, 1 on error
+int ReactorInit(void)
+{
+	struct epoll_event ev;
+	int l, i;
+
+	for (l=0; l<WHEELLEVELS; l++)
+		for (i=0; i<WHEELSIZE; i++)
+			wheel[l][i].next = wheel[l][i].prev = &wheel[l][i];
+	tick = MonoNs()/TICKNS;
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	tfd = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC);
+	wakefd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if ((epfd<0) || (tfd<0) || (wakefd<0))
+	{
+		Log("reactor> setup failed: %s",strerror(errno));
+		return 1;
+	}
+	memset(&ev,0,sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd,EPOLL_CTL_ADD,tfd,&ev);
+	ReactorEvent(NULL,NULL);			// fds[0] is the wakeup
+	return 0;
+}
+
+//**************************************************************************
+// add fd to the epoll set
+//  RETURNS: 0 for success, 1 on error
+static int Watch(int fd, int counter, void (*fn)(void *arg), void *arg)
+{
+	struct epoll_event ev;
+	REACTORFD *r;
+
+	if (nfds>=MAXEVENTS)
+		return 1;
+	r = &fds[nfds];
+	r->fd = fd;
+	r->counter = counter;
+	r->fn = fn;
+	r->arg = arg;
+	memset(&ev,0,sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = r;
+	if (epoll_ctl(epfd,EPOLL_CTL_ADD,fd,&ev))
+		return 1;
+	nfds++;
+	return 0;
+}
+
+//**************************************************************************
+// an eventfd that runs fn(arg) on the reactor thread when signalled
+//  RETURNS: the eventfd for ReactorSignal(), -1 on error
+int ReactorEvent(void (*fn)(void *arg), void *arg)
+{
+	int fd;
+
+	fd = (fn==NULL) ? wakefd : eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if (fd<0)
+		return -1;
+	if (Watch(fd,1,fn,arg))
+	{
+		if (fd!=wakefd)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//**************************************************************************
+// run fn(arg) on the reactor thread whenever fd is readable, fn reads
+// it.  Use a non-blocking fd, fn is run again while data is left
+//  RETURNS: 0 for success, 1 on error
+int ReactorWatch(int fd, void (*fn)(void *arg), void *arg)
+{
+	return Watch(fd,0,fn,arg);
+}
+
+//**************************************************************************
+// signal an eventfd from ReactorEvent(), safe in a signal handler
+void ReactorSignal(int fd)
+{
+	uint64_t one = 1;
+
+	if (fd>=0)
+		write(fd,&one,sizeof(one));
+}
+
+//**************************************************************************
+// get the loop to look at kicked, safe in a signal handler
+void ReactorWake(void)
+{
+	ReactorSignal(wakefd);
+}
+
+//**************************************************************************
+// set up a timer, it does nothing until TimerAt()
+void TimerInit(TIMER *t, void (*fn)(TIMER *t), void *arg)
+{
+	memset(t,0,sizeof(TIMER));
+	t->fn = fn;
+	t->arg = arg;
+}
+
+//**************************************************************************
+// run t->fn at MonoNs() time when, moving it if it was already set
+void TimerAt(TIMER *t, unsigned long long when)
+{
+	Unlink(t);
+	t->when = when;
+	Link(Slot((when+TICKNS-1)/TICKNS),t);
+}
+
+//**************************************************************************
+// stop a timer that has not run yet
+void TimerCancel(TIMER *t)
+{
+	Unlink(t);
+}
+
+//**************************************************************************
+// run timers and events until kicked is set
+void ReactorRun(void)
+{
+	struct epoll_event ev[MAXEVENTS+1];
+	REACTORFD *r;
+	uint64_t n;
+	int i, k;
+
+	Log("reactor> start event loop.");
+	while (kicked==0)
+	{
+		Arm();
+		k = epoll_wait(epfd,ev,MAXEVENTS+1,-1);
+		stats.wakeups++;
+		for (i=0; i<k; i++)
+		{
+			r = ev[i].data.ptr;
+			if (r==NULL)
+			{
+				read(tfd,&n,sizeof(n));
+				continue;
+			}
+			if (r->counter)
+				read(r->fd,&n,sizeof(n));
+			stats.events++;
+			if (r->fn!=NULL)
+				r->fn(r->arg);
+		}
+		// run what is due, timers are never run early
+		Expire(MonoNs()/TICKNS);
+	}
+	Log("reactor> event loop exiting");
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void ReactorGetStats(REACTORSTATS *out)
+{
+	memcpy(out,&stats,sizeof(REACTORSTATS));
+}
@@ -0,0 +1,666 @@
+/*---------------------------------------------------------------------------
+   replay.c   run recorded readings and pulses through the station again
+	2026-10-17   initial edits
+
+	usage: weatherstation-replay [-c conffile] [-a archivedir] [-f from]
+	           [-t to] [-j jobs] [-G secs] [-A outdir] [file ...]
+	  file  lines of "<unix seconds> W" for an anemometer pulse,
+	        "<unix seconds> R" for a rain gauge tip or "<unix seconds>
+	        <metric> <value>" for a sensor reading, in time order.  The
+	        pulselog= files are written this way
+	  -a  also the sensor readings kept in a column archive.  Its wind
+	      and rain metrics are what the replay makes, so they are left out
+	  -f, -t  time range as for weatherstation-query, default everything
+	  -j  split the range into runs of whole days, one process each
+	  -G  a gap this many seconds long with nothing from any input is
+	      taken as the station being down.  Wind and rain start over
+	      after it instead of reporting calm all through it
+	  -A  write what is stored to a new column archive there as well,
+	      one job only
+
+	Readings go through filter.c, pulses through wind.c and rain.c and
+	are reported the way anemometerthread and rainthread do, then
+	everything is queued with StoreSample() and StoreRaw() and taken
+	off with DbDrain(), so the rollups, minute means and every sink in
+	the config see what they would in the daemon.  Nothing is spooled.
+	There are no sleeps, the clock is the time of the next input.
+
+	Wind reports fall on whole multiples of windreport seconds and rain
+	reports on whole minutes, from WindNext() and RainNext() as in the
+	daemon, so what a day gives does not depend on where the run
+	began.  A run starts WARMSECS before -f, or a minute before the
+	midnight before it if that is earlier, to fill the gust window,
+	rain rates, rain today and the filter windows, and only stores and
+	counts what falls in its own range.  Each -j job does the same for
+	its own days, so the output is the same as one job but reaches the
+	sinks in no particular order.
+
+	make check replays test/replay.txt, pulses and readings either side
+	of midnight, with one job and with two and compares the sorted csv
+	with test/replay.expected.  After a change that is meant to alter
+	the output, make golden writes it again.
+
+	A summary is printed as JSON when it is done.
+
+---------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE			// strptime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define EXTERN
+#include "weatherstation.h"
+
+#define MAXSOURCES	(MAXMETRICS+64)
+#define MAXJOBS		64
+#define WARMSECS	(16*60)			// longest rain rate window and a bit
+#define SEEKCHUNK	4096			// bisect a file down to this many bytes
+
+// metrics the replay makes, not read back from the archive
+static char *made[] = {"wind_speed","wind_gust","rainfall","rainfall_today",
+					   "rain_rate","rain_rate5","rain_rate15","rain_peak",NULL};
+
+// one input, with its next event
+typedef struct {
+	char		*fname;				// file, or NULL for an archive column
+	FILE		*f;
+	ARCHCOL		col;
+	long long	i;					// next sample in col
+	int			done;
+	double		t;					// the next event, unix seconds
+	char		type;				// W, R, or V for a reading
+	int			metric;
+	double		v;
+} SOURCE;
+
+// what a job did, summed over the jobs at the end
+typedef struct {
+	unsigned long	events;
+	unsigned long	pulses;
+	unsigned long	tips;
+	unsigned long	readings;
+	unsigned long	rejected[FILTERRATE+1];	// by filter.c, by reason
+	unsigned long	bad;				// lines that could not be read
+	unsigned long	older;				// out of order in their file
+	unsigned long	gaps;				// restarts after -G
+	unsigned long	stored;				// samples through DbDrain()
+	int				nsinks;
+	unsigned long	written[MAXSINKS];
+	unsigned long	dropped[MAXSINKS];
+	unsigned long	errors[MAXSINKS];
+} REPLAYSTATS;
+
+static SOURCE		src[MAXSOURCES];
+static int			nsrc;
+static char			*archDir;
+static char			*outDir;
+static double		gapSecs;
+static REPLAYSTATS	stats;
+static double		lo[MAXMETRICS], hi[MAXMETRICS];
+static char			limits[MAXMETRICS];		// lo and hi looked up
+
+//**************************************************************************
+// a time as -f and -t take it, see weatherstation-query
+//  RETURNS: unix seconds, -1 if it can not be read
+static double ParseTime(char *s)
+{
+	struct tm tm;
+	char *p;
+
+	memset(&tm,0,sizeof(tm));
+	p = strptime(s,"%Y-%m-%d",&tm);
+	if (p!=NULL)
+	{
+		if ((*p!=0) && (strptime(p," %H:%M:%S",&tm)==NULL) &&
+			(strptime(p," %H:%M",&tm)==NULL))
+			return -1;
+		tm.tm_isdst = -1;
+		return mktime(&tm);
+	}
+	if (strspn(s,"0123456789.")!=strlen(s))
+		return -1;
+	return atof(s);
+}
+
+//**************************************************************************
+// local midnight at the start of the day after the one holding t.  A
+// day and a half after the first is in the next day even when the
+// clocks change
+static double NextMidnight(double t)
+{
+	return RainMidnight(RainMidnight(t)+36*3600);
+}
+
+//**************************************************************************
+// time as the wind and rain code takes it
+static unsigned long long Ns(double t)
+{
+	return (unsigned long long)llround(t*1e9);
+}
+
+//**************************************************************************
+// read one line of a file
+//  RETURNS: 0 for an event, 1 at the end
+static int ReadLine(SOURCE *s)
+{
+	char line[200], name[METRICNAMESZ];
+	double t, v;
+	int n;
+
+	while (fgets(line,sizeof(line),s->f)!=NULL)
+	{
+		if ((line[0]=='#') || (line[0]=='\n'))
+			continue;
+		n = sscanf(line,"%lf %31s %lf",&t,name,&v);
+		if ((n==2) && ((name[0]=='W') || (name[0]=='R')) && (name[1]==0))
+			s->type = name[0];
+		else if ((n==3) && ((s->metric = MetricId(name))>=0))
+		{
+			s->type = 'V';
+			s->v = v;
+		}
+		else
+		{
+			stats.bad++;
+			continue;
+		}
+		s->t = t;
+		return 0;
+	}
+	return 1;
+}
+
+//**************************************************************************
+// skip what is left of a line after a seek
+static void SkipLine(FILE *f)
+{
+	int c;
+
+	while (((c = getc(f))!=EOF) && (c!='\n'))
+		;
+}
+
+//**************************************************************************
+// move on to the next event of a source, skipping any out of order
+static void Next(SOURCE *s)
+{
+	double last = s->t;
+
+	for (;;)
+	{
+		if (s->fname!=NULL)
+		{
+			if (ReadLine(s))
+				break;
+		}
+		else
+		{
+			if (s->i>=s->col.count)
+				break;
+			s->t = ArchTime(&s->col,s->i)/1000.0;
+			s->v = ArchValue(&s->col,s->i);
+			s->i++;
+		}
+		if (s->t>=last)
+			return;
+		stats.older++;
+	}
+	s->done = 1;
+}
+
+//**************************************************************************
+// the first and last times in a source
+static void Range(SOURCE *s, double *first, double *last)
+{
+	struct stat st;
+
+	*first = *last = -1;
+	if (s->fname==NULL)
+	{
+		if (s->col.count>0)
+		{
+			*first = ArchTime(&s->col,0)/1000.0;
+			*last = ArchTime(&s->col,s->col.count-1)/1000.0;
+		}
+		return;
+	}
+	rewind(s->f);
+	if (ReadLine(s))
+		return;
+	*first = *last = s->t;
+	fstat(fileno(s->f),&st);
+	if (st.st_size>SEEKCHUNK)
+	{
+		fseek(s->f,st.st_size-SEEKCHUNK,SEEK_SET);
+		SkipLine(s->f);
+	}
+	while (!ReadLine(s))
+		*last = s->t;
+}
+
+//**************************************************************************
+// position a source at its first event at or after t.  A file is cut
+// in half until what is left is small, then read through
+static void Seek(SOURCE *s, double t)
+{
+	struct stat st;
+	long a, b, m;
+
+	s->done = 0;
+	s->t = -HUGE_VAL;
+	if (s->fname==NULL)
+	{
+		s->i = ArchFind(&s->col,(long long)floor(t*1000));
+		Next(s);
+		return;
+	}
+	fstat(fileno(s->f),&st);
+	a = 0;
+	b = st.st_size;
+	while (b-a>SEEKCHUNK)
+	{
+		m = a+(b-a)/2;
+		fseek(s->f,m,SEEK_SET);
+		SkipLine(s->f);
+		if (ReadLine(s) || (s->t>=t))
+			b = m;
+		else
+			a = m;
+	}
+	fseek(s->f,a,SEEK_SET);
+	if (a>0)
+		SkipLine(s->f);
+	s->t = -HUGE_VAL;
+	do
+		Next(s);
+	while (!s->done && (s->t<t));
+}
+
+//**************************************************************************
+// open the inputs
+//  RETURNS: 0 for success, 1 on error
+static int OpenSources(char **files, int nfiles)
+{
+	char name[METRICNAMESZ+8];
+	struct dirent **list;
+	int i, k, n, len;
+
+	nsrc = 0;
+	for (i=0; i<nfiles; i++)
+	{
+		src[nsrc].fname = files[i];
+		src[nsrc].f = fopen(files[i],"r");
+		if (src[nsrc].f==NULL)
+		{
+			perror(files[i]);
+			return 1;
+		}
+		nsrc++;
+	}
+	if (archDir==NULL)
+		return 0;
+	n = scandir(archDir,&list,NULL,alphasort);
+	if (n<0)
+	{
+		perror(archDir);
+		return 1;
+	}
+	for (i=0; i<n; i++)
+	{
+		len = strlen(list[i]->d_name);
+		if ((len>4) && (len<sizeof(name)) && !strcmp(list[i]->d_name+len-4,".col") &&
+			(nsrc<MAXSOURCES))
+		{
+			strcpy(name,list[i]->d_name);
+			name[len-4] = 0;
+			for (k=0; (made[k]!=NULL) && strcmp(made[k],name); k++)
+				;
+			if ((made[k]==NULL) && !ArchOpen(&src[nsrc].col,archDir,name))
+			{
+				src[nsrc].type = 'V';
+				src[nsrc].metric = MetricId(name);
+				if (src[nsrc].metric>=0)
+					nsrc++;
+				else
+					ArchClose(&src[nsrc].col);
+			}
+		}
+		free(list[i]);
+	}
+	free(list);
+	return 0;
+}
+
+//**************************************************************************
+// a reading, checked as the sensor scheduler does
+static void Reading(int m, double v, double t, int store)
+{
+	int why;
+
+	if (!limits[m])
+	{
+		if (SensorLimits(m,&lo[m],&hi[m]))
+		{
+			lo[m] = -HUGE_VAL;
+			hi[m] = HUGE_VAL;
+		}
+		limits[m] = 1;
+	}
+	why = FilterCheck(m,v,t,lo[m],hi[m]);
+	if (!store)
+		return;
+	stats.readings++;
+	if (why)
+		stats.rejected[why]++;
+	else
+		StoreRaw(m,v,t);
+}
+
+//**************************************************************************
+// hand what is queued on, and close the rollup periods that are done
+static void Drain(double now)
+{
+	stats.stored += DbDrain();
+	RollupTick(now,0);
+}
+
+//**************************************************************************
+// replay from up to to, starting early enough to be warmed up.  Only
+// what falls in from..to is stored
+static void Run(double from, double to)
+{
+	WINDCALC w;
+	RAINCALC r;
+	SOURCE *s;
+	SINK *sinks[MAXSINKS];
+	double t, start, last = 0, nextWind = 0, nextRain = 0, day = 0, today = 0;
+	double speed, gust, fall, peak, rates[RAINRATES];
+	int i, n, queued = 0, started = 0;
+	int idSpeed, idGust, idRain, idToday, idRate, idRate5, idRate15, idPeak;
+
+	idSpeed = MetricId("wind_speed");
+	idGust = MetricId("wind_gust");
+	idRain = MetricId("rainfall");
+	idToday = MetricId("rainfall_today");
+	idRate = MetricId("rain_rate");
+	idRate5 = MetricId("rain_rate5");
+	idRate15 = MetricId("rain_rate15");
+	idPeak = MetricId("rain_peak");
+
+	// every sink holds the others up rather than drop
+	DbQueueInit();
+	n = SinkList(sinks,MAXSINKS);
+	for (i=0; i<n; i++)
+	{
+		sinks[i]->block = 1;
+		sinks[i]->blockWait = 0;
+	}
+	if (outDir!=NULL)
+		ArchiveInit(outDir);
+	SinkStart();
+
+	start = from-WARMSECS-windReport;
+	// the report at midnight holds the minute before it
+	if (RainMidnight(from)-60<start)
+		start = RainMidnight(from)-60;
+	for (i=0; i<nsrc; i++)
+		Seek(&src[i],start);
+	for (;;)
+	{
+		// the input with the earliest event
+		s = NULL;
+		for (i=0; i<nsrc; i++)
+			if (!src[i].done && ((s==NULL) || (src[i].t<s->t)))
+				s = &src[i];
+		if ((s==NULL) || (s->t>=to))
+			break;
+		t = s->t;
+
+		// start over at the first event or after a gap, otherwise
+		// make the reports that fall before this event
+		if (!started || ((gapSecs>0) && (t-last>=gapSecs)))
+		{
+			if (started)
+				stats.gaps++;
+			WindInit(&w,Ns(t));
+			RainInit(&r,Ns(t));
+			nextWind = WindNext(t,0,windReport);
+			nextRain = RainNext(t,0);
+			if (!started || (RainMidnight(t)!=day))
+				today = 0;
+			day = RainMidnight(t);
+			started = 1;
+		}
+		while (nextWind<=t)
+		{
+			WindReport(&w,Ns(nextWind),&speed,&gust);
+			if (nextWind>=from)
+			{
+				StoreSample(idSpeed,speed,nextWind);
+				StoreSample(idGust,gust,nextWind);
+				queued += 2;
+			}
+			nextWind = WindNext(nextWind,nextWind,windReport);
+		}
+		while (nextRain<=t)
+		{
+			RainReportDay(&r,Ns(nextRain),nextRain,&fall,&peak,&today,&day);
+			RainRates(&r,Ns(nextRain),rates);
+			if (nextRain>=from)
+			{
+				StoreSample(idRain,fall,nextRain);
+				StoreSample(idToday,today,nextRain);
+				StoreSample(idRate,rates[0],nextRain);
+				StoreSample(idRate5,rates[1],nextRain);
+				StoreSample(idRate15,rates[2],nextRain);
+				StoreSample(idPeak,peak,nextRain);
+				queued += 6;
+			}
+			nextRain = RainNext(nextRain,nextRain);
+		}
+
+		// only what is in our own range is counted
+		switch (s->type)
+		{
+			case 'W':	WindPulse(&w,Ns(t));	stats.pulses += (t>=from);	break;
+			case 'R':	RainTip(&r,Ns(t));		stats.tips += (t>=from);	break;
+			default:
+				Reading(s->metric,s->v,t,t>=from);
+				queued += (t>=from);
+				break;
+		}
+		stats.events += (t>=from);
+		last = t;
+		if (queued>=dbbatch)
+		{
+			Drain(t);
+			queued = 0;
+		}
+		Next(s);
+	}
+
+	// close what is still open and let the sinks finish
+	Drain(last);
+	RollupTick(last,1);
+	stats.stored += DbDrain();
+	SinkStop();
+	ArchiveClose();
+	n = SinkList(sinks,MAXSINKS);
+	stats.nsinks = n;
+	for (i=0; i<n; i++)
+	{
+		stats.written[i] = sinks[i]->stats.written;
+		stats.dropped[i] = sinks[i]->stats.dropped;
+		stats.errors[i] = sinks[i]->stats.errors;
+	}
+}
+
+//**************************************************************************
+static void Usage(void)
+{
+	fprintf(stderr,"usage: weatherstation-replay [-c conffile] [-a archivedir] [-f from] [-t to]\n"
+				   "          [-j jobs] [-G secs] [-A outdir] [file ...]\n");
+	exit(1);
+}
+
+//**************************************************************************
+int main(int argc, char *argv[])
+{
+	REPLAYSTATS one;
+	char *names[MAXSINKS];
+	double from = -1, to = -1, first, last, a, b, start[MAXJOBS+1];
+	unsigned long long t0;
+	pid_t pid[MAXJOBS];
+	int c, i, k, n, jobs = 1, days, per, fd[MAXJOBS][2];
+
+	while ((c = getopt(argc,argv,"c:a:f:t:j:G:A:"))!=-1)
+	{
+		switch (c)
+		{
+			case 'c':	strncpy(confFile,optarg,sizeof(confFile)-1);	break;
+			case 'a':	archDir = optarg;		break;
+			case 'f':	from = ParseTime(optarg);	if (from<0) Usage();	break;
+			case 't':	to = ParseTime(optarg);		if (to<0) Usage();		break;
+			case 'j':	jobs = atoi(optarg);	break;
+			case 'G':	gapSecs = atof(optarg);	break;
+			case 'A':	outDir = optarg;		break;
+			default:	Usage();
+		}
+	}
+	if ((jobs<1) || (jobs>MAXJOBS) || ((optind>=argc) && (archDir==NULL)) ||
+		((jobs>1) && (outDir!=NULL)))
+		Usage();
+
+	LogOpen("/tmp/weatherstation-replay");
+
+	// settings as the daemon reads them, with room for a fast run.
+	// Nothing is spooled, the daemon's spool is not ours
+	if (ConfigLoad(confFile[0] ? confFile : "/etc/weatherstation.conf"))
+		Log("replay> no config file, using the defaults");
+	windReport = ConfigInt("windreport",120,10,86400);
+	dbflush = ConfigInt("dbflush",10,1,3600);
+	ConfigCopy("dbtype","mysql",dbtype,sizeof(dbtype));
+	ConfigCopy("database","weather",dbdatabase,sizeof(dbdatabase));
+	ConfigCopy("dbhost","localhost",dbhost,sizeof(dbhost));
+	ConfigCopy("dbuser","ted",dbuser,sizeof(dbuser));
+	ConfigCopy("dbpass","secret",dbpass,sizeof(dbpass));
+	dbbatch = 1000;
+	dbqsize = 65536;
+	spooldir[0] = 0;
+
+	if (OpenSources(argv+optind,argc-optind))
+		return 1;
+
+	// the whole range, from the inputs where it was not given
+	if ((from<0) || (to<0))
+	{
+		a = HUGE_VAL;
+		b = -HUGE_VAL;
+		for (i=0; i<nsrc; i++)
+		{
+			Range(&src[i],&first,&last);
+			if ((first>=0) && (first<a)) a = first;
+			if (last>b) b = last;
+		}
+		if (from<0) from = (a<HUGE_VAL) ? a : 0;
+		if (to<0) to = b+1;
+	}
+
+	// whole days for each job
+	days = 0;
+	for (a=RainMidnight(from); a<to; a=NextMidnight(a))
+		days++;
+	if (jobs>days)
+		jobs = (days>0) ? days : 1;
+	per = (days+jobs-1)/jobs;
+	jobs = (days+per-1)/per;
+	if (jobs<1)
+		jobs = 1;
+	a = RainMidnight(from);
+	for (k=0; k<jobs; k++)
+	{
+		start[k] = (k==0) ? from : a;
+		for (i=0; i<per; i++)
+			a = NextMidnight(a);
+	}
+	start[jobs] = to;
+	Log("replay> %d inputs, %d days in %d jobs",nsrc,days,jobs);
+
+	t0 = MonoNs();
+	if (jobs==1)
+		Run(from,to);
+	else
+	{
+		fflush(NULL);
+		for (k=0; k<jobs; k++)
+		{
+			if (pipe(fd[k]))
+				return 1;
+			pid[k] = fork();
+			if (pid[k]==0)
+			{
+				close(fd[k][0]);
+				// an inherited FILE shares its offset with the other jobs
+				for (i=0; i<nsrc; i++)
+					if ((src[i].fname!=NULL) &&
+						((src[i].f = freopen(src[i].fname,"r",src[i].f))==NULL))
+						_exit(1);
+				Run(start[k],(start[k+1]<to) ? start[k+1] : to);
+				_exit(write(fd[k][1],&stats,sizeof(stats))!=sizeof(stats));
+			}
+			close(fd[k][1]);
+		}
+		for (k=0; k<jobs; k++)
+		{
+			if (read(fd[k][0],&one,sizeof(one))!=sizeof(one))
+			{
+				fprintf(stderr,"job %d failed\n",k);
+				memset(&one,0,sizeof(one));
+			}
+			close(fd[k][0]);
+			waitpid(pid[k],NULL,0);
+			stats.events += one.events;
+			stats.pulses += one.pulses;
+			stats.tips += one.tips;
+			stats.readings += one.readings;
+			for (i=0; i<=FILTERRATE; i++)
+				stats.rejected[i] += one.rejected[i];
+			stats.bad += one.bad;
+			stats.older += one.older;
+			stats.gaps += one.gaps;
+			stats.stored += one.stored;
+			stats.nsinks = one.nsinks;
+			for (i=0; i<one.nsinks; i++)
+			{
+				stats.written[i] += one.written[i];
+				stats.dropped[i] += one.dropped[i];
+				stats.errors[i] += one.errors[i];
+			}
+		}
+	}
+	a = (MonoNs()-t0)/1e9;
+
+	// the sinks by name, in the order SinkInit() makes them
+	n = ConfigSections("sink.",names,MAXSINKS);
+	printf("{\"from\":%.3f,\"to\":%.3f,\"jobs\":%d,\"elapsed_s\":%.3f,\"events_per_sec\":%.0f,\n",
+		   from,to,jobs,a,(a>0) ? stats.events/a : 0.0);
+	printf(" \"events\":%lu,\"wind_pulses\":%lu,\"rain_tips\":%lu,\"readings\":%lu,"
+		   "\"bad_lines\":%lu,\"out_of_order\":%lu,\"gaps\":%lu,\n",
+		   stats.events,stats.pulses,stats.tips,stats.readings,stats.bad,stats.older,stats.gaps);
+	printf(" \"rejected\":{\"range\":%lu,\"spike\":%lu,\"rate\":%lu},\"stored\":%lu,\n",
+		   stats.rejected[FILTERRANGE],stats.rejected[FILTERSPIKE],stats.rejected[FILTERRATE],
+		   stats.stored);
+	printf(" \"sinks\":{");
+	for (i=0; i<stats.nsinks; i++)
+		printf("%s\"%s\":{\"written\":%lu,\"dropped\":%lu,\"errors\":%lu}",i ? "," : "",
+			   (n>0) ? names[i]+5 : "mysql",stats.written[i],stats.dropped[i],stats.errors[i]);
+	printf("}}\n");
+	return 0;
+}
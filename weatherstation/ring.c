@@ -0,0 +1,128 @@
+/*---------------------------------------------------------------------------
+   ring.c   bounded lock-free queue of fixed size slots
+	2026-10-17   initial edits
+
+	Any number of threads may put and get at the same time.  Each slot
+	carries a sequence number that tells whether it is free, full or
+	still being copied, so neither side ever waits on a lock.  A put
+	on a full ring fails instead of blocking; the caller decides
+	whether to drop or retry.
+
+---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "weatherstation.h"
+
+//**************************************************************************
+// set up ring with room for at least nslots items of slotsize bytes
+//  RETURNS: 0 for success, 1 if out of memory
+int RingInit(RING *r, int nslots, int slotsize)
+{
+	unsigned int n = 2;
+	unsigned int i;
+
+	while (n<(unsigned int)nslots)
+		n <<= 1;
+	memset(r,0,sizeof(RING));
+	r->seq = malloc(n*sizeof(unsigned int));
+	r->data = malloc((size_t)n*slotsize);
+	if ((r->seq==NULL)||(r->data==NULL))
+	{
+		free(r->seq);
+		free(r->data);
+		r->seq = NULL;
+		r->data = NULL;
+		return 1;
+	}
+	for (i=0; i<n; i++)
+		r->seq[i] = i;
+	r->mask = n-1;
+	r->slotsize = slotsize;
+	return 0;
+}
+
+//**************************************************************************
+// release ring memory
+void RingFree(RING *r)
+{
+	free(r->seq);
+	free(r->data);
+	r->seq = NULL;
+	r->data = NULL;
+}
+
+//**************************************************************************
+// copy item into the ring
+//  RETURNS: 0 for success, 1 if ring is full
+int RingPut(RING *r, void *item)
+{
+	unsigned int pos, seq, cell;
+	int dif;
+
+	pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		cell = pos & r->mask;
+		seq = __atomic_load_n(&r->seq[cell], __ATOMIC_ACQUIRE);
+		dif = (int)(seq - pos);
+		if (dif==0)
+		{
+			if (__atomic_compare_exchange_n(&r->head, &pos, pos+1, 1,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (dif<0)
+			return 1;
+		else
+			pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	}
+	memcpy(r->data+(size_t)cell*r->slotsize, item, r->slotsize);
+	__atomic_store_n(&r->seq[cell], pos+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+//**************************************************************************
+// copy oldest item out of the ring
+//  RETURNS: 0 for success, 1 if ring is empty
+int RingGet(RING *r, void *item)
+{
+	unsigned int pos, seq, cell;
+	int dif;
+
+	pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		cell = pos & r->mask;
+		seq = __atomic_load_n(&r->seq[cell], __ATOMIC_ACQUIRE);
+		dif = (int)(seq - (pos+1));
+		if (dif==0)
+		{
+			if (__atomic_compare_exchange_n(&r->tail, &pos, pos+1, 1,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (dif<0)
+			return 1;
+		else
+			pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	}
+	memcpy(item, r->data+(size_t)cell*r->slotsize, r->slotsize);
+	__atomic_store_n(&r->seq[cell], pos+r->mask+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+//**************************************************************************
+// approximate number of items waiting
+int RingCount(RING *r)
+{
+	unsigned int h, t;
+
+	h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	t = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	if ((int)(h-t)<0)
+		return 0;
+	return (int)(h-t);
+}
@@ -0,0 +1,254 @@
+/*---------------------------------------------------------------------------
+   rollup.c   minute, hour and day aggregates for every metric
+	2026-10-17   initial edits
+
+	dbthread hands every sample it takes off the queue to RollupAdd(),
+	which keeps a running count, min, max and sum for each metric over
+	the current minute, hour and day.  Hours and days follow local
+	time.  A period is closed when a sample for the next one turns up,
+	or by RollupTick() once its end is ROLLGRACE seconds past, and the
+	result is queued for RollupGet().  When a metric is fed raw
+	readings (StoreRaw()) its minute mean is also queued as an ordinary
+	sample, so the data table keeps one row per metric per minute
+	without each thread keeping its own totals.
+
+	The open periods are saved in the checkpoint (checkpoint.c) by
+	metric name and picked up again at start up, so a restart carries
+	on with the same minute, hour and day.  Periods that ended while
+	the daemon was down are closed by the first RollupTick().  Without
+	a checkpoint, periods cut short by a restart are written as they
+	are.  Rows for the same metric, period and start can be merged
+	afterwards since count, min, max and sum all combine.
+
+	Only dbthread calls these functions so there is no locking, apart
+	from RollupGet() and RollupPending() which the mysql sink thread
+	uses on the lock-free queue of closed periods.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "weatherstation.h"
+
+#define ROLLQSIZE	8192		// closed periods that can wait for the DB
+
+// one open period
+typedef struct {
+	double		start;
+	double		end;
+	long		count;
+	double		min;
+	double		max;
+	double		sum;
+} ROLLACC;
+
+static ROLLACC			acc[MAXMETRICS][ROLLPERIODS];
+static char				raw[MAXMETRICS];	// metric is fed raw readings
+static RING				rollq;				// closed periods
+static unsigned long	late;				// samples for a period already closed
+static unsigned long	dropped;			// closed periods lost, rollq full
+static char				*periodNames[ROLLPERIODS] = {"m","h","d"};
+
+// one metric in a checkpoint
+typedef struct {
+	char		name[METRICNAMESZ];
+	int			raw;
+	ROLLACC		acc[ROLLPERIODS];
+} ROLLCKPT;
+
+//**************************************************************************
+// set up the queue of closed periods
+//  RETURNS: 0 for success, 1 if out of memory
+int RollupInit(void)
+{
+	if (RingInit(&rollq,ROLLQSIZE,sizeof(ROLLUP)))
+	{
+		Log("rollup> no memory for %d rollups",ROLLQSIZE);
+		return 1;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// short name of a period for the database
+char *RollupPeriodName(int period)
+{
+	return periodNames[period];
+}
+
+//**************************************************************************
+// find the period holding time t
+static void Bounds(double t, int period, double *start, double *end)
+{
+	time_t tt = (time_t)t;
+	struct tm tm;
+
+	if (period==0)
+	{
+		*start = floor(t/60)*60;
+		*end = *start+60;
+		return;
+	}
+	localtime_r(&tt,&tm);
+	tm.tm_sec = 0;
+	tm.tm_min = 0;
+	if (period==2)
+		tm.tm_hour = 0;
+	tm.tm_isdst = -1;
+	*start = mktime(&tm);
+	if (period==2)
+		tm.tm_mday++;
+	else
+		tm.tm_hour++;
+	tm.tm_isdst = -1;
+	*end = mktime(&tm);
+}
+
+//**************************************************************************
+// queue the totals for a period and start it over
+static void Close(int metric, int period)
+{
+	ROLLACC *a = &acc[metric][period];
+	ROLLUP r;
+
+	r.metric = metric;
+	r.period = period;
+	r.start = a->start;
+	r.count = a->count;
+	r.min = a->min;
+	r.max = a->max;
+	r.sum = a->sum;
+	if ((rollq.seq!=NULL) && RingPut(&rollq,&r))
+		dropped++;
+	// the data table gets a mean for each minute of raw readings
+	if ((period==0) && raw[metric])
+		StoreMean(metric,a->sum/a->count,a->end);
+	a->count = 0;
+}
+
+//**************************************************************************
+// add samples to the open periods
+void RollupAdd(SAMPLE *s, int n)
+{
+	ROLLACC *a;
+	int i, p;
+
+	for (i=0; i<n; i++)
+	{
+		if ((s[i].kind==SAMPLE_MEAN)||(s[i].metric<0)||(s[i].metric>=MAXMETRICS))
+			continue;
+		if (s[i].kind==SAMPLE_RAW)
+			raw[s[i].metric] = 1;
+		for (p=0; p<ROLLPERIODS; p++)
+		{
+			a = &acc[s[i].metric][p];
+			if ((a->count>0) && (s[i].dt>=a->end))
+				Close(s[i].metric,p);
+			if (a->count==0)
+			{
+				Bounds(s[i].dt,p,&a->start,&a->end);
+				a->min = a->max = s[i].value;
+				a->sum = 0;
+			}
+			else if (s[i].dt<a->start)
+			{
+				if ((late++%1000)==0)
+					Log("rollup> %lu samples too late for their period",late);
+				continue;
+			}
+			if (s[i].value<a->min) a->min = s[i].value;
+			if (s[i].value>a->max) a->max = s[i].value;
+			a->sum += s[i].value;
+			a->count++;
+		}
+	}
+}
+
+//**************************************************************************
+// close the periods that ended at least ROLLGRACE seconds before now,
+// or all of them when all is set
+void RollupTick(double now, int all)
+{
+	int m, p, n;
+
+	n = MetricCount();
+	for (m=0; m<n; m++)
+		for (p=0; p<ROLLPERIODS; p++)
+			if ((acc[m][p].count>0) && (all || (now>=acc[m][p].end+ROLLGRACE)))
+				Close(m,p);
+}
+
+//**************************************************************************
+// take the oldest closed period
+//  RETURNS: 0 for success, 1 if there is none
+int RollupGet(ROLLUP *r)
+{
+	if (rollq.seq==NULL)
+		return 1;
+	return RingGet(&rollq,r);
+}
+
+//**************************************************************************
+// closed periods waiting
+int RollupPending(void)
+{
+	if (rollq.seq==NULL)
+		return 0;
+	return RingCount(&rollq);
+}
+
+//**************************************************************************
+// closed periods lost because too many were waiting
+unsigned long RollupDropped(void)
+{
+	return dropped;
+}
+
+//**************************************************************************
+// copy the open periods into a checkpoint
+//  RETURNS: bytes of buf used
+int RollupSave(void *buf, int sz)
+{
+	ROLLCKPT *ck = buf;
+	int m, p, n = 0, open;
+
+	for (m=0; (m<MetricCount()) && ((n+1)*sizeof(ROLLCKPT)<=sz); m++)
+	{
+		for (p=open=0; p<ROLLPERIODS; p++)
+			open |= (acc[m][p].count>0);
+		if (!open && !raw[m])
+			continue;
+		memset(ck[n].name,0,METRICNAMESZ);
+		strncpy(ck[n].name,MetricName(m),METRICNAMESZ-1);
+		ck[n].raw = raw[m];
+		memcpy(ck[n].acc,acc[m],sizeof(ck[n].acc));
+		n++;
+	}
+	return n*sizeof(ROLLCKPT);
+}
+
+//**************************************************************************
+// carry on with the open periods from a checkpoint, before any samples
+// are added
+void RollupRestore(void *buf, int len)
+{
+	ROLLCKPT *ck = buf;
+	char name[METRICNAMESZ];
+	int i, m, n = 0;
+
+	for (i=0; i<len/sizeof(ROLLCKPT); i++)
+	{
+		memcpy(name,ck[i].name,METRICNAMESZ);
+		name[METRICNAMESZ-1] = 0;
+		m = MetricId(name);
+		if (m<0)
+			continue;
+		raw[m] = ck[i].raw;
+		memcpy(acc[m],ck[i].acc,sizeof(acc[m]));
+		n++;
+	}
+	Log("rollup> carried on with %d metrics from the checkpoint",n);
+}
@@ -0,0 +1,145 @@
+/*---------------------------------------------------------------------------
+   rt.c   real-time priority, CPU pinning and locked memory
+	2026-10-17   initial edits
+
+	An SD card flush, a MySQL reconnect or a busy web client can hold
+	up the threads that take the wind and rain edges long enough for
+	pulses to come in late.  These settings, all read at startup only,
+	keep the capture paths ahead of everything else:
+
+		rtprio=    SCHED_FIFO priority 1..99 for the threads the edge
+		           handlers run on, 0 leaves them alone
+		rtsample=  the same for the sampling threads, the sensor
+		           scheduler and bus workers, rain, wind or the event
+		           loop.  Keep it below rtprio
+		rtcpus=    CPUs those threads may run on, "3" or "2-3" or
+		           "1,3".  Blank for any
+		mlock=1    lock all memory so a page fault never stalls them
+
+	The edge handler threads belong to the backend, so each handler
+	applies rtprio to its own thread the first time it runs.  Anything
+	that can not be set, normally for want of CAP_SYS_NICE or the
+	memlock limit, is logged once and counted in /stats.
+
+---------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE			// CPU_SET, pthread_setaffinity_np
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "weatherstation.h"
+
+static cpu_set_t	cpus;
+static int			ncpus;					// CPUs in rtcpus, 0 for any
+static RTSTATS		stats;
+
+//**************************************************************************
+// read a CPU list like "0,2-3" into cpus
+//  RETURNS: 0 for success, 1 if it can not be read
+static int ParseCpus(char *s)
+{
+	char *p = s, *end;
+	long a, b;
+
+	CPU_ZERO(&cpus);
+	while (*p)
+	{
+		a = strtol(p,&end,10);
+		if ((end==p) || (a<0) || (a>=CPU_SETSIZE))
+			return 1;
+		b = a;
+		p = end;
+		if (*p=='-')
+		{
+			b = strtol(p+1,&end,10);
+			if ((end==p+1) || (b<a) || (b>=CPU_SETSIZE))
+				return 1;
+			p = end;
+		}
+		for (; a<=b; a++)
+			CPU_SET(a,&cpus);
+		if (*p==',')
+			p++;
+		else if (*p)
+			return 1;
+	}
+	ncpus = CPU_COUNT(&cpus);
+	return 0;
+}
+
+//**************************************************************************
+// lock memory and read the CPU list, once at startup
+//  RETURNS: 0 for success, 1 if something could not be set
+int RtInit(void)
+{
+	int err = 0;
+
+	stats.isrPrio = rtPrio;
+	stats.samplePrio = rtSample;
+	if (rtCpus[0] && ParseCpus(rtCpus))
+	{
+		Log("rt> rtcpus=%s can not be read, any CPU will do",rtCpus);
+		ncpus = 0;
+		err = 1;
+	}
+	if (rtLock)
+	{
+		if (mlockall(MCL_CURRENT|MCL_FUTURE))
+		{
+			Log("rt> mlockall failed: %s",strerror(errno));
+			err = 1;
+		}
+		else
+			stats.locked = 1;
+	}
+	if (err)
+		stats.failed++;
+	return err;
+}
+
+//**************************************************************************
+// give the calling thread priority prio, 0 for none, and the rtcpus
+//  RETURNS: 1, so an edge handler can keep it in a done flag
+int RtThread(char *who, int prio)
+{
+	struct sched_param sp;
+	int e;
+
+	if ((prio>0) && (prio<=99))
+	{
+		memset(&sp,0,sizeof(sp));
+		sp.sched_priority = prio;
+		e = pthread_setschedparam(pthread_self(),SCHED_FIFO,&sp);
+		if (e)
+		{
+			Log("rt> %s: SCHED_FIFO %d failed: %s",who,prio,strerror(e));
+			__atomic_add_fetch(&stats.failed,1,__ATOMIC_RELAXED);
+		}
+		else
+			__atomic_add_fetch(&stats.threads,1,__ATOMIC_RELAXED);
+	}
+	if (ncpus>0)
+	{
+		e = pthread_setaffinity_np(pthread_self(),sizeof(cpus),&cpus);
+		if (e)
+		{
+			Log("rt> %s: rtcpus=%s failed: %s",who,rtCpus,strerror(e));
+			__atomic_add_fetch(&stats.failed,1,__ATOMIC_RELAXED);
+		}
+	}
+	if ((prio>0) || (ncpus>0))
+		LogDbg("rt> %s priority %d cpus '%s'",who,prio,rtCpus);
+	return 1;
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void RtGetStats(RTSTATS *out)
+{
+	memcpy(out,&stats,sizeof(RTSTATS));
+}
@@ -0,0 +1,772 @@
+/*---------------------------------------------------------------------------
+   sensor.c   sensor drivers and the scheduler that runs them
+	2026-10-17   initial edits
+
+	Each kind of sensor is a SENSORDRV in one of the sensor_xxx.c files
+	and is listed in drivers[] below.  A driver names its bus, how long
+	a conversion takes and how often it wants to be read.  Each sensor
+	in the config is one [sensor.name] section:
+
+		[sensor.garden]
+		driver=ds18b20
+		id=28-000004fcf3ce
+		period=5000
+		temp=gardenTemp
+
+	addr= sets the bus address, period= the ms between readings, and
+	each value the driver gives can be stored under another metric
+	name (temp= above).  With no sensor sections at all the station
+	has its original AM2315 and MPL115A2 read every i2cperiod ms, and
+	the tempA probe if there is one.
+
+	Readings go through the data quality checks in filter.c, only
+	values that pass are stored or put in the snapshot.
+
+	One scheduler thread keeps every sensor in a single heap ordered by
+	when its next step is due, and hands due steps to a worker thread
+	for that bus.  A reading is two steps: start a conversion, then
+	read the result when the driver says it will be ready.  The bus
+	is free in between, so sensors on one bus take turns without
+	waiting on each other's conversions, and different buses run at
+	the same time.  That is one thread plus one per bus, however many
+	sensors there are.
+
+	Only the scheduler touches the heap and the timing fields, the
+	workers only run the driver steps, so there are no locks.  A
+	reload builds a new sensor list, sensors whose settings did not
+	change carry on as they were, and are only opened again if their
+	resolution= did.  The new list is published with one pointer
+	store, and old lists and dropped sensors are kept until exit
+	since the status page may be reading them.
+
+	With eventloop=1 there is no scheduler thread.  SensorPoll() runs
+	on the reactor.c thread from a timer set for the first step due,
+	and from an eventfd the bus workers signal when a step is back.
+	The bus workers stay, they are the only code that blocks.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "weatherstation.h"
+
+#define MAXBUSES		8
+#define MAXBACKOFF		60000			// ms, longest wait after errors
+#define SENSORTRIES		3				// reads of a result that is not ready
+
+#define PHASESTART		0				// start a conversion next
+#define PHASEREAD		1				// read the result next
+
+#define STEPMORE		0				// more steps, after wait ms
+#define STEPDONE		1				// value[] is set
+#define STEPERROR		2
+
+// a bus and the worker that runs its steps
+typedef struct SENSORBUS {
+	char		name[16];
+	RING		jobs;					// SENSOR pointers to run
+	sem_t		sem;					// posted for each job
+	pthread_t	tid;
+	int			stop;
+} SENSORBUS;
+
+// the sensors in use, in config order
+typedef struct {
+	int			count;
+	SENSOR		*s[MAXSENSORS];
+} SENSORSET;
+
+// every kind of sensor there is
+static SENSORDRV *drivers[] = {
+	&drvAm2315,
+	&drvMpl115a2,
+	&drvDs18b20,
+	NULL
+};
+
+// metrics that are also in the snapshot
+static struct {
+	char	*metric;
+	int		offset;
+	int		time;						// when the group was last updated
+} snapFields[] = {
+	{ "outsideTemp",	offsetof(SNAPSHOT,outsideTemp),	offsetof(SNAPSHOT,i2cTime) },
+	{ "humidity",		offsetof(SNAPSHOT,humidity),	offsetof(SNAPSHOT,i2cTime) },
+	{ "boardTemp",		offsetof(SNAPSHOT,boardTemp),	offsetof(SNAPSHOT,i2cTime) },
+	{ "barometric",		offsetof(SNAPSHOT,barometric),	offsetof(SNAPSHOT,i2cTime) },
+	{ "tempA",			offsetof(SNAPSHOT,tempA),		offsetof(SNAPSHOT,w1Time) },
+	{ NULL, 0, 0 }
+};
+
+#define SNAPFIELD(s,off)	(*(double *)((char *)(s)+(off)))
+
+static SENSORBUS	buses[MAXBUSES];
+static int			nbuses;
+static SENSORSET	noSensors;
+static SENSORSET	*sensors = &noSensors;	// replaced whole on a reload
+static SENSOR		*made;					// every sensor, newest first
+static SENSOR		*heap[MAXSENSORS];		// idle sensors by due time
+static int			nheap;
+static RING			done;					// steps finished by the workers
+static sem_t		wake;					// posted with each one
+static int			doneEvent = -1;			// or this eventfd, eventloop=1
+static int			gen;					// ConfigGen() the list is from
+static int			out;					// steps with the workers
+static TIMER		sensorTimer;
+
+//**************************************************************************
+// look up a driver by name
+//  RETURNS: the driver, NULL if there is none by that name
+static SENSORDRV *FindDriver(char *name)
+{
+	int i;
+
+	for (i=0; drivers[i]!=NULL; i++)
+		if (!strcmp(drivers[i]->name,name))
+			return drivers[i];
+	return NULL;
+}
+
+//**************************************************************************
+// heap of sensors ordered by due time, earliest at heap[0]
+static void HeapPush(SENSOR *s)
+{
+	int i, p;
+
+	for (i=nheap++; i>0; i=p)
+	{
+		p = (i-1)/2;
+		if (heap[p]->due<=s->due)
+			break;
+		heap[i] = heap[p];
+	}
+	heap[i] = s;
+}
+
+static SENSOR *HeapPop(void)
+{
+	SENSOR *top, *s;
+	int i, c;
+
+	top = heap[0];
+	s = heap[--nheap];
+	for (i=0; (c=2*i+1)<nheap; i=c)
+	{
+		if ((c+1<nheap) && (heap[c+1]->due<heap[c]->due))
+			c++;
+		if (s->due<=heap[c]->due)
+			break;
+		heap[i] = heap[c];
+	}
+	heap[i] = s;
+	return top;
+}
+
+//**************************************************************************
+// one step of a reading, on the bus worker
+static void Step(SENSOR *s)
+{
+	SENSORDRV *d = s->drv;
+	unsigned long long now = MonoNs();
+	int r;
+
+	// how late the bus got to it
+	HistAdd(&histSensor,(now>s->due) ? now-s->due : 0);
+	if (s->phase==PHASESTART)
+	{
+		if (!s->ready && (d->open!=NULL) && d->open(s))
+		{
+			s->result = STEPERROR;
+			return;
+		}
+		s->ready = 1;
+		r = (d->start!=NULL) ? d->start(s) : d->convert;
+		if (r<0)
+		{
+			s->result = STEPERROR;
+			return;
+		}
+		s->phase = PHASEREAD;
+		s->tries = 0;
+		s->wait = r;
+		s->result = STEPMORE;
+		return;
+	}
+	r = d->read(s);
+	if (r==0)
+		s->result = STEPDONE;
+	else if ((r>0) && (++s->tries<SENSORTRIES))
+	{
+		s->wait = r;
+		s->result = STEPMORE;
+	}
+	else
+		s->result = STEPERROR;
+}
+
+//**************************************************************************
+// bus worker, runs the steps it is given one at a time
+static void *BusThread(void *param)
+{
+	SENSORBUS *b = param;
+	SENSOR *s;
+
+	RtThread("sensor bus",rtSample);
+	for (;;)
+	{
+		sem_wait(&b->sem);
+		if (RingGet(&b->jobs,&s))
+		{
+			if (b->stop)
+				break;
+			continue;
+		}
+		Step(s);
+		RingPut(&done,&s);
+		if (__atomic_load_n(&doneEvent,__ATOMIC_ACQUIRE)>=0)
+			ReactorSignal(doneEvent);
+		else
+			sem_post(&wake);
+	}
+	return 0;
+}
+
+//**************************************************************************
+// the worker for a bus, started the first time a sensor uses it
+//  RETURNS: the bus, NULL if it could not be started
+static SENSORBUS *GetBus(char *name)
+{
+	SENSORBUS *b;
+	int i;
+
+	for (i=0; i<nbuses; i++)
+		if (!strcmp(buses[i].name,name))
+			return &buses[i];
+	if (nbuses>=MAXBUSES)
+		return NULL;
+	b = &buses[nbuses];
+	memset(b,0,sizeof(SENSORBUS));
+	snprintf(b->name,sizeof(b->name),"%s",name);
+	if (RingInit(&b->jobs,MAXSENSORS,sizeof(SENSOR *)))
+		return NULL;
+	sem_init(&b->sem,0,0);
+	if (pthread_create(&b->tid,NULL,BusThread,b))
+	{
+		RingFree(&b->jobs);
+		return NULL;
+	}
+	Log("sensor> %s bus worker started",name);
+	return &buses[nbuses++];
+}
+
+//**************************************************************************
+// make a sensor from its [sensor.name] section, anything not set there
+// comes from the driver or the defaults given
+//  RETURNS: the new sensor, NULL if it can not be used
+static SENSOR *Make(char *name, char *defdrv, char *defid)
+{
+	SENSOR *s;
+	SENSORDRV *d;
+	char key[120], *v;
+	int k;
+
+	snprintf(key,sizeof(key),"sensor.%s.driver",name);
+	v = ConfigStr(key,defdrv);
+	d = FindDriver(v);
+	if (d==NULL)
+	{
+		Log("sensor> %s: no driver '%s'",name,v);
+		return NULL;
+	}
+	s = calloc(1,sizeof(SENSOR));
+	if (s==NULL)
+		return NULL;
+	snprintf(s->name,sizeof(s->name),"%s",name);
+	s->drv = d;
+	s->fd = -1;
+	snprintf(key,sizeof(key),"sensor.%s.addr",name);
+	s->addr = ConfigInt(key,d->addr,0,0x7f);
+	snprintf(key,sizeof(key),"sensor.%s.id",name);
+	ConfigCopy(key,defid,s->id,sizeof(s->id));
+	// i2cperiod is the default for every I2C sensor
+	snprintf(key,sizeof(key),"sensor.%s.period",name);
+	s->period = ConfigInt(key,strcmp(d->bus,"i2c") ? d->period :
+				ConfigInt("i2cperiod",i2cPeriod,1,3600000),1,3600000);
+	snprintf(key,sizeof(key),"sensor.%s.resolution",name);
+	if (ConfigStr(key,NULL)!=NULL)
+		s->resolution = ConfigInt(key,12,9,12);
+	for (k=0; (k<SENSOROUTS) && (d->outs[k]!=NULL); k++)
+	{
+		snprintf(key,sizeof(key),"sensor.%s.%s",name,d->outs[k]);
+		s->metric[k] = MetricId(ConfigStr(key,(d->metrics[k]!=NULL) ? d->metrics[k] : name));
+		if (s->metric[k]<0)
+		{
+			free(s);
+			return NULL;
+		}
+	}
+	s->nouts = k;
+	s->next = made;
+	made = s;
+	return s;
+}
+
+//**************************************************************************
+// free a sensor Make() gave that was never put in use
+static void Discard(SENSOR *s)
+{
+	SENSOR **p;
+
+	for (p=&made; *p!=NULL; p=&(*p)->next)
+		if (*p==s)
+		{
+			*p = s->next;
+			break;
+		}
+	free(s);
+}
+
+//**************************************************************************
+// do two sensors read the same thing the same way?  The period may differ
+static int Same(SENSOR *a, SENSOR *b)
+{
+	return (a->drv==b->drv) && (a->addr==b->addr) && !strcmp(a->id,b->id) &&
+		   (a->nouts==b->nouts) && !memcmp(a->metric,b->metric,sizeof(a->metric));
+}
+
+//**************************************************************************
+// build the sensor list from the config, keeping sensors that are
+// unchanged and dropping the rest
+static void Configure(unsigned long long now)
+{
+	SENSOR *list[MAXSENSORS], *old[MAXSENSORS], *s;
+	SENSORSET *set;
+	char *names[MAXSENSORS], id[sizeof(tempA_ID)];
+	int i, j, n, nold, count = 0;
+
+	set = calloc(1,sizeof(SENSORSET));
+	if (set==NULL)
+	{
+		Log("sensor> no memory, sensor list not changed");
+		return;
+	}
+	nold = sensors->count;
+	memcpy(old,sensors->s,nold*sizeof(SENSOR *));
+
+	n = ConfigSections("sensor.",names,MAXSENSORS);
+	for (i=0; i<n; i++)
+	{
+		s = Make(names[i]+7,"","");
+		if (s!=NULL)
+			list[count++] = s;
+	}
+	// the original sensors when there are no sections
+	if (n==0)
+	{
+		ConfigCopy("tempA",tempA_ID,id,sizeof(id));
+		if ((s = Make("outside","am2315",""))!=NULL)
+			list[count++] = s;
+		if ((s = Make("board","mpl115a2",""))!=NULL)
+			list[count++] = s;
+		if ((id[0]!=0) && (s = Make("tempA","ds18b20",id))!=NULL)
+			list[count++] = s;
+	}
+
+	// keep what has not changed, it carries on with its timing
+	for (i=0; i<count; i++)
+	{
+		for (j=0; j<nold; j++)
+		{
+			if ((old[j]==NULL) || strcmp(old[j]->name,list[i]->name) ||
+				!Same(old[j],list[i]))
+				continue;
+			if (old[j]->period!=list[i]->period)
+				Log("sensor> %s period now %d ms",list[i]->name,list[i]->period);
+			old[j]->period = list[i]->period;
+			// opened again so the driver sees a new resolution, once
+			// the worker has given it back if it is out
+			if (old[j]->busy)
+			{
+				old[j]->newResolution = list[i]->resolution;
+				old[j]->reopen = (old[j]->resolution!=list[i]->resolution);
+			}
+			else if (old[j]->resolution!=list[i]->resolution)
+			{
+				old[j]->resolution = list[i]->resolution;
+				old[j]->ready = 0;
+			}
+			Discard(list[i]);
+			list[i] = old[j];
+			old[j] = NULL;
+			break;
+		}
+		if (j<nold)
+			continue;
+		s = list[i];
+		s->bus = GetBus(s->drv->bus);
+		if (s->bus==NULL)
+		{
+			Log("sensor> %s: no worker for the %s bus",s->name,s->drv->bus);
+			Discard(s);
+			list[i--] = list[--count];
+			continue;
+		}
+		s->slot = s->due = now;
+		if (s->id[0])
+			Log("sensor> %s: %s on %s id %s every %d ms",s->name,s->drv->name,
+				s->drv->bus,s->id,s->period);
+		else
+			Log("sensor> %s: %s on %s addr 0x%02x every %d ms",s->name,s->drv->name,
+				s->drv->bus,s->addr,s->period);
+	}
+	for (j=0; j<nold; j++)
+		if (old[j]!=NULL)
+		{
+			Log("sensor> %s removed",old[j]->name);
+			old[j]->gone = 1;
+		}
+	if (count==0)
+		Log("sensor> no sensors configured");
+
+	// the heap holds every sensor not out with a worker
+	nheap = 0;
+	for (i=0; i<count; i++)
+	{
+		set->s[i] = list[i];
+		if (!list[i]->busy)
+			HeapPush(list[i]);
+	}
+	set->count = count;
+	__atomic_store_n(&sensors,set,__ATOMIC_RELEASE);
+}
+
+//**************************************************************************
+// a reading is in, store it and put it in the snapshot
+static void Publish(SENSOR *s)
+{
+	SNAPSHOT *snap = NULL;
+	char tmp[200];
+	double now = TimeNow();
+	int k, i, len;
+
+	for (k=0; k<s->nouts; k++)
+	{
+		LogDbg("sensor> %12s %6.1f",MetricName(s->metric[k]),s->value[k]);
+		if ((i = FilterCheck(s->metric[k],s->value[k],now,s->drv->lo[k],s->drv->hi[k]))!=0)
+		{
+			LogDbg("sensor> %s %g dropped, %s",MetricName(s->metric[k]),s->value[k],
+				   (i==FILTERRANGE) ? "out of range" : (i==FILTERSPIKE) ? "spike" : "too fast");
+			s->rejected++;
+			continue;
+		}
+		StoreRaw(s->metric[k],s->value[k],now);
+		for (i=0; snapFields[i].metric!=NULL; i++)
+		{
+			if (strcmp(snapFields[i].metric,MetricName(s->metric[k])))
+				continue;
+			if (snap==NULL)
+				snap = SnapBegin();
+			SNAPFIELD(snap,snapFields[i].offset) = s->value[k];
+			SNAPFIELD(snap,snapFields[i].time) = now;
+		}
+	}
+	if (snap!=NULL)
+		SnapEnd();
+
+	// log current values once a minute
+	if ((time_t)now-s->lastLog>=60)
+	{
+		len = snprintf(tmp,sizeof(tmp),"sensor> %s:",s->name);
+		for (k=0; (k<s->nouts) && (len<sizeof(tmp)); k++)
+			len += snprintf(tmp+len,sizeof(tmp)-len," %s %.2f",
+							MetricName(s->metric[k]),s->value[k]);
+		Log("%s",tmp);
+		s->lastLog = now;
+	}
+}
+
+//**************************************************************************
+// a step is back from the worker, work out when the next one is due
+static void Finished(SENSOR *s, unsigned long long now)
+{
+	unsigned long long ms;
+
+	s->busy = 0;
+	if (s->gone)
+		return;
+	if (s->reopen)
+	{
+		s->resolution = s->newResolution;
+		s->ready = 0;
+		s->reopen = 0;
+	}
+	switch (s->result)
+	{
+		case STEPMORE:
+			s->due = now + s->wait*1000000ULL;
+			HeapPush(s);
+			return;
+
+		case STEPDONE:
+			s->reads++;
+			if (s->fails>0)
+				Log("sensor> %s reading again after %d errors",s->name,s->fails);
+			s->fails = 0;
+			Publish(s);
+			// keep to the period, skipping readings there was no time for
+			s->slot += s->period*1000000ULL;
+			if (s->slot<now)
+				s->slot = now;
+			break;
+
+		case STEPERROR:
+			s->errors++;
+			if (s->fails++==0)
+				Log("sensor> %s: %s read failed, retrying",s->name,s->drv->name);
+			s->ready = 0;
+			// wait longer after each error in a row
+			ms = s->period;
+			if (s->fails>1)
+				ms <<= (s->fails<12) ? s->fails-1 : 11;
+			if (ms>MAXBACKOFF)
+				ms = (s->period>MAXBACKOFF) ? s->period : MAXBACKOFF;
+			s->slot = now + ms*1000000ULL;
+			break;
+	}
+	s->phase = PHASESTART;
+	s->due = s->slot;
+	HeapPush(s);
+}
+
+//**************************************************************************
+// the sensors in use, for the status page.  They stay valid until exit
+//  RETURNS: how many were put in out
+int SensorList(SENSOR **out, int max)
+{
+	SENSORSET *set = __atomic_load_n(&sensors,__ATOMIC_ACQUIRE);
+	int i;
+
+	for (i=0; (i<set->count) && (i<max); i++)
+		out[i] = set->s[i];
+	return i;
+}
+
+//**************************************************************************
+// the limits the driver gives for a metric, from the sensor that
+// stores it in the config.  For weatherstation-replay, which checks
+// readings without running the sensors
+//  RETURNS: 0 for success, 1 if no sensor stores it
+int SensorLimits(int metric, double *lo, double *hi)
+{
+	static char *defs[][2] = {{"outside","am2315"},{"board","mpl115a2"},{"tempA","ds18b20"}};
+	char *names[MAXSENSORS], key[120], *name;
+	SENSORDRV *d;
+	int i, k, n;
+
+	n = ConfigSections("sensor.",names,MAXSENSORS);
+	for (i=0; i<((n>0) ? n : 3); i++)
+	{
+		name = (n>0) ? names[i]+7 : defs[i][0];
+		snprintf(key,sizeof(key),"sensor.%s.driver",name);
+		d = FindDriver(ConfigStr(key,(n>0) ? "" : defs[i][1]));
+		if (d==NULL)
+			continue;
+		for (k=0; (k<SENSOROUTS) && (d->outs[k]!=NULL); k++)
+		{
+			snprintf(key,sizeof(key),"sensor.%s.%s",name,d->outs[k]);
+			if (MetricId(ConfigStr(key,(d->metrics[k]!=NULL) ? d->metrics[k] : name))==metric)
+			{
+				*lo = d->lo[k];
+				*hi = d->hi[k];
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+//**************************************************************************
+// set up the done ring and the sensor list
+//  RETURNS: 0 for success, 1 on error
+static int SensorSetup(void)
+{
+	if (RingInit(&done,MAXSENSORS,sizeof(SENSOR *)))
+	{
+		Log("sensor> no memory, sensors not read");
+		return 1;
+	}
+	sem_init(&wake,0,0);
+	gen = ConfigGen();
+	Configure(MonoNs());
+	return 0;
+}
+
+//**************************************************************************
+// take back finished steps, pick up a reload and hand out the steps
+// that are due
+//  RETURNS: MonoNs() the next step is due, 0 if none is
+static unsigned long long SensorPoll(void)
+{
+	SENSOR *s;
+	unsigned long long now;
+
+	// steps the workers have finished
+	now = MonoNs();
+	while (RingGet(&done,&s)==0)
+	{
+		out--;
+		Finished(s,now);
+	}
+
+	// a reload may add, change or drop sensors
+	if (ConfigGen()!=gen)
+	{
+		gen = ConfigGen();
+		Configure(now);
+	}
+
+	// hand out the steps that are due
+	while ((nheap>0) && (heap[0]->due<=now))
+	{
+		s = HeapPop();
+		s->busy = 1;
+		out++;
+		RingPut(&s->bus->jobs,&s);
+		sem_post(&s->bus->sem);
+	}
+	return (nheap>0) ? heap[0]->due : 0;
+}
+
+//**************************************************************************
+// stop the bus workers, nothing may be under way
+static void SensorFinish(void)
+{
+	int i;
+
+	for (i=0; i<nbuses; i++)
+	{
+		buses[i].stop = 1;
+		sem_post(&buses[i].sem);
+		pthread_join(buses[i].tid,NULL);
+		RingFree(&buses[i].jobs);
+	}
+}
+
+//**************************************************************************
+// wake the scheduler so it sees a reload or kicked straight away
+void SensorWake(void)
+{
+	if (doneEvent>=0)
+		ReactorSignal(doneEvent);
+	else if (done.seq!=NULL)
+		sem_post(&wake);
+}
+
+//**************************************************************************
+// Thread entry point, param is not used
+void *sensorthread(void *param)
+{
+	SENSOR *s;
+	struct timespec ts;
+	unsigned long long now, t, due;
+
+	RtThread("sensorthread",rtSample);
+	if (SensorSetup())
+		return 0;
+
+	Log("sensor> start scheduler loop.");
+	do
+	{
+		due = SensorPoll();
+
+		// sleep until the next one is due or a step comes back,
+		// at most a second so a shutdown is seen
+		now = MonoNs();
+		t = 1000000000ULL;
+		if ((due!=0) && (due-now<t))
+			t = (due>now) ? due-now : 0;
+		clock_gettime(CLOCK_REALTIME,&ts);
+		t += ts.tv_nsec;
+		ts.tv_sec += t/1000000000ULL;
+		ts.tv_nsec = t%1000000000ULL;
+		sem_timedwait(&wake,&ts);
+	} while (kicked==0);  // exit loop if flag set
+
+	// let the steps under way finish, then stop the workers
+	while (out>0)
+	{
+		sem_wait(&wake);
+		while (RingGet(&done,&s)==0)
+			out--;
+	}
+	SensorFinish();
+	Log("sensor> thread exiting");
+	return 0;
+}
+
+//**************************************************************************
+// eventloop=1: a step came back, a step is due or the config changed
+static void SensorEvent(void *arg)
+{
+	unsigned long long due;
+
+	due = SensorPoll();
+	if (due!=0)
+		TimerAt(&sensorTimer,due);
+	else
+		TimerCancel(&sensorTimer);
+}
+
+//**************************************************************************
+static void SensorDue(TIMER *t)
+{
+	SensorEvent(NULL);
+}
+
+//**************************************************************************
+// start the scheduler on the reactor.c thread
+//  RETURNS: 0 for success, 1 on error
+int SensorStart(void)
+{
+	int fd;
+
+	fd = ReactorEvent(SensorEvent,NULL);
+	if (fd<0)
+	{
+		Log("sensor> no event for the bus workers");
+		return 1;
+	}
+	__atomic_store_n(&doneEvent,fd,__ATOMIC_RELEASE);
+	if (SensorSetup())
+		return 1;
+	TimerInit(&sensorTimer,SensorDue,NULL);
+	SensorEvent(NULL);
+	Log("sensor> scheduler started on the event loop.");
+	return 0;
+}
+
+//**************************************************************************
+// the event loop has stopped, let the steps under way finish and stop
+// the workers
+void SensorStop(void)
+{
+	SENSOR *s;
+
+	TimerCancel(&sensorTimer);
+	while (out>0)
+	{
+		while (RingGet(&done,&s)==0)
+			out--;
+		if (out>0)
+			Sleep(10);
+	}
+	SensorFinish();
+	Log("sensor> scheduler stopped");
+}
@@ -0,0 +1,179 @@
+/*---------------------------------------------------------------------------
+   sensor_i2c.c   I2C sensor drivers, temp/humidity/baro
+                   (am2315 and MPL115A2)
+         Ted Hale
+	2014-11-27   initial edits
+	2014-12-27   add I2C code for the devices
+	2015-01-11   fix sign on celsius (am2315) 
+	2026-10-17   bus access through the hal, sample period from config
+	2026-10-17   every reading goes to the rollups, they make the minute
+	             averages that used to be kept here
+	2026-10-17   readings are published in the snapshot
+	2026-10-17   each device read is one I2C transaction (i2c.c), MPL115A2
+	             registers in one block read with a repeated start.
+	             AM2315 replies are crc checked, failed reads are
+	             skipped instead of stored as -999
+	2026-10-17   was i2cthread.c.  The devices are drivers run by the
+	             sensor scheduler (sensor.c) instead of a thread of
+	             their own, each can be at any address and there can be
+	             more than one of each
+	2026-10-17   drivers give the range each part can read, readings
+	             outside it are dropped by filter.c
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "weatherstation.h"
+
+//**************************************************************************
+// open an I2C device at the sensor's address
+//  RETURNS: 0 for success, -1 on error
+static int OpenI2c(SENSOR *s)
+{
+	s->fd = hal->i2cOpen(s->addr);
+	return (s->fd<0) ? -1 : 0;
+}
+
+//**************************************************************************
+// ask the am2315 for temperature and humidity
+//  RETURNS: ms until the reply is ready, -1 if the request was not
+//           acknowledged
+static int start_am2315(SENSOR *s)
+{
+	BYTE read_request[3] = {3, 0, 4};
+	BYTE dummy[1] = {0};
+	I2CMSG wake = { 0, 1, dummy };
+
+	// wake it up, it does not acknowledge this so it is not counted
+	hal->i2cXfer(s->fd, &wake, 1);
+	// request data
+	if (I2cWrite(s->fd, read_request, 3))
+		return -1;
+	return s->drv->convert;
+}
+
+//**************************************************************************
+// get temperature and humidity from am2315 device
+//  RETURNS: 0 for success, ms to wait if the reply is not ready,
+//           -1 if it is not valid
+static int read_am2315(SENSOR *s)
+{
+	BYTE response[8];
+	float celsius;
+
+	// the reply is ready 1.5 ms after the request, a little more when
+	// the bus is busy
+	if (I2cRead(s->fd, response, 8))
+		return 2;
+	// validity check, function code, length and crc
+	if ((response[0]!=3) || (response[1]!=4) ||
+		(Crc16(response,6)!=(response[6] | (response[7]<<8))))
+	{
+		LogDbg("sensor_i2c> %s am2315 response invalid",s->name);
+		return -1;
+	}
+	celsius = (256 * (response[4] & 0x7F) + response[5]) / 10.0;
+	if ((response[4]&0x80)!=0)
+		celsius *= -1.0;
+	// convert C to F
+	s->value[0] = (celsius * 1.8) + 32.0;
+	s->value[1] = (256*response[2] + response[3])/10.1;
+	return 0;
+}
+
+//**************************************************************************
+// open the mpl115a2 and get its conversion coefficients, they are kept
+// in state[0..3] as a0, b1, b2 and c12
+//  RETURNS: 0 for success, -1 on a bus error
+static int open_mpl115a2(SENSOR *s)
+{
+	BYTE r[8];
+	int16_t a0coeff;
+	int16_t b1coeff;
+	int16_t b2coeff;
+	int16_t c12coeff;
+	
+	if (OpenI2c(s))
+		return -1;
+	// get coef values from device registers, all eight in one read
+	if (I2cReadRegs(s->fd,4,r,8))
+		return -1;
+	a0coeff = (( (uint16_t) r[0] << 8) | r[1]);
+	b1coeff = (( (uint16_t) r[2] << 8) | r[3]);
+	b2coeff = (( (uint16_t) r[4] << 8) | r[5]);
+	c12coeff = (( (uint16_t) (r[6] << 8) | r[7])) >> 2;
+	// compute the floating point coefficients
+	s->state[0] = (float)a0coeff / 8;
+	s->state[1] = (float)b1coeff / 8192;
+	s->state[2] = (float)b2coeff / 16384;
+	s->state[3] = (float)c12coeff / 4194304.0;
+	return 0;
+}
+
+//**************************************************************************
+// start a mpl115a2 conversion
+//  RETURNS: ms until the result is ready, -1 on a bus error
+static int start_mpl115a2(SENSOR *s)
+{
+	if (I2cWriteReg(s->fd,0x12,0))
+		return -1;
+	return s->drv->convert;
+}
+
+//**************************************************************************
+// get temperature and barometric from mpl115a2 device
+//  RETURNS: 0 for success, -1 on a bus error
+static int read_mpl115a2(SENSOR *s)
+{
+	BYTE r[4];
+	int pressure;
+	int temp;
+	float pressureComp;
+	float baro, celsius;
+	
+	// get results from device registers, all four in one read
+	if (I2cReadRegs(s->fd,0,r,4))
+		return -1;
+	pressure = (( (uint16_t) r[0] << 8) | r[1]) >> 6;
+	temp = (( (uint16_t) r[2] << 8) | r[3]) >> 6;
+	// apply coefficients
+	pressureComp = s->state[0] + (s->state[1] + s->state[3] * temp ) * pressure +
+				   s->state[2] * temp;
+	// get pressure and temperature in the native units
+	baro = ((65.0F / 1023.0F) * pressureComp) + 50.0F;   // kPa
+	celsius = ((float) temp - 498.0F) / -5.35F + 25.0F;  // C
+	// return results in more useful units
+	// convert C to F
+	s->value[0] = (celsius * 1.8) + 32.0;
+	// convert kPa to inches mercury
+	s->value[1] = baro * 0.295299830714;
+	return 0;
+}
+
+// outside temperature and humidity
+SENSORDRV drvAm2315 = {
+	"am2315", "i2c", 0x5c, 2, 3000,
+	{ "temp", "humidity" },
+	{ "outsideTemp", "humidity" },
+	{ -40, 0 },							// -40..125 C
+	{ 257, 100 },
+	OpenI2c,
+	start_am2315,
+	read_am2315
+};
+
+// board temperature and barometric pressure, 5 ms covers the
+// conversion with time to spare
+SENSORDRV drvMpl115a2 = {
+	"mpl115a2", "i2c", 0x60, 5, 3000,
+	{ "temp", "pressure" },
+	{ "boardTemp", "barometric" },
+	{ -40, 14.76 },						// -40..105 C, 50..115 kPa
+	{ 221, 33.96 },
+	open_mpl115a2,
+	start_mpl115a2,
+	read_mpl115a2
+};
@@ -0,0 +1,168 @@
+/*---------------------------------------------------------------------------
+   sensor_w1.c   1-wire temperature probe driver
+         Ted Hale
+	2014-12-01   initial edit, from brewcontroller project
+	2026-10-17   read through the hal
+	2026-10-17   every reading goes to the rollups, which make the
+	             minute average, and into the snapshot
+	2026-10-17   the probe can be changed by a config reload, the
+	             thread waits for one when it has none to read
+	2026-10-17   was w1thread.c.  A driver for the sensor scheduler
+	             (sensor.c), any number of probes can be read, each in
+	             its own [sensor.name] section
+	2026-10-17   one conversion for every probe at once through the
+	             bus master's therm_bulk_read, then each probe is read
+	             straight off.  A probe's resolution= trades precision
+	             for conversion time
+	2026-10-17   the 85 C power on value is a failed read, not a
+	             temperature
+	
+NOTES:	
+sudo modprobe w1-gpio
+sudo modprobe w1-therm
+cd /sys/bus/w1/devices/
+ls  (to get ID string for sensor)   28-000004610260
+
+cd (ID String)
+cat w1_slave	
+first line must end with YES
+second line will end with t=12345    milli degrees C
+
+28-000004fcf3ce    tempA
+
+Reading w1_slave on its own starts a conversion and waits for it, up
+to 750 ms per probe, so twenty probes took 15 seconds.  Since Linux 5.10
+writing "trigger" to w1_bus_masterN/therm_bulk_read converts on every
+probe on the bus at once and w1_slave then just reads the result.  The
+first probe whose reading is due triggers it, every other probe due
+before it finishes joins in and waits for the same conversion, so a
+whole array reads in about one conversion time.  Without
+therm_bulk_read each probe converts as it is read, as before.
+
+resolution 9 10 11 12 bits, 0.5 0.25 0.125 0.0625 C
+conversion 94 188 375 750 ms
+
+---------------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "weatherstation.h"
+
+#define W1BITS		12					// resolution out of the box
+#define W1CONVERT	750					// ms to convert at W1BITS
+
+// the bulk conversion, only the w1 bus worker uses these
+static unsigned long long bulkStart;	// MonoNs() it was triggered
+static unsigned long long bulkDone;		// when the slowest probe in it is done
+static int noBulk;						// kernel can not, each read converts
+
+//**************************************************************************
+// set the probe's resolution if the config gives one, the conversion
+// time for it is kept in state[0]
+//  RETURNS: 0 for success, -1 if there is no probe id
+static int open_ds18b20(SENSOR *s)
+{
+	if (strlen(s->id)==0)
+		return -1;
+	s->state[0] = W1CONVERT;
+	// only written when asked for, the part keeps what it was last given
+	if (s->resolution==0)
+		return 0;
+	if (hal->w1Resolution(s->id,s->resolution))
+	{
+		Log("sensor_w1> %s could not be set to %d bits",s->id,s->resolution);
+		return 0;
+	}
+	s->state[0] = W1CONVERT >> (W1BITS-s->resolution);
+	return 0;
+}
+
+//**************************************************************************
+// start a conversion on every probe, or join the one under way
+//  RETURNS: ms until this probe's result is ready
+static int start_ds18b20(SENSOR *s)
+{
+	unsigned long long now = MonoNs(), done;
+
+	if (noBulk)
+		return 0;
+	if (now>=bulkDone)
+	{
+		if (hal->w1Bulk())
+		{
+			noBulk = 1;
+			Log("sensor_w1> no therm_bulk_read, each probe converts as it is read");
+			return 0;
+		}
+		bulkStart = now;
+		bulkDone = now;
+	}
+	done = bulkStart + (unsigned long long)s->state[0]*1000000ULL;
+	if (done>bulkDone)
+		bulkDone = done;
+	return (done-now+999999)/1000000;
+}
+
+//**************************************************************************
+// get temperature in Degrees F
+//  RETURNS: 0 for success, -1 if the probe is not there or the read
+//           was bad
+static int getTemperature(SENSOR *s)
+{
+	char buff[160];
+	char *p, *line2;
+	double c;
+	
+	if (strlen(s->id)==0)
+		return -1;
+	if (hal->w1Read(s->id,buff,sizeof(buff))<0)
+	{
+		LogDbg("sensor_w1> %s not found",s->id);
+		return -1;
+	}
+	// first line must end with YES
+	line2 = strchr(buff,'\n');
+	if (line2==NULL)
+	{
+		LogDbg("sensor_w1> error on 1-wire read: %s",buff);
+		return -1;
+	}
+	*line2++ = 0;
+	if (strcmp(&buff[36],"YES")!=0)
+	{
+		LogDbg("sensor_w1> error on 1-wire read: %s",buff);
+		return -1;
+	}
+	p = strstr(line2,"t=");
+	if (p==NULL)
+	{
+		LogDbg("sensor_w1> error on 1-wire read: %s",line2);
+		return -1;
+	}
+	c = atof(p+2);
+	// what the scratchpad holds before any conversion has been done,
+	// the probe lost power or missed the conversion
+	if (c==85000)
+	{
+		LogDbg("sensor_w1> %s gave the power on value",s->id);
+		return -1;
+	}
+	s->value[0] = ((c/1000.0) * 1.8) + 32.0;
+	return 0;
+}
+
+// DS18B20 and the like through the w1-therm module, the value is
+// stored under the sensor's own name unless temp= says otherwise
+SENSORDRV drvDs18b20 = {
+	"ds18b20", "w1", 0, W1CONVERT, 1000,
+	{ "temp" },
+	{ NULL },
+	{ -67 },							// -55..125 C
+	{ 257 },
+	open_ds18b20,
+	start_ds18b20,
+	getTemperature
+};
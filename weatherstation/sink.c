@@ -0,0 +1,444 @@
+/*---------------------------------------------------------------------------
+   sink.c   where stored samples go, each output with its own queue
+	2026-10-17   initial edits
+	2026-10-17   blockwait= limits how long overflow=block holds
+	             dbthread up
+
+	dbthread takes every sample off the main queue, archives it and
+	rolls it up, then hands the ones for storing to SinkPut().  That
+	copies them into a bounded ring for each sink and returns, and
+	each sink has a thread of its own that batches them up and writes
+	them out.  A slow or dead output only fills its own ring, the
+	sampling threads and the other sinks carry on.
+
+	Each sink is a [sink.name] section, type= picks one of sinkTypes[]
+	below (the sink_xxx.c files):
+
+		mysql	the data and rollup tables, with the spool, see
+				sink_mysql.c.  There can only be one
+		file	csv or line protocol appended to a local file
+		mqtt	a message per sample to an MQTT broker
+		http	line protocol POSTed to a collector
+
+	and these apply to all of them:
+
+		queue=		samples its ring holds, dbqueue by default
+		batch=		samples per write, dbbatch by default
+		flush=		most seconds a sample waits for a batch, dbflush
+		retry=		seconds between tries after a failed write, dbflush
+		overflow=	drop (the default) to lose new samples while the
+					ring is full, or block to have dbthread wait for
+					room.  Block holds up every sink while it waits,
+					so it is only for one that should not lose
+					anything
+		blockwait=	ms overflow=block waits, 1000 by default.  A sink
+					that takes nothing in that time is stalled and
+					drops like overflow=drop until it has room again,
+					so a dead output holds dbthread up once, not for
+					every sample.  0 waits as long as it takes, for
+					weatherstation-replay
+
+	A failed write keeps its batch and tries it again every retry
+	seconds, closing and opening the output in between.  With no sink
+	sections there is one mysql sink with the db settings, as before.
+
+	Sinks are set up when the program starts, a reload does not
+	change them.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "weatherstation.h"
+
+// every kind of sink there is
+static SINKTYPE *sinkTypes[] = {
+	&sinkMysql,
+	&sinkFile,
+	&sinkMqtt,
+	&sinkHttp,
+	NULL
+};
+
+static SINK	*sinks[MAXSINKS];
+static int	nsinks;
+
+//**************************************************************************
+// a setting from the sink's own section
+//  RETURNS: the value, def if it is not set
+char *SinkStr(SINK *k, char *name, char *def)
+{
+	char key[120];
+
+	snprintf(key,sizeof(key),"sink.%s.%s",k->name,name);
+	return ConfigStr(key,def);
+}
+
+//**************************************************************************
+// a whole number from the sink's own section, limited to min..max
+//  RETURNS: the value, def if it is not set
+int SinkInt(SINK *k, char *name, int def, int min, int max)
+{
+	char key[120];
+
+	snprintf(key,sizeof(key),"sink.%s.%s",k->name,name);
+	return ConfigInt(key,def,min,max);
+}
+
+//**************************************************************************
+// open a TCP connection, sends and receives give up after secs
+//  RETURNS: the socket, -1 on error
+int SinkConnect(char *host, int port, int secs)
+{
+	struct addrinfo hints, *res, *a;
+	struct timeval tv;
+	char sport[8];
+	int fd = -1, err;
+
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(sport,sizeof(sport),"%d",port);
+	err = getaddrinfo(host,sport,&hints,&res);
+	if (err)
+	{
+		Log("sink> %s: %s",host,gai_strerror(err));
+		return -1;
+	}
+	tv.tv_sec = secs;
+	tv.tv_usec = 0;
+	for (a=res; a!=NULL; a=a->ai_next)
+	{
+		fd = socket(a->ai_family,a->ai_socktype,a->ai_protocol);
+		if (fd<0)
+			continue;
+		setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+		setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+		if (connect(fd,a->ai_addr,a->ai_addrlen)==0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd<0)
+		Log("sink> error %d connecting to %s:%d",errno,host,port);
+	return fd;
+}
+
+//**************************************************************************
+// send all of a buffer
+//  RETURNS: 0 for success, -1 on error
+int SinkSend(int fd, char *buf, int len)
+{
+	int n;
+
+	while (len>0)
+	{
+		n = send(fd,buf,len,MSG_NOSIGNAL);
+		if (n<=0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// print a batch as text, one sample per line.  SINKCSV is
+// "time,name,value", SINKLINE is line protocol with ns times
+//  RETURNS: length of the text, it is cut short if sz is too small
+int SinkFormat(SAMPLE *s, int n, int format, char *buf, int sz)
+{
+	int i, len = 0;
+
+	for (i=0; (i<n) && (len<sz); i++)
+	{
+		if (format==SINKLINE)
+			len += snprintf(buf+len,sz-len,"weather,name=%s value=%.15g %lld000000\n",
+							MetricName(s[i].metric),s[i].value,(long long)(s[i].dt*1000));
+		else
+			len += snprintf(buf+len,sz-len,"%.3f,%s,%.15g\n",
+							s[i].dt,MetricName(s[i].metric),s[i].value);
+	}
+	return (len<sz) ? len : sz-1;
+}
+
+//**************************************************************************
+// a sink's thread, batches its samples and writes them out
+static void *SinkThread(void *param)
+{
+	SINK *k = param;
+	SAMPLE *batch;
+	struct timespec ts;
+	time_t now, nextTry = 0;
+	int n = 0, up = 0, fails = 0, busy = 0;
+
+	batch = malloc(k->batch*sizeof(SAMPLE));
+	if (batch==NULL)
+	{
+		Log("sink> %s: no memory for a batch",k->name);
+		return 0;
+	}
+	Log("sink> %s: %s, queue %d, batch %d, flush %d sec",k->name,k->type->name,
+		k->q.mask+1,k->batch,k->flush);
+	for (;;)
+	{
+		// wait for a batch, or a second, unless the sink has work of
+		// its own.  While it is down it waits either way
+		if (!k->stop && !busy && (!up || (RingCount(&k->q)+n<k->batch)))
+		{
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_sec += 1;
+			sem_timedwait(&k->sem,&ts);
+		}
+		time(&now);
+		while ((n<k->batch) && (RingGet(&k->q,&batch[n])==0))
+		{
+			n++;
+			// dbthread is waiting for room, there is some now
+			if (__atomic_exchange_n(&k->waiting,0,__ATOMIC_ACQ_REL))
+				sem_post(&k->room);
+		}
+
+		// (re)open, but not more often than every retry seconds
+		if (!up && ((now>=nextTry) || k->stop))
+		{
+			up = (k->type->open==NULL) || (k->type->open(k)==0);
+			if (!up)
+				nextTry = now+k->retry;
+		}
+
+		if (up && (n>0) && ((n>=k->batch) || (now-batch[0].dt>=k->flush) || k->stop))
+		{
+			if (k->type->write(k,batch,n)==0)
+			{
+				k->stats.written += n;
+				k->stats.batches++;
+				if (fails>0)
+					Log("sink> %s: writing again after %d errors",k->name,fails);
+				fails = 0;
+				n = 0;
+			}
+			else
+			{
+				k->stats.errors++;
+				if (fails++==0)
+					Log("sink> %s: write failed, retrying every %d sec",k->name,k->retry);
+				if (k->type->close!=NULL)
+					k->type->close(k);
+				up = 0;
+				nextTry = now+k->retry;
+			}
+		}
+		busy = up && (k->type->idle!=NULL) && k->type->idle(k);
+
+		// on exit one last try with what is left
+		if (k->stop && ((RingCount(&k->q)==0) || !up))
+			break;
+	}
+	n += RingCount(&k->q);
+	if (n>0)
+		Log("sink> %s: %d samples not written",k->name,n);
+	if (up && (k->type->close!=NULL))
+		k->type->close(k);
+	free(batch);
+	Log("sink> %s: thread exiting",k->name);
+	return 0;
+}
+
+//**************************************************************************
+// make a sink from its section, anything not set there comes from
+// the db settings
+//  RETURNS: the sink, NULL if it can not be used
+static SINK *Make(char *name, char *deftype)
+{
+	SINK *k;
+	SINKTYPE *t = NULL;
+	char key[120], *v;
+	int i;
+
+	snprintf(key,sizeof(key),"sink.%s.type",name);
+	v = ConfigStr(key,deftype);
+	for (i=0; sinkTypes[i]!=NULL; i++)
+		if (!strcmp(sinkTypes[i]->name,v))
+			t = sinkTypes[i];
+	if (t==NULL)
+	{
+		Log("sink> %s: no sink type '%s'",name,v);
+		return NULL;
+	}
+	k = calloc(1,sizeof(SINK));
+	if (k==NULL)
+		return NULL;
+	snprintf(k->name,sizeof(k->name),"%s",name);
+	k->type = t;
+	k->fd = -1;
+	k->qsize = SinkInt(k,"queue",dbqsize,16,1<<20);
+	k->batch = SinkInt(k,"batch",dbbatch,1,1000);
+	k->flush = SinkInt(k,"flush",dbflush,1,3600);
+	k->retry = SinkInt(k,"retry",dbflush,1,3600);
+	v = SinkStr(k,"overflow","drop");
+	k->block = !strcmp(v,"block");
+	if (!k->block && strcmp(v,"drop"))
+		Log("sink> %s: overflow=%s is not drop or block, dropping",name,v);
+	k->blockWait = SinkInt(k,"blockwait",1000,0,3600000);
+	if (k->qsize<k->batch*2)
+		k->qsize = k->batch*2;
+	if (RingInit(&k->q,k->qsize,sizeof(SAMPLE)))
+	{
+		Log("sink> %s: no memory for %d samples",name,k->qsize);
+		free(k);
+		return NULL;
+	}
+	sem_init(&k->sem,0,0);
+	sem_init(&k->room,0,0);
+	if ((t->init!=NULL) && t->init(k))
+	{
+		RingFree(&k->q);
+		free(k);
+		return NULL;
+	}
+	return k;
+}
+
+//**************************************************************************
+// set up the sinks from the config, before any samples are stored
+//  RETURNS: 0 for success, 1 if there are none
+int SinkInit(void)
+{
+	char *names[MAXSINKS];
+	SINK *k;
+	int i, n;
+
+	n = ConfigSections("sink.",names,MAXSINKS);
+	for (i=0; i<n; i++)
+		if ((k = Make(names[i]+5,""))!=NULL)
+			sinks[nsinks++] = k;
+	// the database on its own when there are no sections
+	if ((n==0) && ((k = Make("mysql","mysql"))!=NULL))
+		sinks[nsinks++] = k;
+	if (nsinks==0)
+	{
+		Log("sink> no sinks, samples are only archived");
+		return 1;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// start the sink threads
+void SinkStart(void)
+{
+	int i;
+
+	for (i=0; i<nsinks; i++)
+		if (pthread_create(&sinks[i]->tid,NULL,SinkThread,sinks[i]))
+			Log("sink> %s: thread not started",sinks[i]->name);
+}
+
+//**************************************************************************
+// let each sink write what it has, then stop its thread
+void SinkStop(void)
+{
+	int i;
+
+	for (i=0; i<nsinks; i++)
+	{
+		sinks[i]->stop = 1;
+		sem_post(&sinks[i]->sem);
+	}
+	for (i=0; i<nsinks; i++)
+		if (sinks[i]->tid!=0)
+			pthread_join(sinks[i]->tid,NULL);
+}
+
+//**************************************************************************
+// overflow=block, wait for the sink's thread to make room for s
+//  RETURNS: 0 once it is queued, 1 if blockwait ran out or on shutdown
+static int SinkWait(SINK *k, SAMPLE *s)
+{
+	struct timespec ts;
+	unsigned long long left = k->blockWait*1000000ULL, step, t;
+
+	while (!dbStop)
+	{
+		// waiting is set before trying again so a take in between
+		// still posts room
+		__atomic_store_n(&k->waiting,1,__ATOMIC_RELEASE);
+		if (RingPut(&k->q,s)==0)
+			return 0;
+		if ((k->blockWait>0) && (left==0))
+			return 1;
+		sem_post(&k->sem);
+		// at most a second at a time so a shutdown is noticed
+		step = 1000000000ULL;
+		if ((k->blockWait>0) && (left<step))
+			step = left;
+		t = MonoNs();
+		clock_gettime(CLOCK_REALTIME,&ts);
+		step += ts.tv_nsec;
+		ts.tv_sec += step/1000000000ULL;
+		ts.tv_nsec = step%1000000000ULL;
+		sem_timedwait(&k->room,&ts);
+		t = MonoNs()-t;
+		left = (t<left) ? left-t : 0;
+	}
+	return 1;
+}
+
+//**************************************************************************
+// hand samples to every sink.  Only dbthread calls this
+void SinkPut(SAMPLE *s, int n)
+{
+	SINK *k;
+	int i, j, full;
+
+	for (i=0; i<nsinks; i++)
+	{
+		k = sinks[i];
+		for (j=0; j<n; j++)
+		{
+			full = RingPut(&k->q,&s[j]);
+			// a stalled sink is not waited for again until it has room
+			if (full && k->block && !k->stalled && (full = SinkWait(k,&s[j])) && !dbStop)
+			{
+				k->stalled = 1;
+				Log("sink> %s: no room for %d ms, dropping until it takes samples again",
+					k->name,k->blockWait);
+			}
+			if (full)
+				k->stats.dropped++;
+			else
+			{
+				k->stats.queued++;
+				if (k->stalled)
+				{
+					k->stalled = 0;
+					Log("sink> %s: taking samples again",k->name);
+				}
+			}
+		}
+		if (RingCount(&k->q)>=k->batch)
+			sem_post(&k->sem);
+	}
+}
+
+//**************************************************************************
+// the sinks, for the status page
+//  RETURNS: how many were put in out
+int SinkList(SINK **out, int max)
+{
+	int i;
+
+	for (i=0; (i<nsinks) && (i<max); i++)
+		out[i] = sinks[i];
+	return i;
+}
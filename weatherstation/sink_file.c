@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------
+   sink_file.c   samples appended to a local file
+	2026-10-17   initial edits
+
+	path= is the file, it is opened for append so it carries on across
+	restarts.  format=csv gives
+	"time,name,value" lines, format=line gives line protocol
+	("weather,name=outsideTemp value=51.2 <ns>").  Each batch is one
+	write and an fflush, nothing is synced.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "weatherstation.h"
+
+#define LINESIZE	100			// room for one formatted sample
+
+//**************************************************************************
+// read the settings and make the line buffer
+//  RETURNS: 0 for success, 1 on error
+static int InitFile(SINK *k)
+{
+	char *v;
+
+	snprintf(k->path,sizeof(k->path),"%s",SinkStr(k,"path",""));
+	if (k->path[0]==0)
+	{
+		Log("sink> %s: no path for the file",k->name);
+		return 1;
+	}
+	v = SinkStr(k,"format","csv");
+	k->format = !strcmp(v,"line") ? SINKLINE : SINKCSV;
+	k->bufsz = k->batch*LINESIZE;
+	k->buf = malloc(k->bufsz);
+	if (k->buf==NULL)
+		return 1;
+	return 0;
+}
+
+//**************************************************************************
+// open the file for append
+//  RETURNS: 0 for success, -1 on error
+static int OpenFile(SINK *k)
+{
+	k->f = fopen(k->path,"a");
+	if (k->f==NULL)
+	{
+		Log("sink> %s: error %d opening %s",k->name,errno,k->path);
+		return -1;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// append a batch
+//  RETURNS: 0 for success, -1 on error
+static int WriteFile(SINK *k, SAMPLE *s, int n)
+{
+	int len;
+
+	len = SinkFormat(s,n,k->format,k->buf,k->bufsz);
+	if ((fwrite(k->buf,1,len,k->f)!=len) || fflush(k->f))
+	{
+		Log("sink> %s: error %d writing %s",k->name,errno,k->path);
+		return -1;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// close the file
+static void CloseFile(SINK *k)
+{
+	if (k->f!=NULL)
+		fclose(k->f);
+	k->f = NULL;
+}
+
+SINKTYPE sinkFile = {
+	"file",
+	InitFile,
+	OpenFile,
+	WriteFile,
+	NULL,
+	CloseFile
+};
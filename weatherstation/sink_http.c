@@ -0,0 +1,91 @@
+/*---------------------------------------------------------------------------
+   sink_http.c   samples POSTed to a remote collector
+	2026-10-17   initial edits
+
+	Each batch is one HTTP/1.0 POST of line protocol to
+	http://host:port/path on a new connection, the kind of body an
+	InfluxDB style /write endpoint takes.  Any 2xx status is success,
+	anything else or no answer within timeout= seconds is a failed
+	write and the batch is tried again.
+
+	host= (localhost), port= (8086), path= (/write) and timeout= (10).
+
+	2026-10-17   format=packed posts the batch as SamplePack() gives it
+	             (pack.c), application/octet-stream, for a collector of
+	             our own.  Weather readings take around a tenth of the
+	             bytes line protocol does.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "weatherstation.h"
+
+#define LINESIZE	100			// room for one formatted sample
+#define HEADSIZE	300			// room for the request line and headers
+
+//**************************************************************************
+// read the settings and make the request buffer
+//  RETURNS: 0 for success, 1 on error
+static int InitHttp(SINK *k)
+{
+	snprintf(k->host,sizeof(k->host),"%s",SinkStr(k,"host","localhost"));
+	k->port = SinkInt(k,"port",8086,1,65535);
+	snprintf(k->path,sizeof(k->path),"%s",SinkStr(k,"path","/write"));
+	k->timeout = SinkInt(k,"timeout",10,1,300);
+	k->format = !strcmp(SinkStr(k,"format","line"),"packed") ? SINKPACKED : SINKLINE;
+	k->bufsz = (k->format==SINKPACKED) ? PACKSIZE(k->batch) : k->batch*LINESIZE;
+	k->buf = malloc(k->bufsz);
+	if (k->buf==NULL)
+		return 1;
+	return 0;
+}
+
+//**************************************************************************
+// post a batch and read the status line
+//  RETURNS: 0 for success, -1 on error
+static int WriteHttp(SINK *k, SAMPLE *s, int n)
+{
+	char head[HEADSIZE], reply[64];
+	int fd, len, hlen, got = 0, status = 0;
+
+	if (k->format==SINKPACKED)
+		len = SamplePack(s,n,(BYTE *)k->buf,k->bufsz);
+	else
+		len = SinkFormat(s,n,SINKLINE,k->buf,k->bufsz);
+	hlen = snprintf(head,sizeof(head),"POST %s HTTP/1.0\r\nHost: %s\r\n"
+					"Content-Type: %s\r\nContent-Length: %d\r\n\r\n",k->path,k->host,
+					(k->format==SINKPACKED)?"application/octet-stream":"text/plain",len);
+	fd = SinkConnect(k->host,k->port,k->timeout);
+	if (fd<0)
+		return -1;
+	if ((SinkSend(fd,head,hlen)==0) && (SinkSend(fd,k->buf,len)==0))
+		got = recv(fd,reply,sizeof(reply)-1,MSG_WAITALL);
+	close(fd);
+	if (got>0)
+	{
+		reply[got] = 0;
+		sscanf(reply,"HTTP/%*s %d",&status);
+	}
+	if ((status<200) || (status>299))
+	{
+		Log("sink> %s: POST to %s:%d%s got %s %d",k->name,k->host,k->port,k->path,
+			(got>0)?"status":"error",(got>0)?status:errno);
+		return -1;
+	}
+	return 0;
+}
+
+SINKTYPE sinkHttp = {
+	"http",
+	InitHttp,
+	NULL,
+	WriteHttp,
+	NULL,
+	NULL
+};
@@ -0,0 +1,177 @@
+/*---------------------------------------------------------------------------
+   sink_mqtt.c   samples published to an MQTT broker
+	2026-10-17   initial edits
+
+	Just enough MQTT 3.1.1 for a local broker: CONNECT with a clean
+	session, then one QoS 0 PUBLISH per sample to <topic>/<metric> with
+	the value as text, and a PINGREQ now and then so the broker keeps
+	the connection.  A batch goes out in one send.  With QoS 0 there is
+	nothing to wait for, anything the broker sends back is read and
+	thrown away.
+
+	host= (localhost), port= (1883), topic= (weather), client= (the
+	sink name) and keepalive= seconds (60).
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "weatherstation.h"
+
+#define MSGSIZE		(METRICNAMESZ+80)	// room for one PUBLISH
+
+//**************************************************************************
+// an MQTT remaining length, 7 bits a byte, low first
+//  RETURNS: bytes used
+static int PutLength(BYTE *p, int len)
+{
+	int n = 0;
+
+	do
+	{
+		p[n] = len & 0x7f;
+		len >>= 7;
+		if (len>0)
+			p[n] |= 0x80;
+		n++;
+	} while (len>0);
+	return n;
+}
+
+//**************************************************************************
+// a length prefixed string
+//  RETURNS: bytes used
+static int PutString(BYTE *p, char *s, int len)
+{
+	p[0] = len>>8;
+	p[1] = len;
+	memcpy(p+2,s,len);
+	return len+2;
+}
+
+//**************************************************************************
+// read the settings and make the send buffer
+//  RETURNS: 0 for success, 1 on error
+static int InitMqtt(SINK *k)
+{
+	snprintf(k->host,sizeof(k->host),"%s",SinkStr(k,"host","localhost"));
+	k->port = SinkInt(k,"port",1883,1,65535);
+	snprintf(k->path,sizeof(k->path),"%s",SinkStr(k,"topic","weather"));
+	k->keepalive = SinkInt(k,"keepalive",60,5,3600);
+	k->bufsz = k->batch*(MSGSIZE+strlen(k->path));
+	k->buf = malloc(k->bufsz);
+	if (k->buf==NULL)
+		return 1;
+	return 0;
+}
+
+//**************************************************************************
+// connect to the broker and wait for its CONNACK
+//  RETURNS: 0 for success, -1 on error
+static int OpenMqtt(SINK *k)
+{
+	BYTE msg[200], body[160], ack[4];
+	char *client;
+	int n, len;
+
+	k->fd = SinkConnect(k->host,k->port,5);
+	if (k->fd<0)
+		return -1;
+	client = SinkStr(k,"client",k->name);
+	n = PutString(body,"MQTT",4);
+	body[n++] = 4;								// protocol level 3.1.1
+	body[n++] = 0x02;							// clean session
+	body[n++] = k->keepalive>>8;
+	body[n++] = k->keepalive;
+	len = strlen(client);
+	if (len>100)
+		len = 100;
+	n += PutString(body+n,client,len);
+	msg[0] = 0x10;
+	len = 1+PutLength(msg+1,n);
+	memcpy(msg+len,body,n);
+	if (SinkSend(k->fd,(char *)msg,len+n) || (recv(k->fd,ack,4,MSG_WAITALL)!=4) ||
+		(ack[0]!=0x20) || (ack[3]!=0))
+	{
+		Log("sink> %s: broker %s:%d did not accept the connection",k->name,k->host,k->port);
+		close(k->fd);
+		k->fd = -1;
+		return -1;
+	}
+	k->lastSend = time(NULL);
+	Log("sink> %s: connected to broker %s:%d",k->name,k->host,k->port);
+	return 0;
+}
+
+//**************************************************************************
+// publish a batch, one message per sample
+//  RETURNS: 0 for success, -1 on error
+static int WriteMqtt(SINK *k, SAMPLE *s, int n)
+{
+	BYTE *p = (BYTE *)k->buf;
+	char topic[200], value[40];
+	int i, tlen, vlen;
+
+	for (i=0; i<n; i++)
+	{
+		tlen = snprintf(topic,sizeof(topic),"%s/%s",k->path,MetricName(s[i].metric));
+		vlen = snprintf(value,sizeof(value),"%.3f",s[i].value);
+		*p++ = 0x30;							// PUBLISH, QoS 0
+		p += PutLength(p,tlen+2+vlen);
+		p += PutString(p,topic,tlen);
+		memcpy(p,value,vlen);
+		p += vlen;
+	}
+	if (SinkSend(k->fd,k->buf,p-(BYTE *)k->buf))
+	{
+		Log("sink> %s: error %d sending to broker",k->name,errno);
+		return -1;
+	}
+	k->lastSend = time(NULL);
+	return 0;
+}
+
+//**************************************************************************
+// keep the connection alive and throw away what the broker sends
+//  RETURNS: 0, there is never more to do
+static int IdleMqtt(SINK *k)
+{
+	BYTE ping[2] = { 0xc0, 0 }, junk[64];
+
+	while (recv(k->fd,junk,sizeof(junk),MSG_DONTWAIT)>0)
+		;
+	if (time(NULL)-k->lastSend>=k->keepalive/2)
+	{
+		SinkSend(k->fd,(char *)ping,2);
+		k->lastSend = time(NULL);
+	}
+	return 0;
+}
+
+//**************************************************************************
+// say goodbye and close
+static void CloseMqtt(SINK *k)
+{
+	BYTE bye[2] = { 0xe0, 0 };
+
+	if (k->fd<0)
+		return;
+	SinkSend(k->fd,(char *)bye,2);
+	close(k->fd);
+	k->fd = -1;
+}
+
+SINKTYPE sinkMqtt = {
+	"mqtt",
+	InitMqtt,
+	OpenMqtt,
+	WriteMqtt,
+	IdleMqtt,
+	CloseMqtt
+};
@@ -0,0 +1,411 @@
+/*---------------------------------------------------------------------------
+   sink_mysql.c   the MySQL sink, data and rollup tables
+	2026-10-17   initial edits
+
+	What dbthread used to do itself, now run by the sink thread (sink.c)
+	so a slow server holds up nothing but this sink.  Each batch is one
+	multi-row insert through a server side prepared statement, with one
+	bound (dt,name,value) group per row.  A statement is prepared once
+	for each batch size seen and reused until the connection drops.
+
+	A batch the server can not take goes to the spool (spool.c), and
+	while the spool has anything in it new batches go behind it so rows
+	reach the server in time order.  Between batches the spool is
+	replayed and the closed rollup periods are inserted.
+
+	dbtype=null throws rows away instead of inserting, for benchmarks.
+	Queue-to-stored and insert times go into histPersist and histFlush.
+	A config reload with a new server or login closes the connection,
+	the next pass connects with the new one.
+
+	The connection, the spool and the rollup queue are each only used
+	from here, so there can only be one mysql sink.
+
+	TABLES: rows now carry the time they were read, not the time they
+	were inserted, so dt must take fractions of a second.  An existing
+	data table needs
+
+	  alter table data modify dt datetime(3) not null;
+
+	(or "add column dt datetime(3) not null" if it has none), and the
+	rollups need a table of their own, period m, h or d:
+
+	  create table rollup (
+	    dt      datetime(3) not null,
+	    name    varchar(32) not null,
+	    period  char(1) not null,
+	    count   bigint not null,
+	    min     double, max double, mean double, sum double,
+	    key (name,period,dt));
+
+	A new install also needs
+
+	  create table data (
+	    dt      datetime(3) not null,
+	    name    varchar(32) not null,
+	    value   varchar(32) not null,
+	    key (name,dt));
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "weatherstation.h"
+
+#define SQLROWSIZE 40		// room for one "(FROM_UNIXTIME(?),?,?)" group
+
+static SINK		*me;		// the one mysql sink
+static DBSTATS	dbstats;	// insert counters, see MysqlGetStats()
+static SAMPLE	*replay;	// batch read back from the spool
+static char		*sql;
+static MYSQL_STMT		**stmts;	// stmts[n] inserts n rows, prepared on demand
+static MYSQL_BIND		*binds;		// 3 per row
+static unsigned long	*namelen;	// bound name lengths, 1 per row
+static int		dbNull;		// dbtype=null, nothing is sent anywhere
+static MYSQL_STMT		*stmtRoll;	// inserts one rollup
+static ROLLUP	roll;		// taken from the rollup queue, not yet stored
+static int		haveRoll;
+static time_t	lastTry;	// last connect attempt
+static int		gen;		// ConfigGen() the settings are from
+
+// server is there to take rows
+#define DBUP()	(dbNull || (conn!=NULL))
+
+//**************************************************************************
+// drop all prepared statements, needed when the connection goes away
+static void CloseStatements(void)
+{
+	int i;
+
+	for (i=0; i<=me->batch; i++)
+	{
+		if (stmts[i]!=NULL)
+			mysql_stmt_close(stmts[i]);
+		stmts[i] = NULL;
+	}
+	if (stmtRoll!=NULL)
+		mysql_stmt_close(stmtRoll);
+	stmtRoll = NULL;
+}
+
+//**************************************************************************
+// close the connection, the next pass makes a new one
+static void Disconnect(void)
+{
+	CloseStatements();
+	if (conn!=NULL)
+		mysql_close(conn);
+	conn = NULL;
+}
+
+//**************************************************************************
+// get the insert statement for n rows, preparing it the first time
+static MYSQL_STMT *GetStatement(int n)
+{
+	MYSQL_STMT *st;
+	char *p;
+	int i;
+
+	if (stmts[n]!=NULL)
+		return stmts[n];
+	p = sql;
+	p += sprintf(p,"insert into data (dt,name,value) VALUES ");
+	for (i=0; i<n; i++)
+		p += sprintf(p,"%s(FROM_UNIXTIME(?),?,?)",(i>0)?",":"");
+	st = mysql_stmt_init(conn);
+	if (st==NULL)
+		return NULL;
+	if (mysql_stmt_prepare(st,sql,strlen(sql)))
+	{
+		Log("mysql> prepare for %d rows failed, errno = %u:   %s",
+					n,mysql_stmt_errno(st),mysql_stmt_error(st));
+		mysql_stmt_close(st);
+		return NULL;
+	}
+	stmts[n] = st;
+	return st;
+}
+
+//**************************************************************************
+// send a batch as one insert
+//  RETURNS: 0 for success, 1 on error
+static int FlushBatch(SAMPLE *batch, int nbatch)
+{
+	MYSQL_STMT *st;
+	MYSQL_BIND *b;
+	int i, err;
+	long usec;
+	unsigned long long done;
+	struct timeval t0, t1;
+
+	if (nbatch==0)
+		return 0;
+	if (!DBUP())
+		return 1;
+	gettimeofday(&t0,NULL);
+	err = 1;
+	st = dbNull ? NULL : GetStatement(nbatch);
+	if (dbNull)
+		err = 0;
+	else if (st!=NULL)
+	{
+		// bind the batch rows in place
+		memset(binds,0,3*nbatch*sizeof(MYSQL_BIND));
+		for (i=0; i<nbatch; i++)
+		{
+			b = &binds[3*i];
+			b[0].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[0].buffer = &batch[i].dt;
+			b[1].buffer_type = MYSQL_TYPE_STRING;
+			b[1].buffer = MetricName(batch[i].metric);
+			namelen[i] = strlen(b[1].buffer);
+			b[1].buffer_length = namelen[i];
+			b[1].length = &namelen[i];
+			b[2].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[2].buffer = &batch[i].value;
+		}
+		if (mysql_stmt_bind_param(st,binds) || mysql_stmt_execute(st))
+			Log("mysql> insert of %d rows failed, errno = %u:   %s",
+						nbatch,mysql_stmt_errno(st),mysql_stmt_error(st));
+		else
+			err = 0;
+	}
+	if (err)
+	{
+		dbstats.errors++;
+		// force a reconnect before the next try
+		Disconnect();
+		return 1;
+	}
+	gettimeofday(&t1,NULL);
+	usec = (t1.tv_sec-t0.tv_sec)*1000000L + (t1.tv_usec-t0.tv_usec);
+	dbstats.lastLatency = usec;
+	if (usec>dbstats.maxLatency)
+		dbstats.maxLatency = usec;
+	dbstats.totalLatency += usec;
+	dbstats.flushes++;
+	dbstats.rows += nbatch;
+	HistAdd(&histFlush,usec*1000ULL);
+	done = MonoNs();
+	for (i=0; i<nbatch; i++)
+		if (batch[i].tq!=0)
+			HistAdd(&histPersist,done-batch[i].tq);
+	LogDbg("mysql> stored %d rows in %ld usec",nbatch,usec);
+	return 0;
+}
+
+//**************************************************************************
+// store the closed rollup periods that are waiting
+//  RETURNS: 0 for success, 1 on error (the one that failed is kept)
+static int FlushRollups(void)
+{
+	MYSQL_BIND b[8];
+	unsigned long len;
+	long long count;
+	double mean;
+	int n = 0;
+	char *sql = "insert into rollup (dt,name,period,count,min,max,mean,sum) "
+				"VALUES (FROM_UNIXTIME(?),?,?,?,?,?,?,?)";
+
+	// a few at a time so a backlog does not hold up the samples
+	while (DBUP() && (n++<100) && (haveRoll || (RollupGet(&roll)==0)))
+	{
+		haveRoll = 1;
+		if (!dbNull)
+		{
+			if (stmtRoll==NULL)
+			{
+				stmtRoll = mysql_stmt_init(conn);
+				if ((stmtRoll!=NULL) && mysql_stmt_prepare(stmtRoll,sql,strlen(sql)))
+				{
+					Log("mysql> prepare for rollup failed, errno = %u:   %s",
+								mysql_stmt_errno(stmtRoll),mysql_stmt_error(stmtRoll));
+					mysql_stmt_close(stmtRoll);
+					stmtRoll = NULL;
+				}
+				if (stmtRoll==NULL)
+					return 1;
+			}
+			count = roll.count;
+			mean = roll.sum/roll.count;
+			memset(b,0,sizeof(b));
+			b[0].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[0].buffer = &roll.start;
+			b[1].buffer_type = MYSQL_TYPE_STRING;
+			b[1].buffer = MetricName(roll.metric);
+			len = strlen(b[1].buffer);
+			b[1].buffer_length = len;
+			b[1].length = &len;
+			b[2].buffer_type = MYSQL_TYPE_STRING;
+			b[2].buffer = RollupPeriodName(roll.period);
+			b[2].buffer_length = 1;
+			b[3].buffer_type = MYSQL_TYPE_LONGLONG;
+			b[3].buffer = &count;
+			b[4].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[4].buffer = &roll.min;
+			b[5].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[5].buffer = &roll.max;
+			b[6].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[6].buffer = &mean;
+			b[7].buffer_type = MYSQL_TYPE_DOUBLE;
+			b[7].buffer = &roll.sum;
+			if (mysql_stmt_bind_param(stmtRoll,b) || mysql_stmt_execute(stmtRoll))
+			{
+				Log("mysql> rollup insert failed, errno = %u:   %s",
+							mysql_stmt_errno(stmtRoll),mysql_stmt_error(stmtRoll));
+				dbstats.errors++;
+				Disconnect();
+				return 1;
+			}
+		}
+		dbstats.rollups++;
+		haveRoll = 0;
+	}
+	return 0;
+}
+
+//**************************************************************************
+// pick up the database settings after a config reload
+//  RETURNS: 1 if any of them changed
+static int DbSettings(void)
+{
+	char host[sizeof(dbhost)], db[sizeof(dbdatabase)], user[sizeof(dbuser)], pass[sizeof(dbpass)];
+
+	ConfigCopy("dbhost","localhost",host,sizeof(host));
+	ConfigCopy("database","weather",db,sizeof(db));
+	ConfigCopy("dbuser","ted",user,sizeof(user));
+	ConfigCopy("dbpass","secret",pass,sizeof(pass));
+	if (!strcmp(host,dbhost) && !strcmp(db,dbdatabase) &&
+		!strcmp(user,dbuser) && !strcmp(pass,dbpass))
+		return 0;
+	strcpy(dbhost,host);
+	strcpy(dbdatabase,db);
+	strcpy(dbuser,user);
+	strcpy(dbpass,pass);
+	return 1;
+}
+
+//**************************************************************************
+// (re)connect, but not more often than every retry seconds
+static void Connect(SINK *k)
+{
+	time_t now;
+
+	time(&now);
+	if (!DBUP() && ((now-lastTry)>=k->retry) && !k->stop)
+	{
+		lastTry = now;
+		ConnectToDb();
+	}
+}
+
+//**************************************************************************
+// set up the statement cache and the spool
+//  RETURNS: 0 for success, 1 on error
+static int InitMysql(SINK *k)
+{
+	if (me!=NULL)
+	{
+		Log("mysql> %s: there is already a mysql sink, %s",k->name,me->name);
+		return 1;
+	}
+	replay = malloc(k->batch*sizeof(SAMPLE));
+	sql = malloc(k->batch*SQLROWSIZE+100);
+	stmts = calloc(k->batch+1,sizeof(MYSQL_STMT*));
+	binds = calloc(k->batch*3,sizeof(MYSQL_BIND));
+	namelen = calloc(k->batch,sizeof(unsigned long));
+	if ((replay==NULL)||(sql==NULL)||(stmts==NULL)||(binds==NULL)||(namelen==NULL))
+	{
+		Log("mysql> no memory for batch of %d",k->batch);
+		return 1;
+	}
+	dbNull = !strcmp(dbtype,"null");
+	gen = ConfigGen();
+	SpoolInit(spooldir,spoolmax);
+	me = k;
+	return 0;
+}
+
+//**************************************************************************
+// insert a batch, or spool it if the server is not there or older
+// rows are still waiting
+//  RETURNS: 0 for success, -1 if it could not be stored or spooled
+static int WriteMysql(SINK *k, SAMPLE *s, int n)
+{
+	Connect(k);
+	if (!DBUP() || (SpoolPending()>0) || FlushBatch(s,n))
+		return SpoolWrite(s,n) ? -1 : 0;
+	return 0;
+}
+
+//**************************************************************************
+// between batches: settings, the spool and the rollups
+//  RETURNS: 1 while the spool has more to replay
+static int IdleMysql(SINK *k)
+{
+	int i, n;
+
+	// new server or login after a config reload, drop the old
+	// connection and let Connect() make one
+	if (ConfigGen()!=gen)
+	{
+		gen = ConfigGen();
+		if (DbSettings() && !dbNull && (conn!=NULL))
+		{
+			Log("mysql> database settings changed, reconnecting");
+			Disconnect();
+			lastTry = 0;
+		}
+	}
+	Connect(k);
+
+	// replay the spool a few batches at a time while the server is up
+	for (i=0; (i<50) && DBUP() && !k->stop; i++)
+	{
+		n = SpoolRead(replay,k->batch);
+		if (n==0)
+			break;
+		if (FlushBatch(replay,n))
+			break;		// still in the spool, try again later
+		SpoolAck();
+		if (SpoolPending()==0)
+			Log("mysql> spool replay complete");
+	}
+	FlushRollups();
+	return DBUP() && !k->stop && (SpoolPending()>0);
+}
+
+//**************************************************************************
+// drop the connection
+static void CloseMysql(SINK *k)
+{
+	if (k->stop && (haveRoll+RollupPending()>0))
+		Log("mysql> %d rollups not stored",haveRoll+RollupPending());
+	Disconnect();
+}
+
+//**************************************************************************
+// copy the insert counters
+void MysqlGetStats(DBSTATS *out)
+{
+	out->rows = dbstats.rows;
+	out->flushes = dbstats.flushes;
+	out->errors = dbstats.errors;
+	out->lastLatency = dbstats.lastLatency;
+	out->maxLatency = dbstats.maxLatency;
+	out->totalLatency = dbstats.totalLatency;
+	out->rollups = dbstats.rollups;
+}
+
+SINKTYPE sinkMysql = {
+	"mysql",
+	InitMysql,
+	NULL,
+	WriteMysql,
+	IdleMysql,
+	CloseMysql
+};
@@ -0,0 +1,68 @@
+/*---------------------------------------------------------------------------
+   snapread.c   read side of the current conditions snapshot
+	2026-10-17   initial edits
+
+	Readers never lock anything.  SnapRead() copies the whole struct
+	and checks the sequence counter did not move and was even, which
+	means no write overlapped the copy.  Nothing here calls back into
+	the daemon so other programs can link it on its own.
+
+---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "weatherstation.h"
+
+//**************************************************************************
+// map the snapshot the daemon writes, name is usually SNAPNAME
+//  RETURNS: the snapshot, or NULL if it is not there or not this version
+SNAPSHOT *SnapOpen(char *name)
+{
+	SNAPSHOT *s;
+	int fd;
+
+	fd = shm_open(name,O_RDONLY,0);
+	if (fd<0)
+		return NULL;
+	s = mmap(NULL,sizeof(SNAPSHOT),PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if (s==MAP_FAILED)
+		return NULL;
+	if ((s->version!=SNAPVERSION)||(s->size!=sizeof(SNAPSHOT)))
+	{
+		munmap(s,sizeof(SNAPSHOT));
+		return NULL;
+	}
+	return s;
+}
+
+//**************************************************************************
+// take a consistent copy of the snapshot
+//  RETURNS: 0 for success, 1 if a write never finished (writer died)
+int SnapRead(SNAPSHOT *s, SNAPSHOT *out)
+{
+	unsigned int s0, s1;
+	int tries;
+
+	for (tries=0; tries<100000; tries++)
+	{
+		s0 = __atomic_load_n(&s->seq,__ATOMIC_ACQUIRE);
+		if ((s0&1)==0)
+		{
+			memcpy(out,s,sizeof(SNAPSHOT));
+			// the copy must be done before the count is checked again
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			s1 = __atomic_load_n(&s->seq,__ATOMIC_RELAXED);
+			if (s0==s1)
+				return 0;
+		}
+		if (tries>=100)
+			sched_yield();
+	}
+	return 1;
+}
@@ -0,0 +1,111 @@
+/*---------------------------------------------------------------------------
+   snapshot.c   current conditions in shared memory
+	2026-10-17   initial edits
+
+	The sensor threads publish what they have just measured into one
+	SNAPSHOT in POSIX shared memory (/dev/shm/weatherstation), so an
+	LCD driver, a dashboard or a shell script can see current
+	conditions without asking MySQL.  Writers bracket their updates
+	with SnapBegin() and SnapEnd(), which bump a sequence counter
+	before and after; readers (snapread.c) copy the struct and try
+	again if the counter was odd or changed meanwhile.  A reader never
+	holds anything a writer waits on.  The writers take a mutex among
+	themselves, it is only ever held for a handful of stores.
+
+	If the shared memory can not be set up the snapshot is kept in
+	process memory so the threads carry on the same way.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "weatherstation.h"
+
+static SNAPSHOT			localSnap;			// used if shm is not there
+static SNAPSHOT			*snap = &localSnap;
+static pthread_mutex_t	snapLock = PTHREAD_MUTEX_INITIALIZER;	// writers only
+
+//**************************************************************************
+// put the snapshot in shared memory, call before the threads start
+//  RETURNS: 0 for success, 1 if only this process can see it
+int SnapInit(void)
+{
+	SNAPSHOT *s;
+	int fd;
+
+	localSnap.version = SNAPVERSION;
+	localSnap.size = sizeof(SNAPSHOT);
+	localSnap.pid = getpid();
+	localSnap.started = TimeNow();
+	fd = shm_open(SNAPNAME,O_CREAT|O_RDWR,0644);
+	if (fd<0)
+	{
+		Log("snapshot> error %d opening %s, not shared",errno,SNAPNAME);
+		return 1;
+	}
+	if (ftruncate(fd,sizeof(SNAPSHOT)))
+	{
+		Log("snapshot> error %d sizing %s, not shared",errno,SNAPNAME);
+		close(fd);
+		return 1;
+	}
+	s = mmap(NULL,sizeof(SNAPSHOT),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if (s==MAP_FAILED)
+	{
+		Log("snapshot> error %d mapping %s, not shared",errno,SNAPNAME);
+		return 1;
+	}
+	// readers may still be looking at the last run's values
+	pthread_mutex_lock(&snapLock);
+	__atomic_store_n(&s->seq,s->seq|1,__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&s->version,&localSnap.version,sizeof(SNAPSHOT)-sizeof(s->seq));
+	__atomic_store_n(&s->seq,s->seq+1,__ATOMIC_RELEASE);
+	snap = s;
+	pthread_mutex_unlock(&snapLock);
+	Log("snapshot> /dev/shm%s",SNAPNAME);
+	return 0;
+}
+
+//**************************************************************************
+// mark the snapshot as no longer being updated
+void SnapClose(void)
+{
+	SnapBegin()->pid = 0;
+	SnapEnd();
+}
+
+//**************************************************************************
+// start an update, set the fields then call SnapEnd()
+SNAPSHOT *SnapBegin(void)
+{
+	pthread_mutex_lock(&snapLock);
+	__atomic_store_n(&snap->seq,snap->seq+1,__ATOMIC_RELAXED);
+	// the odd count must be seen before any of the new values
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return snap;
+}
+
+//**************************************************************************
+// finish an update
+void SnapEnd(void)
+{
+	snap->updated = TimeNow();
+	__atomic_store_n(&snap->seq,snap->seq+1,__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&snapLock);
+}
+
+//**************************************************************************
+// the snapshot, for readers in this process (use SnapRead())
+SNAPSHOT *SnapLocal(void)
+{
+	return snap;
+}
@@ -0,0 +1,499 @@
+/*---------------------------------------------------------------------------
+   spool.c   local store and forward for samples MySQL can not take
+	2026-10-17   initial edits
+
+	Samples are appended to numbered segment files in spooldir, each
+	record carrying its own crc.  A segment is at most SPOOLSEGSIZE
+	bytes, the oldest segment is deleted when the spool would grow past
+	spoolmax megabytes.  The read position is kept in spool.pos so a
+	restart carries on where the last replay stopped.  A crash between
+	an insert and the position update can replay that one batch twice,
+	but nothing is lost.
+
+	Only the mysql sink (sink_mysql.c) calls these functions so there is
+	no locking.
+
+	2026-10-17   a record is now a whole SpoolWrite() packed with
+	             SamplePack() (pack.c), so times are kept to the ms.
+	             Records vary in size and the read position is a byte
+	             offset plus the samples of that record already sent.
+
+---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "weatherstation.h"
+
+#define SPOOLSEGSIZE	(1024*1024)		// segment files roll over past this
+#define SPOOLMAGIC		0x57535032		// "WSP2"
+#define SPOOLRECMAX		4096			// most samples in one record
+
+// record header, the packed samples follow
+typedef struct {
+	uint32_t	magic;
+	uint32_t	crc;					// crc32 of the rest of the record
+	uint32_t	len;					// bytes of packed samples
+	uint32_t	count;					// samples in them
+} SPOOLHDR;
+
+#define HDRSIZE		((int)sizeof(SPOOLHDR))
+
+// read position, saved in spool.pos
+typedef struct {
+	unsigned int	seg;
+	unsigned int	off;				// byte offset of the record
+	unsigned int	sub;				// samples of it already replayed
+} SPOOLPOS;
+
+static char			spoolDir[100];
+static unsigned int	maxSegs;
+static unsigned int	firstSeg, lastSeg;	// segments on disk
+static int			wfd = -1;			// open for append, lastSeg
+static unsigned int	wsize;				// bytes in lastSeg
+static BYTE			*wbuf;				// record being written
+static int			rfd = -1;			// open for read, pos.seg
+static unsigned int	rsize;				// bytes in pos.seg
+static BYTE			*rbuf;				// record being read
+static SAMPLE		*rsamples;			// and its samples
+static int			rmax;				// room in rbuf and rsamples
+static SPOOLPOS		pos;				// next sample to replay
+static int			posfd = -1;
+static SPOOLPOS		readEnd;			// sample after last SpoolRead()
+static int			readTaken;			// samples in last SpoolRead()
+static int			readSkip;			// bad records in last SpoolRead()
+static int			readLost;			// samples in those
+static int			pending;			// samples not yet replayed
+static SPOOLSTATS	spoolstats;
+
+//**************************************************************************
+static void SegName(unsigned int seg, char *out)
+{
+	sprintf(out,"%s/%010u.spl",spoolDir,seg);
+}
+
+//**************************************************************************
+// save the read position
+static void SavePos(void)
+{
+	if (posfd>=0)
+		pwrite(posfd,&pos,sizeof(pos),0);
+}
+
+//**************************************************************************
+// walk the record headers of a segment from byte off, without checking
+// the crcs.  end is set to the end of the last whole record
+//  RETURNS: samples in the records
+static int ScanSeg(unsigned int seg, unsigned int off, unsigned int *end)
+{
+	char fname[120];
+	struct stat st;
+	SPOOLHDR h;
+	int fd, n = 0;
+
+	*end = off;
+	SegName(seg,fname);
+	fd = open(fname,O_RDONLY);
+	if (fd<0)
+		return 0;
+	fstat(fd,&st);
+	while (pread(fd,&h,HDRSIZE,off)==HDRSIZE)
+	{
+		if ((h.magic!=SPOOLMAGIC) || (off+HDRSIZE+(off_t)h.len>st.st_size))
+			break;
+		n += h.count;
+		off += HDRSIZE+h.len;
+	}
+	close(fd);
+	*end = off;
+	return n;
+}
+
+//**************************************************************************
+// open segment for appending, cut off any torn record at the end
+static int OpenWrite(unsigned int seg)
+{
+	char fname[120];
+	struct stat st;
+
+	SegName(seg,fname);
+	wfd = open(fname,O_WRONLY|O_CREAT,0644);
+	if (wfd<0)
+	{
+		Log("spool> error %d opening %s",errno,fname);
+		return 1;
+	}
+	fstat(wfd,&st);
+	ScanSeg(seg,0,&wsize);
+	if (st.st_size!=wsize)
+	{
+		Log("spool> dropping partial record at end of %s",fname);
+		ftruncate(wfd,wsize);
+	}
+	lseek(wfd,wsize,SEEK_SET);
+	return 0;
+}
+
+//**************************************************************************
+// delete the oldest segment, moving the read position past it if needed
+static void DropFirst(void)
+{
+	char fname[120];
+	unsigned int end;
+	int lost;
+
+	if (pos.seg==firstSeg)
+	{
+		if (rfd>=0) close(rfd);
+		rfd = -1;
+		lost = ScanSeg(firstSeg,pos.off,&end) - pos.sub;
+		if (lost>0)
+		{
+			spoolstats.dropped += lost;
+			pending -= lost;
+		}
+		pos.seg = firstSeg+1;
+		pos.off = pos.sub = 0;
+		SavePos();
+	}
+	SegName(firstSeg,fname);
+	unlink(fname);
+	firstSeg++;
+}
+
+//**************************************************************************
+// make sure the read buffers hold a record of len bytes and n samples
+//  RETURNS: 0 for success, 1 on error
+static int ReadRoom(int len, int n)
+{
+	BYTE *b;
+	SAMPLE *s;
+
+	if ((len<=rmax) && (n<=rmax))
+		return 0;
+	if (n>len) len = n;
+	b = realloc(rbuf,len);
+	if (b!=NULL) rbuf = b;
+	s = realloc(rsamples,len*sizeof(SAMPLE));
+	if (s!=NULL) rsamples = s;
+	if ((b==NULL) || (s==NULL))
+		return 1;
+	rmax = len;
+	return 0;
+}
+
+//**************************************************************************
+// find the segments left from the last run
+//  dir empty disables spooling
+//  RETURNS: 0 for success, 1 on error
+int SpoolInit(char *dir, int maxmb)
+{
+	DIR *d;
+	struct dirent *e;
+	unsigned int seg, end;
+	char fname[120];
+	int n = 0;
+
+	if ((dir==NULL)||(dir[0]==0))
+	{
+		Log("spool> disabled");
+		return 1;
+	}
+	strncpy(spoolDir,dir,sizeof(spoolDir)-1);
+	mkdir(spoolDir,0755);
+	maxSegs = ((long)maxmb*1024*1024)/SPOOLSEGSIZE;
+	if (maxSegs<2)
+		maxSegs = 2;
+	wbuf = malloc(HDRSIZE+PACKSIZE(SPOOLRECMAX));
+	if (wbuf==NULL)
+	{
+		spoolDir[0] = 0;
+		return 1;
+	}
+
+	d = opendir(spoolDir);
+	if (d==NULL)
+	{
+		Log("spool> error %d opening %s",errno,spoolDir);
+		spoolDir[0] = 0;
+		return 1;
+	}
+	firstSeg = 0xFFFFFFFF;
+	lastSeg = 0;
+	while ((e = readdir(d))!=NULL)
+	{
+		if ((strlen(e->d_name)!=14)||(sscanf(e->d_name,"%10u.spl",&seg)!=1))
+			continue;
+		if (seg<firstSeg) firstSeg = seg;
+		if (seg>lastSeg) lastSeg = seg;
+		n++;
+	}
+	closedir(d);
+	if (n==0)
+		firstSeg = lastSeg = 0;
+
+	// where the last replay stopped
+	sprintf(fname,"%s/spool.pos",spoolDir);
+	posfd = open(fname,O_RDWR|O_CREAT,0644);
+	memset(&pos,0,sizeof(pos));
+	n = (posfd<0) ? 0 : pread(posfd,&pos,sizeof(pos),0);
+	if (n!=sizeof(pos))
+		memset(&pos,0,sizeof(pos));
+	if ((pos.seg<firstSeg)||(pos.seg>lastSeg))
+	{
+		pos.seg = firstSeg;
+		pos.off = pos.sub = 0;
+	}
+
+	if (OpenWrite(lastSeg))
+	{
+		spoolDir[0] = 0;
+		return 1;
+	}
+
+	// count what is left to send
+	pending = -pos.sub;
+	for (seg=pos.seg; seg<=lastSeg; seg++)
+		pending += ScanSeg(seg,(seg==pos.seg)?pos.off:0,&end);
+	if (pending<0)
+		pending = 0;
+	spoolstats.segments = lastSeg-firstSeg+1;
+	Log("spool> %s  segments %u-%u, %d samples waiting",
+				spoolDir,firstSeg,lastSeg,SpoolPending());
+	return 0;
+}
+
+//**************************************************************************
+// append samples, synced to disk before returning
+//  RETURNS: 0 for success, 1 on error
+int SpoolWrite(SAMPLE *s, int n)
+{
+	SPOOLHDR *h = (SPOOLHDR *)wbuf;
+	int i, cnt, len;
+
+	if (spoolDir[0]==0)
+		return 1;
+	i = 0;
+	while (i<n)
+	{
+		// start a new segment when this one is full
+		if (wsize>=SPOOLSEGSIZE)
+		{
+			fdatasync(wfd);
+			close(wfd);
+			lastSeg++;
+			if (OpenWrite(lastSeg))
+				return 1;
+			while (lastSeg-firstSeg+1>maxSegs)
+				DropFirst();
+		}
+		cnt = n-i;
+		if (cnt>SPOOLRECMAX) cnt = SPOOLRECMAX;
+		len = SamplePack(s+i,cnt,wbuf+HDRSIZE,PACKSIZE(SPOOLRECMAX));
+		if (len<0)
+		{
+			spoolstats.errors++;
+			return 1;
+		}
+		h->magic = SPOOLMAGIC;
+		h->len = len;
+		h->count = cnt;
+		h->crc = Crc32(&h->len,HDRSIZE-8+len);
+		len += HDRSIZE;
+		if (write(wfd,wbuf,len)!=len)
+		{
+			Log("spool> write error %d",errno);
+			spoolstats.errors++;
+			// cut off whatever part made it
+			ftruncate(wfd,wsize);
+			lseek(wfd,wsize,SEEK_SET);
+			return 1;
+		}
+		wsize += len;
+		i += cnt;
+		pending += cnt;
+		spoolstats.written += cnt;
+	}
+	fdatasync(wfd);
+	spoolstats.segments = lastSeg-firstSeg+1;
+	return 0;
+}
+
+//**************************************************************************
+// number of samples not yet replayed
+int SpoolPending(void)
+{
+	if (spoolDir[0]==0)
+		return 0;
+	return pending;
+}
+
+//**************************************************************************
+// delete segments the read position has moved past
+static void DropDone(void)
+{
+	char fname[120];
+
+	while (firstSeg<pos.seg)
+	{
+		SegName(firstSeg,fname);
+		unlink(fname);
+		firstSeg++;
+	}
+	spoolstats.segments = lastSeg-firstSeg+1;
+}
+
+//**************************************************************************
+// read and unpack the record at byte off of the open segment.  len is set
+// to its size on disk, or to 0 if the rest of the segment can not be
+// walked.  lost is set to the samples in a bad record
+//  RETURNS: number of samples, -1 for a bad record
+static int ReadRecord(unsigned int off, unsigned int end, unsigned int *len, int *lost)
+{
+	SPOOLHDR h;
+	int n;
+
+	*len = 0;
+	*lost = 0;
+	if ((off+HDRSIZE>end) || (pread(rfd,&h,HDRSIZE,off)!=HDRSIZE))
+		return -1;
+	if ((h.magic!=SPOOLMAGIC) || (h.len>end-off-HDRSIZE))
+		return -1;
+	*len = HDRSIZE+h.len;
+	*lost = h.count;
+	if ((h.count>h.len*8) || ReadRoom(HDRSIZE+h.len,h.count) ||
+		(pread(rfd,rbuf,*len,off)!=*len) ||
+		(((SPOOLHDR *)rbuf)->crc!=Crc32(rbuf+8,*len-8)))
+		return -1;
+	n = SampleUnpack(rbuf+HDRSIZE,h.len,rsamples,h.count);
+	if (n!=h.count)
+		return -1;
+	return n;
+}
+
+//**************************************************************************
+// get up to max of the oldest samples without removing them,
+// SpoolAck() removes them once they are stored
+//  RETURNS: number of samples in s
+int SpoolRead(SAMPLE *s, int max)
+{
+	char fname[120];
+	struct stat st;
+	unsigned int end, len;
+	int n = 0, got, take, lost;
+
+	if (spoolDir[0]==0)
+		return 0;
+	readTaken = readSkip = readLost = 0;
+	do
+	{
+		// move on to the next segment when this one is done.  The size
+		// is looked at each time since the writer may have been in it
+		if (rfd>=0)
+		{
+			fstat(rfd,&st);
+			rsize = st.st_size;
+		}
+		if ((pos.seg<lastSeg) && (rfd>=0) && (pos.off>=rsize))
+		{
+			close(rfd);
+			rfd = -1;
+			pos.seg++;
+			pos.off = pos.sub = 0;
+			SavePos();
+			DropDone();
+		}
+		if (rfd<0)
+		{
+			SegName(pos.seg,fname);
+			rfd = open(fname,O_RDONLY);
+			if (rfd<0)
+			{
+				if (pos.seg>=lastSeg)
+					return 0;
+				// segment went missing, move on
+				pos.seg++;
+				pos.off = pos.sub = 0;
+				SavePos();
+				DropDone();
+				continue;
+			}
+			fstat(rfd,&st);
+			rsize = st.st_size;
+		}
+		end = (pos.seg<lastSeg) ? rsize : wsize;
+		readEnd = pos;
+		while ((n<max) && (readEnd.off<end))
+		{
+			got = ReadRecord(readEnd.off,end,&len,&lost);
+			if (got<0)
+			{
+				// pass over it, or the rest of the segment if it can not
+				// be walked
+				readSkip++;
+				readLost += lost-readEnd.sub;
+				readEnd.off = (len>0) ? readEnd.off+len : end;
+				readEnd.sub = 0;
+				continue;
+			}
+			take = got-readEnd.sub;
+			if (take>max-n)
+				take = max-n;
+			memcpy(s+n,rsamples+readEnd.sub,take*sizeof(SAMPLE));
+			n += take;
+			readTaken += take;
+			readEnd.sub += take;
+			if (readEnd.sub>=got)
+			{
+				readEnd.off += len;
+				readEnd.sub = 0;
+			}
+		}
+		// nothing but bad records, pass over them and try again
+		if ((n==0) && (readEnd.off>pos.off))
+			SpoolAck();
+	} while ((n==0) && (pos.seg<lastSeg));
+	return n;
+}
+
+//**************************************************************************
+// the samples from the last SpoolRead() are stored, move past them
+void SpoolAck(void)
+{
+	spoolstats.replayed += readTaken;
+	spoolstats.corrupt += readSkip;
+	pending -= readTaken+readLost;
+	if (pending<0)
+		pending = 0;
+	readTaken = readSkip = readLost = 0;
+	pos = readEnd;
+	// all caught up, start a fresh segment so the old one can go
+	if ((pos.seg==lastSeg) && (pos.off>=wsize) && (wsize>0))
+	{
+		if (rfd>=0) close(rfd);
+		rfd = -1;
+		close(wfd);
+		lastSeg++;
+		OpenWrite(lastSeg);
+		pos.seg = lastSeg;
+		pos.off = pos.sub = 0;
+	}
+	SavePos();
+	DropDone();
+}
+
+//**************************************************************************
+// copy the counters for reporting
+void SpoolGetStats(SPOOLSTATS *out)
+{
+	memcpy(out,&spoolstats,sizeof(SPOOLSTATS));
+	out->pending = SpoolPending();
+}
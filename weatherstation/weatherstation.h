@@ -14,27 +14,741 @@
 #define RAIN_PIN 4
 #define HEARTBEAT_PIN 11
 
+#include <time.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include "mysql.h"
 #include "mysqld_error.h"
 
+#define MAXMETRICS		128					// distinct metric names
+#define METRICNAMESZ	32
+
+#define SAMPLE_VALUE	0				// stored, archived and rolled up
+#define SAMPLE_RAW		1				// archived and rolled up, the minute
+										// mean is stored instead
+#define SAMPLE_MEAN		2				// that minute mean, stored only
+
+// one queued database sample
+typedef struct {
+	int			metric;					// id from MetricId()
+	int			kind;					// SAMPLE_xxx
+	double		value;
+	double		dt;						// unix time the sample was taken
+	unsigned long long	tq;				// MonoNs() when queued, 0 if unknown
+} SAMPLE;
+
+#define ROLLPERIODS		3				// minute, hour and day
+#define ROLLGRACE		5				// seconds a period stays open for
+										// samples still in the queue
+
+// min, max, count and sum of one metric over one period, see rollup.c
+typedef struct {
+	int			metric;
+	int			period;					// 0 minute, 1 hour, 2 day
+	double		start;					// unix time the period began
+	long		count;
+	double		min;
+	double		max;
+	double		sum;
+} ROLLUP;
+
+#define HISTBUCKETS		1024
+
+// latency histogram, see histogram.c
+typedef struct {
+	unsigned long long	count[HISTBUCKETS];
+	unsigned long long	total;
+	unsigned long long	sum;
+	unsigned long long	max;
+} HISTOGRAM;
+
+// lock-free queue, see ring.c
+typedef struct {
+	unsigned int	mask;				// slots-1, slots is a power of 2
+	int				slotsize;
+	unsigned int	head;				// next slot to put
+	unsigned int	tail;				// next slot to get
+	unsigned int	*seq;				// per slot sequence numbers
+	char			*data;
+} RING;
+
+// database writer counters, see dbthread.c and sink_mysql.c
+typedef struct {
+	unsigned long	queued;				// samples accepted
+	unsigned long	dropped;			// samples lost because queue was full
+	unsigned long	rows;				// rows inserted
+	unsigned long	flushes;			// successful inserts
+	unsigned long	errors;				// failed inserts
+	long			lastLatency;		// usec for last insert
+	long			maxLatency;			// usec for slowest insert
+	long long		totalLatency;		// usec for all inserts
+	int				depth;				// samples waiting now
+	unsigned long	rollups;			// rollup rows inserted
+	unsigned long	rollupsDropped;		// rollups lost, too many waiting
+} DBSTATS;
+
+// spool counters, see spool.c
+typedef struct {
+	unsigned long	written;			// samples put in the spool
+	unsigned long	replayed;			// samples sent on to the server
+	unsigned long	dropped;			// lost to the size limit
+	unsigned long	corrupt;			// bad records skipped
+	unsigned long	errors;				// write errors
+	int				segments;			// segment files on disk
+	int				pending;			// samples waiting
+} SPOOLSTATS;
+
+// compressed series writer, see gorilla.c
+typedef struct {
+	BYTE			*buf;
+	int				size;				// bytes in buf
+	int				bits;				// bits written
+	int				count;				// samples written
+	long long		t;					// last time, ms
+	long long		delta;				// step to it
+	unsigned long long	v;				// last value's bits
+	int				lead, trail;		// xor window, lead -1 for none
+} GORILLA;
+
+// and its reader
+typedef struct {
+	const BYTE		*buf;
+	int				size;
+	int				bits;				// bits read
+	int				count;				// samples in the stream
+	int				n;					// samples read
+	long long		t;
+	long long		delta;
+	unsigned long long	v;
+	int				lead, trail;
+} GORILLAREAD;
+
+#define ARCHMAGIC		0x57534132		// "WSA2"
+#define ARCHBLOCK		4096			// samples per block
+#define ARCHHDRSZ		4096			// header page in front of the blocks
+#define ARCHBLKSZ		(ARCHBLOCK*16)	// bytes per raw block, times then values
+#define ARCHZMAX		(ARCHBLOCK*20)	// most a compressed block can take
+
+// front of an archive column file, see archive.c.  The block being
+// filled follows at ARCHHDRSZ and holds ARCHBLOCK times (ms) then
+// ARCHBLOCK values, full blocks are compressed after it
+typedef struct {
+	unsigned int	magic;
+	unsigned int	blocksize;			// ARCHBLOCK when written
+	long long		count;				// samples in the file
+	long long		first;				// time of first sample, ms
+	long long		last;				// time of last sample, ms
+	char			name[METRICNAMESZ];
+	long long		sealed;				// blocks compressed
+} ARCHHDR;
+
+// sparse time index, one per block in the .idx file
+typedef struct {
+	long long		t0;					// first time in block, ms
+	long long		t1;					// last time in block, ms
+	double			min;
+	double			max;
+	double			sum;
+	unsigned int	n;					// samples in block
+	unsigned int	len;				// compressed bytes, 0 while raw
+} ARCHIDX;
+
+// one column opened for reading, see archread.c
+typedef struct {
+	int				fd;
+	char			*map;				// the whole file
+	size_t			maplen;
+	long long		count;				// samples when opened
+	ARCHIDX			*idx;				// one per block
+	int				nidx;
+	char			name[METRICNAMESZ];
+	long long		sealed;				// blocks compressed
+	long long		*off;				// where each one starts
+	long long		*tailT;				// copy of the block being filled
+	double			*tailV;
+	long long		*cacheT;			// the last block decompressed
+	double			*cacheV;
+	long long		cached;				// which one, -1 none
+	long long		cur;				// block times and values are from
+	long long		*times;
+	double			*values;
+} ARCHCOL;
+
+// totals over a time range, see ArchAggregate()
+typedef struct {
+	long long		count;
+	double			min;
+	double			max;
+	double			sum;
+} ARCHAGG;
+
+// archive writer counters, see archive.c
+typedef struct {
+	unsigned long	written;			// samples appended
+	unsigned long	older;				// skipped, older than the last one
+	unsigned long	errors;				// samples lost to file errors
+	int				columns;			// column files open
+	unsigned long	blocks;				// blocks compressed
+	unsigned long long	zbytes;			// and the bytes they took
+} ARCHSTATS;
+
+#define SNAPNAME		"/weatherstation"	// POSIX shared memory object
+#define SNAPVERSION		1
+
+// current conditions for other processes, see snapshot.c.  Written
+// under a seqlock, readers copy it with SnapRead()
+typedef struct {
+	unsigned int	seq;				// odd while a write is under way
+	unsigned int	version;			// SNAPVERSION
+	unsigned int	size;				// sizeof(SNAPSHOT)
+	int				pid;				// daemon writing it
+	double			started;			// unix time the daemon started
+	double			updated;			// unix time of the last write
+	double			outsideTemp;		// degrees F
+	double			humidity;			// percent
+	double			boardTemp;			// degrees F
+	double			barometric;			// inches mercury
+	double			tempA;				// 1-wire probe, degrees F
+	double			windSpeed;			// average over the report, MPH
+	double			windGust;			// 3 second gust, MPH
+	double			windNow;			// from the last pulses, MPH
+	double			rainPeriod;			// inches in the last minute
+	double			rainToday;			// inches since midnight
+	double			rainRate;			// in/hr over 1 minute
+	double			rainRate5;			// in/hr over 5 minutes
+	double			rainRate15;			// in/hr over 15 minutes
+	double			i2cTime;			// when each group was last updated
+	double			w1Time;
+	double			windTime;
+	double			rainTime;
+} SNAPSHOT;
+
+// pulse times from an interrupt handler, see pulse.c
+typedef struct {
+	unsigned int		head;			// written by the ISR only
+	unsigned int		tail;			// written by the consumer only
+	unsigned int		mask;
+	unsigned long long	*buf;			// MonoNs() times
+	unsigned long		total;			// pulses accepted
+	unsigned long		overruns;		// pulses lost, ring was full
+} PULSERING;
+
+// pulses written to a file as they are taken, see pulse.c
+typedef struct {
+	char				*name;			// in the file name, e.g. "wind"
+	char				kind;			// W or R on each line
+	FILE				*f;
+	int					yday;			// day the open file is for
+	int					failed;			// open failed, logged once
+	double				retry;			// after a failed open, not tried again before
+} PULSELOG;
+
+#define WIND_FACTOR		3.6528			// mph per pulse/second
+#define GUSTSECS		3				// gust averaging time
+#define WINDWIN			1024			// most pulses in a gust window
+
+// wind calculation state, see wind.c
+typedef struct {
+	unsigned long long	win[WINDWIN];	// pulse times in the gust window
+	unsigned int		head;
+	unsigned int		count;
+	unsigned long long	start;			// start of report interval
+	unsigned long long	last;			// time of last pulse
+	unsigned long long	period;			// ns between last two pulses
+	unsigned long		pulses;			// pulses in report interval
+	double				gust;			// highest gust in interval, mph
+} WINDCALC;
+
+#define RAIN_PER_TIP	0.000045		// inches of rain per tip
+#define RAINRATES		3				// 1, 5 and 15 minute rates
+#define RAINWIN			16384			// most tips kept, power of 2
+
+// rain calculation state, see rain.c
+typedef struct {
+	unsigned long long	tips[RAINWIN];	// tip times, newest at head-1
+	unsigned int		head;
+	unsigned int		tail[RAINRATES];// oldest tip inside each window
+	unsigned long long	start;			// start of report interval
+	unsigned long long	last;			// time of last tip
+	unsigned long long	period;			// ns between last two tips
+	unsigned long		count;			// tips in report interval
+	double				peak;			// highest 1 minute rate, in/hr
+} RAINCALC;
+
+#define CKPTRAIN		0				// checkpoint regions, see checkpoint.c
+#define CKPTWIND		1
+#define CKPTROLLUP		2
+#define CKPTREGIONS		3
+#define CKPTSLOTSZ		32768			// bytes per copy of a region
+#define CKPTDATA		(CKPTSLOTSZ-64)	// most state one region can save
+#define CKPTNONE		(~0ULL)			// no time saved
+#define CKPTTIPS		2048			// newest rain tips saved
+
+// rain state in a checkpoint.  Times are ns before it was taken
+typedef struct {
+	double				today;			// rainToday
+	double				day;			// local midnight it counts from
+	unsigned long long	start;
+	unsigned long long	last;
+	unsigned long long	period;
+	unsigned long		count;
+	double				peak;
+	unsigned int		ntips;
+	unsigned long long	tips[CKPTTIPS];	// oldest first, only ntips saved
+} RAINCKPT;
+
+// wind state in a checkpoint, times as above
+typedef struct {
+	unsigned long long	start;
+	unsigned long long	last;
+	unsigned long long	period;
+	unsigned long		pulses;
+	double				gust;
+	unsigned int		count;
+	unsigned long long	win[WINDWIN];	// oldest first, only count saved
+} WINDCKPT;
+
+#define I2CREAD			1				// I2CMSG part reads, else writes
+#define I2CMAXMSG		4				// most parts in one transaction
+
+// one part of an I2C transaction, see i2c.c
+typedef struct {
+	int			flags;					// I2CREAD or 0
+	int			len;
+	BYTE		*buf;
+} I2CMSG;
+
+// I2C counters, see i2c.c
+typedef struct {
+	unsigned long	xfers;				// transactions
+	unsigned long	errors;				// failed or not acknowledged
+	unsigned long	bytes;				// data bytes moved
+} I2CSTATS;
+
+#define MAXSENSORS		64				// sensors on one station
+#define SENSOROUTS		4				// most values from one sensor
+
+struct SENSOR;
+struct SENSORBUS;
+
+// a kind of sensor, see sensor.c.  The scheduler calls start, waits
+// the ms it returns, then calls read, the bus is only held while they
+// run
+typedef struct {
+	char	*name;						// driver= in a [sensor.name] section
+	char	*bus;						// sensors on one bus take turns
+	int		addr;						// default bus address
+	int		convert;					// ms from start to a result, when
+										// there is no start
+	int		period;						// default ms between readings
+	char	*outs[SENSOROUTS];			// name of each value it gives
+	char	*metrics[SENSOROUTS];		// their default metrics, NULL for
+										// the sensor's own name
+	double	lo[SENSOROUTS];				// what the part can read, anything
+	double	hi[SENSOROUTS];				// outside is an error, see filter.c
+	int		(*open)(struct SENSOR *s);	// 0, or -1 to try again later
+	int		(*start)(struct SENSOR *s);	// ms until the result is ready, or
+										// -1.  NULL for nothing to start
+	int		(*read)(struct SENSOR *s);	// 0 value[] set, -1 error, or ms
+										// to wait if it is not ready
+} SENSORDRV;
+
+// one sensor from the config
+typedef struct SENSOR {
+	char		name[METRICNAMESZ];		// from [sensor.name]
+	SENSORDRV	*drv;
+	int			addr;					// bus address
+	char		id[32];					// 1-wire device id
+	int			period;					// ms between readings
+	int			resolution;				// bits, 0 leaves the part as it is
+	int			fd;						// handle, set by open
+	int			nouts;
+	int			metric[SENSOROUTS];		// where each value is stored
+	double		value[SENSOROUTS];		// set by read
+	double		state[8];				// the driver's own, e.g. calibration
+	unsigned long	reads;				// good readings
+	unsigned long	errors;				// failed ones
+	unsigned long	rejected;			// values the filter dropped
+	// the rest belongs to the scheduler
+	struct SENSORBUS	*bus;
+	unsigned long long	slot;			// MonoNs() this reading was due
+	unsigned long long	due;			// MonoNs() the next step is due
+	int			phase;					// start or read next
+	int			tries;					// reads not ready yet
+	int			result;					// of the last step
+	int			wait;					// ms until the next step
+	int			ready;					// opened
+	int			reopen;					// open again with newResolution once
+	int			newResolution;			// back from the worker
+	int			busy;					// out with the bus worker
+	int			gone;					// dropped by a reload
+	int			fails;					// errors in a row
+	time_t		lastLog;
+	struct SENSOR	*next;				// every sensor made
+} SENSOR;
+
+#define FILTERRANGE		1				// why FilterCheck() dropped a value
+#define FILTERSPIKE		2
+#define FILTERRATE		3
+
+// data quality counters, see filter.c
+typedef struct {
+	unsigned long	passed;				// values that went on
+	unsigned long	range;				// outside the limits or NaN
+	unsigned long	spike;				// too far from the median
+	unsigned long	rate;				// changed too fast
+} FILTERSTATS;
+
+#define MAXSINKS		8				// outputs samples are sent to
+#define SINKCSV			0				// text formats, see SinkFormat()
+#define SINKLINE		1
+#define SINKPACKED		2				// SamplePack(), see pack.c
+
+struct SINK;
+
+// a kind of output, see sink.c.  Only write is needed
+typedef struct {
+	char	*name;						// type= in a [sink.name] section
+	int		(*init)(struct SINK *k);	// read settings, 0 or 1 on error
+	int		(*open)(struct SINK *k);	// 0, or -1 to try again later
+	int		(*write)(struct SINK *k, SAMPLE *s, int n);	// 0, or -1 to keep
+										// the batch and try again
+	int		(*idle)(struct SINK *k);	// after each pass, 1 if it has
+										// more work and should not wait
+	void	(*close)(struct SINK *k);
+} SINKTYPE;
+
+// per sink counters
+typedef struct {
+	unsigned long	queued;				// samples put in its queue
+	unsigned long	dropped;			// lost because the queue was full
+	unsigned long	written;			// handed to the output
+	unsigned long	batches;			// successful writes
+	unsigned long	errors;				// failed writes
+} SINKSTATS;
+
+// one output from the config
+typedef struct SINK {
+	char		name[METRICNAMESZ];		// from [sink.name]
+	SINKTYPE	*type;
+	int			qsize;					// samples the queue holds
+	int			batch;					// samples per write
+	int			flush;					// most seconds a sample waits
+	int			retry;					// seconds between failed tries
+	int			block;					// wait for room, overflow=block
+	int			blockWait;				// ms to wait, 0 for no limit
+	SINKSTATS	stats;
+	// the type's own
+	char		host[64];
+	int			port;
+	char		path[100];				// file, topic or URL path
+	int			format;					// SINKCSV, SINKLINE or SINKPACKED
+	int			keepalive;				// seconds
+	int			timeout;				// seconds
+	int			fd;
+	FILE		*f;
+	char		*buf;
+	int			bufsz;
+	time_t		lastSend;
+	// the rest belongs to sink.c
+	RING		q;
+	sem_t		sem;					// posted when a batch is waiting
+	pthread_t	tid;
+	sem_t		room;					// posted when it takes from the ring
+	int			waiting;				// dbthread is waiting on room
+	int			stalled;				// gave no room in blockWait, dropping
+	int			stop;
+} SINK;
+
+// real-time settings in use, see rt.c
+typedef struct {
+	int				isrPrio;			// rtprio=
+	int				samplePrio;			// rtsample=
+	int				locked;				// mlockall() done
+	unsigned long	threads;			// threads given SCHED_FIFO
+	unsigned long	failed;				// settings that could not be made
+} RTSTATS;
+
+// GPIO character device edge counters, see gpio_cdev.c
+typedef struct {
+	int				on;					// wind and rain lines requested
+	unsigned long	events;				// edges read
+	unsigned long	reads;				// read() calls that got some
+	unsigned long	lost;				// edges the kernel dropped
+	unsigned long	dropped;			// edges with no handler yet
+} GPIOSTATS;
+
+// something to run at a MonoNs() time on the reactor thread, see reactor.c
+typedef struct TIMER {
+	struct TIMER		*next, *prev;	// wheel slot list, NULL when not set
+	unsigned long long	when;
+	void				(*fn)(struct TIMER *t);
+	void				*arg;
+} TIMER;
+
+// event loop counters
+typedef struct {
+	unsigned long	wakeups;			// returns from epoll_wait()
+	unsigned long	timers;				// timers run
+	unsigned long	events;				// eventfds signalled
+} REACTORSTATS;
+
+// hardware backend, see hal.c
+typedef struct {
+	char	*name;
+	int		(*setup)(void);							// -1 on error
+	int		(*gpioEdge)(int pin, void (*fn)(unsigned long long t));	// falling edge, t is
+															// its MonoNs() or 0
+	void	(*gpioOutput)(int pin);
+	void	(*gpioWrite)(int pin, int value);
+	int		(*i2cOpen)(int addr);					// handle, -1 on error
+	int		(*i2cXfer)(int fd, I2CMSG *msg, int n);	// one transaction, 0 or -1
+	int		(*w1Read)(char *id, char *buf, int sz);	// w1_slave text
+	int		(*w1Bulk)(void);						// convert on every probe, -1 if not supported
+	int		(*w1Resolution)(char *id, int bits);	// 9..12 bits, 0 or -1
+	void	(*delay)(int ms);
+} HAL;
+
 // prototype definitions for the worker threads
-void *w1thread(void *param);
+void *sensorthread(void *param);
 void *rainthread(void *param);
 void *anemometerthread(void *param);
-void *i2cthread(void *param);
 void *wuthread(void *param);
+void *dbthread(void *param);
+void *httpthread(void *param);
 
 // prototypes from common.c
 int Sleep(int millisecs);
-int read_line(FILE *fp, char *bp, int mx);
-int ReadConfigString(char *var, char *defaultVal, char *out, int sz, char *file);
-int WriteConfigString(char *var, char *out, char *file);
+double TimeNow(void);
+unsigned long long MonoNs(void);
+unsigned int Crc32(const void *buf, int len);
+unsigned short Crc16(const void *buf, int len);
 int LogOpen(char *filename);
+void LogClose(void);
+void LogSetDebug(int flag);
 void Log(char *format, ... );
-void LogDbg(char *format, ... );
-void StoreToDB(char* var, char* val);
+void LogDbgMsg(char *format, ... );
+int LogStart(void);
+void LogStop(void);
+unsigned long LogDropped(void);
 int ConnectToDb();
 
+// prototypes from config.c
+int ConfigLoad(char *file);
+int ConfigGen(void);
+void ConfigFree(void);
+char *ConfigStr(char *key, char *def);
+int ConfigCopy(char *key, char *def, char *out, int sz);
+int ConfigInt(char *key, int def, int min, int max);
+double ConfigDouble(char *key, double def, double min, double max);
+int ConfigSections(char *prefix, char **names, int max);
+
+// prototypes from ring.c
+int RingInit(RING *r, int nslots, int slotsize);
+void RingFree(RING *r);
+int RingPut(RING *r, void *item);
+int RingGet(RING *r, void *item);
+int RingCount(RING *r);
+
+// prototypes from hal.c
+int HalSelect(char *name);
+
+// prototypes from hal_sim.c
+void SimRates(double wind, double rain);
+
+// prototypes from i2c.c
+int I2cXfer(int fd, I2CMSG *msg, int n);
+int I2cWrite(int fd, BYTE *buf, int len);
+int I2cRead(int fd, BYTE *buf, int len);
+int I2cReadRegs(int fd, int reg, BYTE *buf, int len);
+int I2cWriteReg(int fd, int reg, int value);
+void I2cGetStats(I2CSTATS *out);
+
+// prototypes from sensor.c
+int SensorList(SENSOR **out, int max);
+int SensorLimits(int metric, double *lo, double *hi);
+void SensorWake(void);
+int SensorStart(void);
+void SensorStop(void);
+
+// sensor drivers, see sensor_i2c.c and sensor_w1.c
+extern SENSORDRV drvAm2315;
+extern SENSORDRV drvMpl115a2;
+extern SENSORDRV drvDs18b20;
+
+// sink types, see sink_mysql.c, sink_file.c, sink_mqtt.c and sink_http.c
+extern SINKTYPE sinkMysql;
+extern SINKTYPE sinkFile;
+extern SINKTYPE sinkMqtt;
+extern SINKTYPE sinkHttp;
+
+// prototypes from sink.c
+int SinkInit(void);
+void SinkStart(void);
+void SinkStop(void);
+void SinkPut(SAMPLE *s, int n);
+int SinkList(SINK **out, int max);
+char *SinkStr(SINK *k, char *name, char *def);
+int SinkInt(SINK *k, char *name, int def, int min, int max);
+int SinkConnect(char *host, int port, int secs);
+int SinkSend(int fd, char *buf, int len);
+int SinkFormat(SAMPLE *s, int n, int format, char *buf, int sz);
+
+// prototypes from sink_mysql.c
+void MysqlGetStats(DBSTATS *out);
+
+// prototypes from filter.c
+int FilterCheck(int metric, double v, double t, double lo, double hi);
+void FilterGetStats(FILTERSTATS *out);
+
+// prototypes from pulse.c
+int PulseInit(PULSERING *p, int n);
+void PulsePut(PULSERING *p, unsigned long long t);
+int PulseGet(PULSERING *p, unsigned long long *t);
+void PulseLogPut(PULSELOG *l, char *base, double t);
+void PulseLogFlush(PULSELOG *l);
+
+// pulse rings, defined in the thread files
+extern PULSERING windPulses;
+extern PULSERING rainPulses;
+
+// prototypes from wind.c
+void WindInit(WINDCALC *w, unsigned long long now);
+void WindPulse(WINDCALC *w, unsigned long long t);
+double WindNow(WINDCALC *w, unsigned long long now);
+void WindReport(WINDCALC *w, unsigned long long now, double *speed, double *gust);
+double WindNext(double t, double at, int secs);
+int WindSave(WINDCALC *w, unsigned long long now, WINDCKPT *ck);
+void WindRestore(WINDCALC *w, unsigned long long now, WINDCKPT *ck, unsigned long long gap);
+
+// prototypes from rain.c
+void RainInit(RAINCALC *r, unsigned long long now);
+void RainTip(RAINCALC *r, unsigned long long t);
+double RainNow(RAINCALC *r, unsigned long long now);
+void RainRates(RAINCALC *r, unsigned long long now, double *rates);
+void RainReport(RAINCALC *r, unsigned long long now, double *amount, double *peak);
+double RainNext(double t, double at);
+double RainMidnight(double t);
+void RainReportDay(RAINCALC *r, unsigned long long now, double wall,
+				   double *amount, double *peak, double *today, double *day);
+int RainSave(RAINCALC *r, unsigned long long now, RAINCKPT *ck);
+void RainRestore(RAINCALC *r, unsigned long long now, RAINCKPT *ck, unsigned long long gap);
+
+// prototypes from rainthread.c
+void RainWake(void);
+int RainStart(void);
+void RainStop(void);
+
+// prototypes from anemometerthread.c
+int AnemometerStart(void);
+void AnemometerStop(void);
+
+// prototypes from rt.c
+int RtInit(void);
+int RtThread(char *who, int prio);
+void RtGetStats(RTSTATS *out);
+
+// prototypes from gpio_cdev.c
+int GpioOpen(char *chip);
+int GpioEdge(int pin, void (*fn)(unsigned long long t));
+void GpioStop(void);
+void GpioGetStats(GPIOSTATS *out);
+
+// prototypes from reactor.c
+int ReactorInit(void);
+int ReactorEvent(void (*fn)(void *arg), void *arg);
+int ReactorWatch(int fd, void (*fn)(void *arg), void *arg);
+void ReactorSignal(int fd);
+void ReactorWake(void);
+void ReactorRun(void);
+void ReactorGetStats(REACTORSTATS *out);
+void TimerInit(TIMER *t, void (*fn)(TIMER *t), void *arg);
+void TimerAt(TIMER *t, unsigned long long when);
+void TimerCancel(TIMER *t);
+
+// prototypes from histogram.c
+void HistAdd(HISTOGRAM *h, unsigned long long v);
+unsigned long long HistPercentile(HISTOGRAM *h, double q);
+void HistReset(HISTOGRAM *h);
+int HistJson(HISTOGRAM *h, char *buf, int sz);
+
+// prototypes from metric.c
+int MetricId(char *name);
+char *MetricName(int id);
+int MetricCount(void);
+
+// prototypes from dbthread.c
+int DbQueueInit(void);
+void StoreSample(int metric, double value, double dt);
+void StoreRaw(int metric, double value, double dt);
+void StoreMean(int metric, double value, double dt);
+int DbDrain(void);
+void DbGetStats(DBSTATS *out);
+
+// prototypes from snapshot.c
+int SnapInit(void);
+void SnapClose(void);
+SNAPSHOT *SnapBegin(void);
+void SnapEnd(void);
+SNAPSHOT *SnapLocal(void);
+
+// prototypes from snapread.c
+SNAPSHOT *SnapOpen(char *name);
+int SnapRead(SNAPSHOT *s, SNAPSHOT *out);
+
+// prototypes from rollup.c
+int RollupInit(void);
+void RollupAdd(SAMPLE *s, int n);
+void RollupTick(double now, int all);
+int RollupGet(ROLLUP *r);
+int RollupPending(void);
+unsigned long RollupDropped(void);
+char *RollupPeriodName(int period);
+int RollupSave(void *buf, int sz);
+void RollupRestore(void *buf, int len);
+
+// prototypes from checkpoint.c
+int CkptInit(char *file);
+void CkptClose(void);
+void *CkptLoad(int region, int *len, double *saved);
+void *CkptBegin(int region);
+void CkptEnd(int region, int len);
+int CkptDue(unsigned long long *last);
+
+// prototypes from spool.c
+int SpoolInit(char *dir, int maxmb);
+int SpoolWrite(SAMPLE *s, int n);
+int SpoolPending(void);
+int SpoolRead(SAMPLE *s, int max);
+void SpoolAck(void);
+void SpoolGetStats(SPOOLSTATS *out);
+
+// prototypes from gorilla.c
+void GorillaInit(GORILLA *g, BYTE *buf, int size, long long base);
+int GorillaPut(GORILLA *g, long long t, double v);
+int GorillaBytes(GORILLA *g);
+void GorillaReadInit(GORILLAREAD *r, const BYTE *buf, int size, int count, long long base);
+int GorillaNext(GORILLAREAD *r, long long *t, double *v);
+
+// prototypes from pack.c
+#define PACKSIZE(n)		(10+(n)*60)		// enough room to pack n samples
+int SamplePack(SAMPLE *s, int n, BYTE *buf, int sz);
+int SampleUnpack(const BYTE *buf, int len, SAMPLE *s, int max);
+
+// prototypes from archive.c
+int ArchiveInit(char *dir);
+void ArchiveWrite(SAMPLE *s, int n);
+void ArchiveClose(void);
+void ArchiveGetStats(ARCHSTATS *out);
+
+// prototypes from archread.c
+int ArchOpen(ARCHCOL *c, char *dir, char *name);
+void ArchClose(ARCHCOL *c);
+long long ArchFind(ARCHCOL *c, long long t);
+long long ArchTime(ARCHCOL *c, long long i);
+double ArchValue(ARCHCOL *c, long long i);
+void ArchAggregate(ARCHCOL *c, long long from, long long to, ARCHAGG *a);
 
 // causes Global variables to be defined in the main
 // and referenced as extern in all the other source files
@@ -42,20 +756,30 @@ int ConnectToDb();
 #define EXTERN extern
 #endif
 
-// GLOBAL variables.  A lock needs to be used to prevent any 
-// simultaneous access from multiple threads
-EXTERN int			kicked;						// flag for shutdown or restart
+// debug log lines cost nothing unless debug is set, and are
+// compiled out altogether with -DNO_DEBUG_LOG
+#ifdef NO_DEBUG_LOG
+#define LogDbg(...)		do { } while (0)
+#else
+#define LogDbg(...)		do { if (debug) LogDbgMsg(__VA_ARGS__); } while (0)
+#endif
+
+// GLOBAL variables.  Each sensor value is written by one thread only,
+// anything else should read the copy in the snapshot (snapshot.c)
+EXTERN int			kicked;						// set to 2 to shut down
+EXTERN int			dbStop;						// set once all producers are gone
 EXTERN int 			debug;						// flag to allow debug log output
+EXTERN char			confFile[100];				// config file in use
+EXTERN int			logSync;					// seconds between log fdatasync, 0 never
+EXTERN HAL			*hal;						// hardware backend
 
-EXTERN double 		outsideTemp;				// outside temperature degrees F
-EXTERN double 		boardTemp;					// interface board temperature degrees F
 EXTERN double 		windSpeed;					// wind speed MPH
 EXTERN double 		windGust;					// wind gust MPH
+EXTERN int			windReport;					// seconds between wind reports
+EXTERN int			i2cPeriod;					// default ms between i2c sensor reads
 EXTERN double 		rainToday;					// amount of rain today
 EXTERN double 		rainPeriod;					// amount of rain since last update 
-EXTERN double 		humidity;					// relative humidity percent
-EXTERN double 		barometric;					// barometric prossure inches mercury
-EXTERN double		tempA;						// 1-wire temp probe (if used)
+EXTERN double 		rainRate;					// rain rate over last minute, in/hr
 		
 // database 
 EXTERN MYSQL		*conn;						// the DB connection
@@ -63,4 +787,29 @@ EXTERN char			dbhost[50];
 EXTERN char			dbuser[50];
 EXTERN char			dbpass[50];
 EXTERN char			dbdatabase[50];
-EXTERN char			tempA_ID[32];
+EXTERN char			dbtype[20];					// "mysql" or "null" to throw away
+EXTERN int			dbbatch;					// rows per insert
+EXTERN int			dbflush;					// max seconds a sample waits
+EXTERN int			dbqsize;					// samples the queue can hold
+EXTERN char			spooldir[100];				// where samples wait for the DB
+EXTERN int			spoolmax;					// spool size limit, MB
+EXTERN char			archivedir[100];			// local column archive, blank for none
+EXTERN char			pulseLog[100];				// wind and rain pulse files, blank for none
+EXTERN int			eventLoop;					// 1 to run on reactor.c, not threads
+EXTERN int			rtPrio;						// SCHED_FIFO for edge handlers, 0 none
+EXTERN int			rtSample;					// and for the sampling threads
+EXTERN int			rtLock;						// 1 to mlockall()
+EXTERN char			rtCpus[32];					// CPU list for both, blank any
+EXTERN char			stateFile[100];				// checkpoint file, blank for none
+EXTERN int			stateSave;					// seconds between checkpoints
+EXTERN int			httpPort;					// status server port, 0 for none
+EXTERN char			httpAddr[40];				// and address it listens on
+EXTERN char			tempA_ID[32];				// 1-wire probe when there are no sensor sections
+
+// latency histograms, nanoseconds
+EXTERN HISTOGRAM	histPulse;					// ISR time stamp to thread
+EXTERN HISTOGRAM	histPersist;				// StoreSample() to row stored
+EXTERN HISTOGRAM	histFlush;					// one insert
+EXTERN HISTOGRAM	histI2c;					// one I2C transaction
+EXTERN HISTOGRAM	histSensor;					// sensor step due to started
+EXTERN HISTOGRAM	histEdge;					// GPIO edge to its handler
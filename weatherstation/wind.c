@@ -0,0 +1,143 @@
+/*---------------------------------------------------------------------------
+   wind.c   wind speed and gust from anemometer pulse times
+	2026-10-17   initial edits
+
+	Gust follows the WMO definition, the highest 3 second running mean
+	speed.  The pulses inside the last 3 seconds are kept in a small
+	window that slides forward with each new pulse, so every pulse is
+	O(1) and the gust is exact no matter how fast the wind blows.  The
+	mean speed for a report is pulses over elapsed time, which is the
+	time weighted mean of the speeds from each inter-pulse period.
+
+	No globals are touched here so the replay tool can use it too.
+
+	2026-10-17   state can be saved to and picked up from a checkpoint
+	2026-10-17   WindNext() puts reports on whole multiples of the
+	             report interval, for anemometerthread and replay both
+
+---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "weatherstation.h"
+
+#define GUSTNS	(GUSTSECS*1000000000ULL)
+
+//**************************************************************************
+// start a new calculation, now is from MonoNs()
+void WindInit(WINDCALC *w, unsigned long long now)
+{
+	memset(w,0,sizeof(WINDCALC));
+	w->start = now;
+}
+
+//**************************************************************************
+// add one pulse, pulses must be passed in time order
+void WindPulse(WINDCALC *w, unsigned long long t)
+{
+	double g;
+
+	// drop pulses that have left the gust window
+	while ((w->count>0) && 
+		   (t-w->win[(w->head-w->count)&(WINDWIN-1)] >= GUSTNS))
+		w->count--;
+	if (w->count==WINDWIN)
+		w->count--;
+	w->win[w->head&(WINDWIN-1)] = t;
+	w->head++;
+	w->count++;
+
+	// mean speed over the window that ends with this pulse
+	g = WIND_FACTOR * w->count / GUSTSECS;
+	if (g>w->gust)
+		w->gust = g;
+
+	if (w->last!=0)
+		w->period = t-w->last;
+	w->last = t;
+	w->pulses++;
+}
+
+//**************************************************************************
+// speed from the last inter-pulse period, 0 once pulses stop
+double WindNow(WINDCALC *w, unsigned long long now)
+{
+	if ((w->period==0) || (now-w->last>=GUSTNS))
+		return 0.0;
+	return WIND_FACTOR * 1e9 / (double)w->period;
+}
+
+//**************************************************************************
+// end the report interval at now and start the next one
+void WindReport(WINDCALC *w, unsigned long long now, double *speed, double *gust)
+{
+	double secs;
+
+	secs = (now-w->start)/1e9;
+	*speed = (secs>0) ? WIND_FACTOR * w->pulses / secs : 0.0;
+	*gust = (w->gust>*speed) ? w->gust : *speed;
+	w->pulses = 0;
+	w->gust = 0;
+	w->start = now;
+}
+
+//**************************************************************************
+// when to make the report after the one due at at, t is the time now,
+// both unix seconds.  Reports fall on whole multiples of secs so they
+// do not depend on when counting started.  at is 0 for the first one.
+// A clock more than a second past at, a stall or a step, or behind
+// it goes on from t instead and skips what was missed
+double WindNext(double t, double at, int secs)
+{
+	if (fabs(t-at)>=1)
+		at = t;
+	return (floor(at/secs)+1)*secs;
+}
+
+//**************************************************************************
+// copy the state into a checkpoint, times become ns before now
+//  RETURNS: bytes of ck used
+int WindSave(WINDCALC *w, unsigned long long now, WINDCKPT *ck)
+{
+	unsigned int i;
+
+	ck->start = now-w->start;
+	ck->last = (w->last!=0) ? now-w->last : CKPTNONE;
+	ck->period = w->period;
+	ck->pulses = w->pulses;
+	ck->gust = w->gust;
+	ck->count = w->count;
+	for (i=0; i<w->count; i++)
+		ck->win[i] = now-w->win[(w->head-w->count+i)&(WINDWIN-1)];
+	return offsetof(WINDCKPT,win) + w->count*sizeof(ck->win[0]);
+}
+
+//**************************************************************************
+// pick up from a checkpoint taken gap ns ago.  The report interval
+// carries on as if there had been no gap, pulses in the gust window
+// age by it
+void WindRestore(WINDCALC *w, unsigned long long now, WINDCKPT *ck, unsigned long long gap)
+{
+	unsigned int i;
+	unsigned long long age;
+
+	WindInit(w,now);
+	w->start = now - ((ck->start<now) ? ck->start : now);
+	if ((ck->last!=CKPTNONE) && (ck->last+gap<now))
+	{
+		w->last = now-ck->last-gap;
+		w->period = ck->period;
+	}
+	w->pulses = ck->pulses;
+	w->gust = ck->gust;
+	for (i=0; (i<ck->count) && (i<WINDWIN); i++)
+	{
+		age = ck->win[i]+gap;
+		if ((age<GUSTNS) && (age<now))
+			w->win[w->head++&(WINDWIN-1)] = now-age;
+	}
+	w->count = w->head;
+}